@@ -43,6 +43,7 @@ class GameState:
     penalty: int = 0                                # Current penalty count
     turn: str = "-"                                 # Nickname of the player whose turn it is
     hand: List[str] = field(default_factory=list)   # Cards in the client's hand
+    state_ver: int = 0                              # Room state version of the last STATE / STATE_DELTA
 
     """
     deck: int = 32
@@ -173,14 +174,17 @@ class Model:
             self.game.host = kv.get("nick", self.game.host)
             return
 
-        if etype == "STATE":
+        if etype in ("STATE", "STATE_DELTA"):
+            # STATE_DELTA carries only the fields changed since the last STATE / STATE_DELTA
             self.game.room_id = _to_int(kv.get("room", str(self.game.room_id)))
             self.game.phase = kv.get("phase", self.game.phase)
             self.game.top = kv.get("top", self.game.top)
             self.game.active_suit = kv.get("active_suit", self.game.active_suit)
             self.game.penalty = _to_int(kv.get("penalty", str(self.game.penalty)))
             self.game.turn = kv.get("turn", self.game.turn)
-            self.game.paused = kv.get("paused", "0") == "1"
+            if "paused" in kv:
+                self.game.paused = kv["paused"] == "1"
+            self.game.state_ver = _to_int(kv.get("ver", str(self.game.state_ver)))
             return
 
         if etype == "TOP":
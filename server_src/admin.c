@@ -0,0 +1,390 @@
+#define _POSIX_C_SOURCE 200809L
+#include "admin.h"
+#include "net.h"
+#include "stats.h"
+#include "protocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#define ADMIN_REQ_MAX 2048      // Longest accepted request head in bytes
+
+/**
+ * @brief One connection to the admin port
+ */
+typedef struct {
+    int fd;                     // Connection socket, -1 if the slot is free
+    uint64_t since;             // Accept time in nanoseconds, picks the connection to close when all slots are in use
+    char req[ADMIN_REQ_MAX];    // Request head received so far
+    size_t len;                 // Bytes in req
+    int answered;               // Non-zero once the response is queued, further input is ignored
+    NetOutBuf out;              // Response bytes not yet sent
+} AdminConn;
+
+/**
+ * @brief Growable text buffer the metrics are rendered into
+ */
+typedef struct {
+    char* data;     // Text, NULL until the first append
+    size_t len;     // Bytes used
+    size_t cap;     // Allocated size of data
+    int failed;     // Non-zero if an allocation failed (the text is then incomplete)
+} Text;
+
+static EventLoop* g_loop;               // Event loop the endpoint runs in
+static int g_lfd = -1;                  // Listening socket of the admin port
+static uint32_t g_tag;                  // Base event tag
+static AdminConn g_conns[ADMIN_CONNS];  // Admin connections
+static ShardStats* g_snap;              // Scratch buffer for the summed statistics
+
+// Histogram bucket bounds of the exported latency histograms in nanoseconds (1 us .. 1 s)
+static const uint64_t g_le_ns[] = {
+    1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000, 10000000, 50000000, 100000000, 500000000, 1000000000
+};
+
+/**
+ * @brief Appends formatted text
+ *
+ * @param t     Text buffer
+ * @param fmt   printf-style format
+ */
+static void text_printf(Text* t, const char* fmt, ...) {
+    for (;;) {
+        size_t room = t->cap - t->len;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(t->data ? t->data + t->len : NULL, room, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            t->failed = 1;
+            return;
+        }
+        if ((size_t)n < room) {
+            t->len += (size_t)n;
+            return;
+        }
+
+        size_t cap = t->cap ? t->cap * 2 : 16384;
+        while (cap - t->len <= (size_t)n) {
+            cap *= 2;
+        }
+        char* p = realloc(t->data, cap);
+        if (!p) {
+            t->failed = 1;
+            return;
+        }
+        t->data = p;
+        t->cap = cap;
+    }
+}
+
+/**
+ * @brief Returns the label value of a command
+ *
+ * @param c     Command id
+ *
+ * @return Command name, "unknown" for unrecognized commands
+ */
+static const char* cmd_label(int c) {
+    return (c == CMD_UNKNOWN) ? "unknown" : proto_cmd_name((ProtoCmd)c);
+}
+
+/**
+ * @brief Writes the series of one histogram recorded in nanoseconds, converted to seconds
+ *
+ * @param t         Text buffer
+ * @param name      Metric name
+ * @param label     Label pair without braces (e.g. cmd="PING"), empty for none
+ * @param h         Histogram
+ */
+static void put_hist(Text* t, const char* name, const char* label, const Hist* h) {
+    const char* sep = label[0] ? "," : "";
+    uint64_t n = 0;
+    for (size_t i = 0; i < sizeof(g_le_ns) / sizeof(g_le_ns[0]); i++) {
+        n = hist_count_le(h, g_le_ns[i]);
+        text_printf(t, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, label, sep, (double)g_le_ns[i] / 1e9, (unsigned long long)n);
+    }
+    // Buckets and total are read from a live histogram, keep +Inf from falling below the last bucket
+    uint64_t total = (h->total > n) ? h->total : n;
+    text_printf(t, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, label, sep, (unsigned long long)total);
+    text_printf(t, "%s_sum%s%s%s %.9f\n", name, label[0] ? "{" : "", label, label[0] ? "}" : "", (double)h->sum / 1e9);
+    text_printf(t, "%s_count%s%s%s %llu\n", name, label[0] ? "{" : "", label, label[0] ? "}" : "", (unsigned long long)total);
+}
+
+/**
+ * @brief Writes a metric that consists of a single unlabeled sample
+ *
+ * @param t     Text buffer
+ * @param name  Metric name
+ * @param type  "gauge" or "counter"
+ * @param help  Description
+ * @param v     Value
+ */
+static void put_value(Text* t, const char* name, const char* type, const char* help, uint64_t v) {
+    text_printf(t, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name, (unsigned long long)v);
+}
+
+/**
+ * @brief Renders the statistics of all shards in the Prometheus text format
+ *
+ * @param t     Text buffer
+ */
+static void render_metrics(Text* t) {
+    ShardStats* s = g_snap;
+    stats_collect(s);
+
+    put_value(t, "ups_workers", "gauge", "Worker threads (shards).", (uint64_t)stats_shards());
+    text_printf(t, "# HELP ups_clients Logged-in and connecting clients by connection state.\n# TYPE ups_clients gauge\n");
+    text_printf(t, "ups_clients{state=\"online\"} %llu\n", (unsigned long long)s->online);
+    text_printf(t, "ups_clients{state=\"offline\"} %llu\n", (unsigned long long)s->offline);
+    text_printf(t, "# HELP ups_rooms Rooms by phase.\n# TYPE ups_rooms gauge\n");
+    text_printf(t, "ups_rooms{phase=\"lobby\"} %llu\n", (unsigned long long)s->rooms_lobby);
+    text_printf(t, "ups_rooms{phase=\"game\"} %llu\n", (unsigned long long)s->rooms_game);
+    put_value(t, "ups_games_paused", "gauge", "Running games paused for an offline player.", s->paused);
+    put_value(t, "ups_outbound_queue_bytes", "gauge", "Bytes queued for clients and not yet sent.", s->outq);
+
+    put_value(t, "ups_received_bytes_total", "counter", "Bytes received from clients.", s->bytes_in);
+    put_value(t, "ups_sent_bytes_total", "counter", "Bytes queued for clients.", s->bytes_out);
+    put_value(t, "ups_lines_total", "counter", "Request lines parsed.", s->lines);
+    put_value(t, "ups_rejected_lines_total", "counter", "Lines rejected by the parser.", s->strikes);
+    put_value(t, "ups_dropped_connections_total", "counter", "Connections closed by peer close, error, timeout or protocol violation.", s->drops);
+
+    char label[48];
+    text_printf(t, "# HELP ups_requests_total Requests handled by command.\n# TYPE ups_requests_total counter\n");
+    for (int c = 0; c < CMD_COUNT; c++) {
+        text_printf(t, "ups_requests_total{cmd=\"%s\"} %llu\n", cmd_label(c), (unsigned long long)s->req[c].total);
+    }
+    text_printf(t, "# HELP ups_request_duration_seconds Request handler time by command.\n# TYPE ups_request_duration_seconds histogram\n");
+    for (int c = 0; c < CMD_COUNT; c++) {
+        snprintf(label, sizeof(label), "cmd=\"%s\"", cmd_label(c));
+        put_hist(t, "ups_request_duration_seconds", label, &s->req[c]);
+    }
+    text_printf(t, "# HELP ups_loop_iteration_seconds Event loop iteration time without the wait.\n# TYPE ups_loop_iteration_seconds histogram\n");
+    put_hist(t, "ups_loop_iteration_seconds", "", &s->loop);
+}
+
+/**
+ * @brief Tells whether a request head has been received completely
+ *
+ * @param c     Connection
+ *
+ * @return Non-zero once the empty line ending the head is in the buffer
+ */
+static int head_complete(const AdminConn* c) {
+    for (size_t i = 1; i < c->len; i++) {
+        if (c->req[i] == '\n' && (c->req[i - 1] == '\n' || (i >= 2 && c->req[i - 1] == '\r' && c->req[i - 2] == '\n'))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Closes an admin connection and frees its slot
+ *
+ * @param i     Slot index
+ */
+static void conn_close(int i) {
+    AdminConn* c = &g_conns[i];
+    if (c->fd < 0) {
+        return;
+    }
+    loop_del(g_loop, c->fd);
+    close(c->fd);
+    net_outbuf_free(&c->out);
+    c->fd = -1;
+}
+
+/**
+ * @brief Sends as much of the response as possible, closes the connection once all of it is out
+ *
+ * @param i     Slot index
+ */
+static void conn_flush(int i) {
+    AdminConn* c = &g_conns[i];
+    int r = net_outbuf_flush(c->fd, &c->out);
+    if (r != 0) {
+        conn_close(i);
+        return;
+    }
+    if (loop_mod(g_loop, c->fd, g_tag + 1u + (uint32_t)i, LOOP_OUT) < 0) {
+        conn_close(i);
+    }
+}
+
+/**
+ * @brief Queues the response to a complete (or oversized) request head and starts sending it
+ *
+ * @param i     Slot index
+ */
+static void conn_respond(int i) {
+    AdminConn* c = &g_conns[i];
+    const char* status = "200 OK";
+    const char* extra = "";
+    Text body = { NULL, 0, 0, 0 };
+
+    if (!head_complete(c)) {
+        status = "431 Request Header Fields Too Large";
+        text_printf(&body, "request head too large\n");
+    }
+    else if (c->len < 4 || memcmp(c->req, "GET ", 4) != 0) {
+        status = "405 Method Not Allowed";
+        extra = "Allow: GET\r\n";
+        text_printf(&body, "only GET is supported\n");
+    }
+    else {
+        const char* path = c->req + 4;
+        size_t plen = strcspn(path, " ?\r\n");
+        if (plen == 8 && memcmp(path, "/metrics", 8) == 0) {
+            render_metrics(&body);
+        }
+        else {
+            status = "404 Not Found";
+            text_printf(&body, "try /metrics\n");
+        }
+    }
+    if (body.failed) {
+        free(body.data);
+        conn_close(i);
+        return;
+    }
+
+    char head[256];
+    int hn = snprintf(head, sizeof(head), "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %zu\r\n%sConnection: close\r\n\r\n", status, body.len, extra);
+    int ok = net_outbuf_append(&c->out, head, (size_t)hn) == 0 && net_outbuf_append(&c->out, body.data, body.len) == 0;
+    free(body.data);
+    if (!ok) {
+        conn_close(i);
+        return;
+    }
+    c->answered = 1;
+    conn_flush(i);
+}
+
+/**
+ * @brief Reads request bytes of an admin connection until the head is complete
+ *
+ * @param i     Slot index
+ */
+static void conn_read(int i) {
+    AdminConn* c = &g_conns[i];
+    while (c->len < sizeof(c->req)) {
+        ssize_t n = recv(c->fd, c->req + c->len, sizeof(c->req) - c->len, 0);
+        if (n > 0) {
+            c->len += (size_t)n;
+            if (head_complete(c)) {
+                break;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        conn_close(i);
+        return;
+    }
+    conn_respond(i);
+}
+
+/**
+ * @brief Accepts pending admin connections, closing the oldest one when all slots are in use
+ */
+static void on_accept(void) {
+    for (int k = 0; k < ADMIN_CONNS; k++) {
+        int fd = net_accept(g_lfd);
+        if (fd < 0) {
+            return;
+        }
+
+        int slot = -1;
+        int oldest = 0;
+        for (int i = 0; i < ADMIN_CONNS; i++) {
+            if (g_conns[i].fd < 0) {
+                slot = i;
+                break;
+            }
+            if (g_conns[i].since < g_conns[oldest].since) {
+                oldest = i;
+            }
+        }
+        if (slot < 0) {
+            conn_close(oldest);
+            slot = oldest;
+        }
+
+        AdminConn* c = &g_conns[slot];
+        if (loop_add(g_loop, fd, g_tag + 1u + (uint32_t)slot, LOOP_IN) < 0) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->since = stats_now_ns();
+        c->len = 0;
+        c->answered = 0;
+    }
+}
+
+int admin_attach(EventLoop* loop, int lfd, uint32_t tag) {
+    g_snap = malloc(sizeof(*g_snap));
+    if (!g_snap) {
+        return -1;
+    }
+    for (int i = 0; i < ADMIN_CONNS; i++) {
+        g_conns[i].fd = -1;
+        memset(&g_conns[i].out, 0, sizeof(g_conns[i].out));
+    }
+    g_loop = loop;
+    g_lfd = lfd;
+    g_tag = tag;
+    if (loop_add(loop, lfd, tag, LOOP_IN) < 0) {
+        admin_detach();
+        return -1;
+    }
+    return 0;
+}
+
+void admin_detach(void) {
+    if (!g_loop) {
+        return;
+    }
+    for (int i = 0; i < ADMIN_CONNS; i++) {
+        conn_close(i);
+    }
+    loop_del(g_loop, g_lfd);
+    free(g_snap);
+    g_snap = NULL;
+    g_loop = NULL;
+    g_lfd = -1;
+}
+
+int admin_owns(uint32_t tag) {
+    return g_loop && tag - g_tag < ADMIN_TAGS;
+}
+
+void admin_event(uint32_t tag, uint32_t events) {
+    uint32_t k = tag - g_tag;
+    if (k == 0) {
+        on_accept();
+        return;
+    }
+
+    int i = (int)k - 1;
+    if (g_conns[i].fd < 0) {
+        return;
+    }
+    if (g_conns[i].answered) {
+        conn_flush(i);
+    }
+    else if (events & (LOOP_IN | LOOP_ERR)) {
+        conn_read(i);
+    }
+}
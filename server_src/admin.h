@@ -0,0 +1,53 @@
+/**
+ * @file admin.h
+ * @brief Metrics endpoint: a minimal HTTP server on a separate admin port
+ *
+ * GET /metrics returns the statistics of all shards in the Prometheus text exposition format. The listener and its connections live in an existing event loop, so serving a scrape costs no extra thread
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef ADMIN_H
+#define ADMIN_H
+
+#pragma once
+#include <stdint.h>
+#include "loop.h"
+
+#define ADMIN_CONNS 8                   // Concurrent admin connections, the oldest is closed when another one arrives
+#define ADMIN_TAGS (1 + ADMIN_CONNS)    // Event tags used from the base tag on: the listener, then one per connection
+
+/**
+ * @brief Starts serving the metrics endpoint in an event loop
+ *
+ * @param loop      Event loop of the calling thread
+ * @param lfd       Listening socket of the admin port
+ * @param tag       Base tag, admin events carry tags tag .. tag + ADMIN_TAGS - 1
+ *
+ * @return 0 on success, -1 on error
+ */
+int admin_attach(EventLoop* loop, int lfd, uint32_t tag);
+
+/**
+ * @brief Closes all admin connections and stops watching the listener
+ */
+void admin_detach(void);
+
+/**
+ * @brief Tells whether an event belongs to the metrics endpoint
+ *
+ * @param tag   Event tag
+ *
+ * @return Non-zero for admin tags
+ */
+int admin_owns(uint32_t tag);
+
+/**
+ * @brief Handles a readiness event of the listener or an admin connection
+ *
+ * @param tag       Event tag (admin_owns() must be true)
+ * @param events    LOOP_IN / LOOP_OUT / LOOP_ERR bits
+ */
+void admin_event(uint32_t tag, uint32_t events);
+
+#endif
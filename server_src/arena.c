@@ -0,0 +1,82 @@
+#define _DEFAULT_SOURCE
+#include "arena.h"
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define CHUNK_HDR (((sizeof(ArenaChunk) + ARENA_ALIGN - 1) / ARENA_ALIGN) * ARENA_ALIGN)
+
+/**
+ * @brief Rounds a size up to a multiple of a power-of-two alignment
+ *
+ * @param n     Size
+ * @param align Alignment
+ *
+ * @return Rounded size
+ */
+static size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+/**
+ * @brief Maps a new chunk and makes it the current one
+ *
+ * @param a     Arena
+ * @param need  Number of bytes the chunk must be able to hold
+ *
+ * @return 0 on success, -1 on error
+ */
+static int add_chunk(Arena* a, size_t need) {
+    size_t size = round_up(CHUNK_HDR + need, 4096);
+    if (size < a->chunk_size) {
+        size = a->chunk_size;
+    }
+
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return -1;
+    }
+
+    ArenaChunk* c = (ArenaChunk*)p;
+    c->prev = a->head;
+    c->size = size;
+    c->used = CHUNK_HDR;
+    a->head = c;
+
+    return 0;
+}
+
+void arena_init(Arena* a, size_t chunk_size) {
+    a->head = NULL;
+    a->chunk_size = round_up(chunk_size ? chunk_size : 4096, 4096);
+    a->total = 0;
+}
+
+void* arena_alloc(Arena* a, size_t n) {
+    if (n > SIZE_MAX / 2) {
+        return NULL;
+    }
+    n = round_up(n ? n : 1, ARENA_ALIGN);
+
+    if (!a->head || a->head->size - a->head->used < n) {
+        if (add_chunk(a, n) < 0) {
+            return NULL;
+        }
+    }
+
+    void* p = (char*)a->head + a->head->used;
+    a->head->used += n;
+    a->total += n;
+
+    return p;
+}
+
+void arena_destroy(Arena* a) {
+    ArenaChunk* c = a->head;
+    while (c) {
+        ArenaChunk* prev = c->prev;
+        munmap(c, c->size);
+        c = prev;
+    }
+    a->head = NULL;
+    a->total = 0;
+}
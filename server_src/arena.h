@@ -0,0 +1,63 @@
+/**
+ * @file arena.h
+ * @brief Bump allocator for storage that lives as long as the server
+ *
+ * Client and room tables are sized from the configuration at startup and carved out of one arena, which is released as a whole on shutdown
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#pragma once
+#include <stddef.h>
+
+#define ARENA_ALIGN 64  // Alignment of every allocation (cache line)
+
+/**
+ * @brief One mapped memory region of an arena
+ */
+typedef struct ArenaChunk {
+    struct ArenaChunk* prev;    // Previously mapped chunk
+    size_t size;                // Mapped size in bytes (including this header)
+    size_t used;                // Bytes handed out (including this header)
+} ArenaChunk;
+
+/**
+ * @brief Arena allocator
+ */
+typedef struct {
+    ArenaChunk* head;   // Chunk currently allocated from
+    size_t chunk_size;  // Default size of new chunks
+    size_t total;       // Bytes handed out over the arena lifetime
+} Arena;
+
+/**
+ * @brief Initializes an empty arena
+ *
+ * @param a             Arena
+ * @param chunk_size    Default chunk size, larger requests get a chunk of their own
+ */
+void arena_init(Arena* a, size_t chunk_size);
+
+/**
+ * @brief Allocates zeroed, ARENA_ALIGN-aligned memory
+ *
+ * Pages are mapped lazily by the kernel, so large tables only cost memory once they are touched
+ *
+ * @param a     Arena
+ * @param n     Size in bytes
+ *
+ * @return Pointer to the memory, or NULL if no memory could be mapped
+ */
+void* arena_alloc(Arena* a, size_t n);
+
+/**
+ * @brief Unmaps all chunks of an arena
+ *
+ * @param a     Arena
+ */
+void arena_destroy(Arena* a);
+
+#endif
@@ -0,0 +1,259 @@
+/**
+ * @file bench_game.c
+ * @brief Headless game engine benchmark
+ *
+ * Plays many complete games in-process through the same init/deal/pick_start_top/play/draw calls the lobby uses and reports engine throughput
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "game.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#define CARDS_EACH 4            // Cards dealt to each player (same as START_GAME)
+#define MAX_MOVES 10000         // Moves after which a game is counted as stuck and abandoned
+
+/**
+ * @brief Move selection strategy of the simulated players
+ */
+typedef enum {
+    STRAT_RANDOM = 0,   // Uniformly random legal card, draw only when nothing is playable
+    STRAT_GREEDY = 1    // Keep Queens for last, stack 7s, wish for the suit held most
+} Strategy;
+
+/**
+ * @brief Aggregated benchmark results
+ */
+typedef struct {
+    uint64_t games;         // Finished or abandoned games
+    uint64_t moves;         // PLAY and DRAW actions
+    uint64_t plays;         // PLAY actions
+    uint64_t draws;         // DRAW actions
+    uint64_t reshuffles;    // Discard pile recycles
+    uint64_t stuck;         // Games abandoned after MAX_MOVES
+} BenchStats;
+
+static uint64_t g_rng = 0x9E3779B97F4A7C15ULL; // Generator for the players' choices (separate from the games' own)
+
+/**
+ * @brief Advances the benchmark's xorshift64 generator
+ *
+ * @return Next 64-bit pseudo-random value
+ */
+static uint64_t bench_rand(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+/**
+ * @brief Returns the n-th set bit of a mask
+ *
+ * @param m     Non-empty card mask
+ * @param n     Index of the wanted bit (below popcount(m))
+ *
+ * @return Encoded card
+ */
+static unsigned char nth_card(uint32_t m, int n) {
+    while (n-- > 0) {
+        m &= m - 1;
+    }
+    return (unsigned char)__builtin_ctz(m);
+}
+
+/**
+ * @brief Picks the suit a Queen player wishes for
+ *
+ * @param hand  Hand of the player after the Queen is removed
+ *
+ * @return Suit character with the most cards in the hand
+ */
+static char best_suit(uint32_t hand) {
+    static const char suits[4] = { 'S', 'H', 'D', 'C' };
+    int best = 0;
+    int best_n = -1;
+    for (int s = 0; s < 4; s++) {
+        int n = __builtin_popcount((hand >> (8 * s)) & 0xFFu);
+        if (n > best_n) {
+            best = s;
+            best_n = n;
+        }
+    }
+    return suits[best];
+}
+
+/**
+ * @brief Chooses a card to play from a non-empty legal move mask
+ *
+ * @param legal     Legal move mask
+ * @param strat     Strategy
+ *
+ * @return Encoded card
+ */
+static unsigned char choose_card(uint32_t legal, Strategy strat) {
+    if (strat == STRAT_GREEDY) {
+        uint32_t queens = 0x20202020u;
+        uint32_t sevens = 0x01010101u;
+        if (legal & sevens) {
+            return nth_card(legal & sevens, 0);
+        }
+        if (legal & ~queens) {
+            legal &= ~queens;
+        }
+    }
+    return nth_card(legal, (int)(bench_rand() % (uint64_t)__builtin_popcount(legal)));
+}
+
+/**
+ * @brief Plays one complete game
+ *
+ * @param seed      Seed of the game
+ * @param players   Number of players
+ * @param strat     Strategy of every player
+ * @param st        Statistics to update
+ */
+static void run_game(uint64_t seed, int players, Strategy strat, BenchStats* st) {
+    Game g;
+    init(&g, players, seed);
+    deal(&g, players, CARDS_EACH);
+    pick_start_top(&g);
+
+    int moves = 0;
+    while (!g.ended && moves < MAX_MOVES) {
+        int ppos = g.turn_pos;
+        uint32_t legal = legal_moves(&g, ppos);
+        char err[32];
+
+        if (legal) {
+            unsigned char card = choose_card(legal, strat);
+            char wish[2] = { best_suit(g.hands[ppos] & ~CARD_BIT(card)), '\0' };
+            Outcome out;
+            if (!play(&g, players, ppos, card, wish, &out, err)) {
+                fprintf(stderr, "Engine rejected a legal move: %s\n", err);
+                exit(1);
+            }
+            st->plays++;
+        }
+        else {
+            unsigned char drawn[MAX_HAND];
+            int drawn_count = 0;
+            draw(&g, players, ppos, drawn, &drawn_count, err);
+            st->draws++;
+        }
+        moves++;
+    }
+
+    st->games++;
+    st->moves += (uint64_t)moves;
+    st->reshuffles += g.reshuffles;
+    if (!g.ended) {
+        st->stuck++;
+    }
+}
+
+/**
+ * @brief Returns the monotonic time in seconds
+ *
+ * @return Seconds
+ */
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Prints command line usage
+ *
+ * @param prog  Program name
+ */
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [--games N] [--players 2-%d] [--strategy random|greedy] [--seed N]\n",
+        prog, MAX_PLAYERS
+    );
+}
+
+/**
+ * @brief Benchmark entry point
+ *
+ * @param argc  Argument count
+ * @param argv  Argument vector
+ *
+ * @return 0 on success, 1 on bad arguments
+ */
+int main(int argc, char** argv) {
+    uint64_t games = 1000000;
+    int players = MAX_PLAYERS;
+    Strategy strat = STRAT_GREEDY;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--games") == 0) {
+            games = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--players") == 0) {
+            players = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--strategy") == 0) {
+            const char* s = argv[++i];
+            if (strcmp(s, "random") == 0) {
+                strat = STRAT_RANDOM;
+            }
+            else if (strcmp(s, "greedy") == 0) {
+                strat = STRAT_GREEDY;
+            }
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (players < 2 || players > MAX_PLAYERS || games == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    BenchStats st;
+    memset(&st, 0, sizeof(st));
+    g_rng ^= seed * 0xBF58476D1CE4E5B9ULL;
+
+    double t0 = now_sec();
+    for (uint64_t i = 0; i < games; i++) {
+        run_game(seed + i, players, strat, &st);
+    }
+    double dt = now_sec() - t0;
+    if (dt <= 0.0) {
+        dt = 1e-9;
+    }
+
+    printf("games:               %llu (%d players, %s)\n", (unsigned long long)st.games, players, strat == STRAT_GREEDY ? "greedy" : "random");
+    printf("time:                %.3f s\n", dt);
+    printf("games/s:             %.0f\n", (double)st.games / dt);
+    printf("moves/s:             %.0f\n", (double)st.moves / dt);
+    printf("avg moves/game:      %.2f (%.2f plays, %.2f draws)\n",
+        (double)st.moves / (double)st.games, (double)st.plays / (double)st.games, (double)st.draws / (double)st.games);
+    printf("reshuffles/game:     %.4f\n", (double)st.reshuffles / (double)st.games);
+    printf("reshuffles/1k moves: %.3f\n", 1000.0 * (double)st.reshuffles / (double)st.moves);
+    printf("stuck games:         %llu\n", (unsigned long long)st.stuck);
+    return 0;
+}
@@ -1,42 +1,49 @@
-/**
- * @file config.h
- * @brief Config management
- * 
- * Seminar work of "Fundamentals of Computer Networks"
- */
-
-#ifndef CONFIG_H
-#define CONFIG_H
-
-typedef struct {
-    char ip[64];        // Bind IP address
-    int  port;          // TCP port
-    int  max_clients;   // Maximum number of clients
-    int  max_rooms;     // Maximum number of rooms
-} ServerConfig;
-
-/**
- * @brief Fills configuration with built-in defaults
- *
- * @param cfg   Pointer to configuration structure to initialize
- */
-void config_defaults(ServerConfig* cfg);
-
-/**
- * @brief Loads configuration values from a simple ini-like file
- *
- * @param cfg   Pointer to configuration structure to update
- * @param path  Path to the config file ("server.ini")
- *
- * @return 1 if the file was loaded successfully, 0 otherwise.
- */
-int  config_load_file(ServerConfig* cfg, const char* path);
-
-/**
- * @brief Prints the current configuration
- *
- * @param cfg Pointer to configuration structure to print
- */
-void config_print(const ServerConfig* cfg);
-
-#endif
+/**
+ * @file config.h
+ * @brief Config management
+ * 
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+typedef struct {
+    char ip[64];        // Bind IP address
+    int  port;          // TCP port
+    int  max_clients;   // Maximum number of clients
+    int  max_rooms;     // Maximum number of rooms
+    int  max_outbuf;    // Per-client outbound queue limit in bytes
+    int  workers;       // Number of worker threads (shards), 0 = one per online CPU
+    int  backlog;       // Accept queue length of every listening socket
+    int  reuseport;     // Non-zero opens one SO_REUSEPORT listener per worker instead of one shared listener (implied by io_uring with several workers)
+    int  io_uring;      // Non-zero selects the io_uring backend instead of epoll
+    char admin_ip[64];  // Bind IP address of the metrics endpoint
+    int  admin_port;    // TCP port of the metrics endpoint, 0 = disabled
+} ServerConfig;
+
+/**
+ * @brief Fills configuration with built-in defaults
+ *
+ * @param cfg   Pointer to configuration structure to initialize
+ */
+void config_defaults(ServerConfig* cfg);
+
+/**
+ * @brief Loads configuration values from a simple ini-like file
+ *
+ * @param cfg   Pointer to configuration structure to update
+ * @param path  Path to the config file ("server.ini")
+ *
+ * @return 1 if the file was loaded successfully, 0 otherwise.
+ */
+int  config_load_file(ServerConfig* cfg, const char* path);
+
+/**
+ * @brief Prints the current configuration
+ *
+ * @param cfg Pointer to configuration structure to print
+ */
+void config_print(const ServerConfig* cfg);
+
+#endif
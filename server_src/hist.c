@@ -0,0 +1,111 @@
+#include "hist.h"
+
+/**
+ * @brief Maps a value to its bucket
+ *
+ * Values below HIST_SUB get one bucket each. Larger values keep their leading HIST_SUB_BITS + 1 bits, the position of the leading bit selects the group and the bits below it the sub-bucket
+ *
+ * @param v     Value
+ *
+ * @return Bucket index
+ */
+static int bucket_of(uint64_t v) {
+    if (v < HIST_SUB) {
+        return (int)v;
+    }
+    int e = 63 - __builtin_clzll(v);
+    if (e > HIST_MAX_EXP) {
+        return HIST_BUCKETS - 1;
+    }
+    int sub = (int)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + sub;
+}
+
+uint64_t hist_bucket_low(int i) {
+    if (i < HIST_SUB) {
+        return (uint64_t)i;
+    }
+    int e = i / HIST_SUB + HIST_SUB_BITS - 1;
+    int sub = i % HIST_SUB;
+    return (uint64_t)(HIST_SUB + sub) << (e - HIST_SUB_BITS);
+}
+
+/**
+ * @brief Adds to a field that only the calling thread writes
+ *
+ * A relaxed load and store instead of a locked read-modify-write: readers on other threads see either the old or the new value
+ *
+ * @param f     Field
+ * @param n     Amount to add
+ */
+static void field_add(uint64_t* f, uint64_t n) {
+    __atomic_store_n(f, __atomic_load_n(f, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+void hist_record(Hist* h, uint64_t v) {
+    field_add(&h->counts[bucket_of(v)], 1);
+    field_add(&h->total, 1);
+    field_add(&h->sum, v);
+    if (v > h->max) {
+        __atomic_store_n(&h->max, v, __ATOMIC_RELAXED);
+    }
+}
+
+void hist_merge(Hist* dst, const Hist* src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += __atomic_load_n(&src->counts[i], __ATOMIC_RELAXED);
+    }
+    dst->total += __atomic_load_n(&src->total, __ATOMIC_RELAXED);
+    dst->sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+    if (max > dst->max) {
+        dst->max = max;
+    }
+}
+
+void hist_sub(Hist* h, const Hist* base) {
+    int top = -1;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        h->counts[i] -= base->counts[i];
+        if (h->counts[i]) {
+            top = i;
+        }
+    }
+    h->total -= base->total;
+    h->sum -= base->sum;
+
+    if (top < 0) {
+        h->max = 0;
+    }
+    else if (top + 1 < HIST_BUCKETS && hist_bucket_low(top + 1) - 1 < h->max) {
+        h->max = hist_bucket_low(top + 1) - 1;
+    }
+}
+
+uint64_t hist_quantile(const Hist* h, double q) {
+    if (h->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (double)h->total);
+    if (rank >= h->total) {
+        rank = h->total - 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > rank) {
+            uint64_t high = (i + 1 < HIST_BUCKETS) ? hist_bucket_low(i + 1) - 1 : h->max;
+            return high < h->max ? high : h->max;
+        }
+    }
+    return h->max;
+}
+
+uint64_t hist_count_le(const Hist* h, uint64_t v) {
+    uint64_t n = 0;
+    for (int i = 0; i + 1 < HIST_BUCKETS && hist_bucket_low(i + 1) - 1 <= v; i++) {
+        n += h->counts[i];
+    }
+    return n;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file hist.h
+ * @brief Log-bucketed histograms for latency measurements
+ *
+ * Values are grouped by their power of two, and every power of two is split into HIST_SUB linear sub-buckets, so the relative error of a reported percentile stays below 1/HIST_SUB at any magnitude. Recording a value is a few bit operations and one increment
+ * A histogram has a single writer. Its fields are written with relaxed atomic stores, so other threads may read it through hist_merge() at any time
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef HIST_H
+#define HIST_H
+
+#pragma once
+#include <stdint.h>
+
+#define HIST_SUB_BITS 4                                 // log2 of the sub-buckets per power of two
+#define HIST_SUB (1 << HIST_SUB_BITS)                   // Sub-buckets per power of two
+#define HIST_MAX_EXP 40                                 // Values from 2^HIST_MAX_EXP on share the last bucket
+#define HIST_BUCKETS ((HIST_MAX_EXP - HIST_SUB_BITS + 2) * HIST_SUB)
+
+/**
+ * @brief Histogram of non-negative integer values (the unit is chosen by the caller)
+ *
+ * A zeroed histogram is valid and empty
+ */
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];  // Values per bucket
+    uint64_t total;                 // Number of recorded values
+    uint64_t sum;                   // Sum of recorded values
+    uint64_t max;                   // Largest recorded value
+} Hist;
+
+/**
+ * @brief Records one value
+ *
+ * @param h     Histogram
+ * @param v     Value
+ */
+void hist_record(Hist* h, uint64_t v);
+
+/**
+ * @brief Adds all values of one histogram to another
+ *
+ * @param dst   Histogram to add to (owned by the caller)
+ * @param src   Histogram to add (may be written concurrently by its owner)
+ */
+void hist_merge(Hist* dst, const Hist* src);
+
+/**
+ * @brief Removes the values of an earlier snapshot from a histogram
+ *
+ * Leaves the values recorded after the snapshot was taken. The maximum is narrowed to the highest bucket still holding values
+ *
+ * @param h     Histogram (owned by the caller)
+ * @param base  Earlier snapshot of the same histogram
+ */
+void hist_sub(Hist* h, const Hist* base);
+
+/**
+ * @brief Returns the value below which a given share of the recorded values lies
+ *
+ * @param h     Histogram
+ * @param q     Quantile between 0 and 1 (0.99 for p99)
+ *
+ * @return Upper bound of the bucket holding the quantile (never above max), 0 if the histogram is empty
+ */
+uint64_t hist_quantile(const Hist* h, double q);
+
+/**
+ * @brief Counts the recorded values that are not above a bound
+ *
+ * Only whole buckets are counted, so a bound that splits a bucket leaves that bucket out
+ *
+ * @param h     Histogram
+ * @param v     Upper bound (inclusive)
+ *
+ * @return Number of values in the buckets that lie entirely at or below v
+ */
+uint64_t hist_count_le(const Hist* h, uint64_t v);
+
+/**
+ * @brief Returns the smallest value that falls into a bucket
+ *
+ * @param i     Bucket index
+ *
+ * @return Lower bound of the bucket
+ */
+uint64_t hist_bucket_low(int i);
+
+#endif
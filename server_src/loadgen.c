@@ -0,0 +1,1010 @@
+/**
+ * @file loadgen.c
+ * @brief Load generator that drives many scripted bot clients against the server
+ *
+ * All connections are served by a single epoll loop. Every bot speaks the text protocol (or, with --protocol binary, the binary framing of wire.h) like a real client: it logs in, bots are grouped into rooms (the first bot of a group creates the room, the others join), the host starts a game and starts the next one whenever a game ends, bots play a legal card or draw on their turn and send PING keepalives
+ * Reports request-to-response latency percentiles per command, moves per second and error counts
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "game.h"
+#include "protocol.h"
+#include "loop.h"
+#include "net.h"
+#include "hist.h"
+#include "wire.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define BOT_RBUF 4096           // Receive buffer per bot
+#define PENDING_MAX 32          // Requests a bot may have in flight
+#define MAX_EVENTS 1024         // Events per loop_wait() call
+#define TICK_MS 50              // Interval of the keepalive scan
+#define REQ_LINE_MAX 256        // Longest request line a bot sends
+
+/**
+ * @brief Progress of a bot through the scripted lifecycle
+ */
+typedef enum {
+    BOT_CONNECTING = 0, // Non-blocking connect in progress
+    BOT_WELCOME,        // Waiting for the welcome line
+    BOT_LOGIN,          // LOGIN sent
+    BOT_WAIT_ROOM,      // Logged in, waiting for the group host to create the room
+    BOT_ENTERING,       // CREATE_ROOM or JOIN_ROOM sent
+    BOT_IN_ROOM,        // Member of the group room
+    BOT_IDLE,           // Lifecycle failed, only keepalives are sent
+    BOT_CLOSED          // Connection closed
+} BotState;
+
+/**
+ * @brief One simulated client
+ */
+typedef struct {
+    int fd;                             // Socket, -1 once closed
+    BotState state;                     // Lifecycle state
+    char nick[32];                      // Nickname
+    int group;                          // Index of the bot's room group
+    int host;                           // Non-zero for the bot that creates the group room
+
+    char rbuf[BOT_RBUF];                // Received bytes not yet split into lines
+    size_t rlen;                        // Number of bytes in rbuf
+    NetOutBuf out;                      // Requests not yet accepted by the socket
+    int bin_out;                        // Non-zero once requests are sent as frames
+    int bin_in;                         // Non-zero once the server confirmed binary mode: input is frames
+    WireNicks nicks;                    // Nickname table of the binary protocol
+
+    uint64_t pend_us[PENDING_MAX];      // Send times of requests awaiting their response (FIFO)
+    ProtoCmd pend_cmd[PENDING_MAX];     // Commands of the requests awaiting their response
+    int pend_head;                      // Index of the oldest pending request
+    int pend_count;                     // Number of pending requests
+
+    uint32_t hand;                      // Own hand (card mask) from the last EVT HAND
+    int in_game;                        // Non-zero while the room phase is GAME
+    int paused;                         // Non-zero while the game is paused
+    char turn[32];                      // Nickname of the player on turn
+    unsigned char top;                  // Top card
+    char active_suit;                   // Active suit
+    int penalty;                        // Pending 7-penalty
+    int my_turn;                        // Non-zero if the tracked state names this bot on turn (game running)
+    int moving;                         // Non-zero while a PLAY or DRAW awaits its response
+
+    uint64_t next_ping_us;              // Due time of the next keepalive
+} Bot;
+
+/**
+ * @brief Bots that share one room
+ */
+typedef struct {
+    int first;      // Bot index of the host
+    int size;       // Number of bots in the group (room capacity)
+    int room_id;    // Room id once created, -1 before
+    int joined;     // Members (besides the host) that joined
+} Group;
+
+/**
+ * @brief Aggregated load test results
+ */
+typedef struct {
+    Hist all;                       // Latency of every request in microseconds
+    Hist lat[CMD_COUNT];            // Latency per command in microseconds
+    uint64_t errors[CMD_COUNT];     // ERR responses per command
+    uint64_t requests;              // Requests sent
+    uint64_t plays;                 // Accepted PLAY requests
+    uint64_t draws;                 // Accepted DRAW requests
+    uint64_t games;                 // Finished or aborted games (counted by the hosts)
+    uint64_t connected;             // Connections that completed
+    uint64_t connect_failures;      // Connections that failed
+    uint64_t disconnects;           // Connections closed by the server or by an error
+    uint64_t bytes_in;              // Bytes received
+    uint64_t bytes_out;             // Bytes handed to the sockets
+} LoadStats;
+
+static Bot* g_bots;                         // Bot storage
+static int g_bot_count;                     // Number of bots
+static Group* g_groups;                     // Room groups
+static EventLoop g_loop = { .fd = -1 };     // Event loop serving all bots
+static LoadStats g_stats;                   // Results
+static int g_ping_ms = 5000;                // Keepalive interval per bot
+static int g_binary;                        // Non-zero if bots switch to the binary protocol after the welcome line
+static uint64_t g_rng = 0x9E3779B97F4A7C15ULL; // Generator for the bots' choices
+
+static volatile sig_atomic_t g_running = 1; // Cleared by SIGINT/SIGTERM to stop early
+
+/**
+ * @brief Signal handler that ends the run and prints the results collected so far
+ *
+ * @param sig   Signal number
+ */
+static void on_signal_stop(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/**
+ * @brief Returns the monotonic time in microseconds
+ *
+ * @return Microseconds since an arbitrary fixed point
+ */
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/**
+ * @brief Advances the xorshift64 generator
+ *
+ * @return Next 64-bit pseudo-random value
+ */
+static uint64_t lg_rand(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+/**
+ * @brief Closes a bot connection
+ *
+ * @param i         Bot index
+ * @param failure   Non-zero if the connection was lost rather than closed at the end of the run
+ */
+static void bot_close(int i, int failure) {
+    Bot* b = &g_bots[i];
+    if (b->fd < 0) {
+        return;
+    }
+    if (failure) {
+        if (b->state == BOT_CONNECTING) {
+            g_stats.connect_failures++;
+        }
+        else {
+            g_stats.disconnects++;
+        }
+    }
+    close(b->fd);
+    b->fd = -1;
+    b->state = BOT_CLOSED;
+    net_outbuf_free(&b->out);
+}
+
+/**
+ * @brief Sends a request and remembers its send time for the latency measurement
+ *
+ * The server answers the requests of a connection in order, so the next RESP or ERR line always belongs to the oldest pending request
+ *
+ * @param i     Bot index
+ * @param cmd   Command of the request
+ * @param fmt   Request line including "REQ " and the trailing newline
+ * @param ...   Format arguments
+ *
+ * @return 0 on success, -1 if the request was not sent
+ */
+static int bot_request(int i, ProtoCmd cmd, const char* fmt, ...) {
+    Bot* b = &g_bots[i];
+    if (b->fd < 0 || b->pend_count >= PENDING_MAX) {
+        return -1;
+    }
+
+    char line[REQ_LINE_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (len <= 0 || (size_t)len >= sizeof(line)) {
+        return -1;
+    }
+    unsigned char frames[REQ_LINE_MAX + 8];
+    const char* data = line;
+    if (b->bin_out) {
+        len = wire_encode(line, (size_t)len, NULL, frames, sizeof(frames));
+        if (len < 0) {
+            return -1;
+        }
+        data = (const char*)frames;
+    }
+
+    if (net_outbuf_append(&b->out, data, (size_t)len) < 0) {
+        bot_close(i, 1);
+        return -1;
+    }
+    int slot = (b->pend_head + b->pend_count) % PENDING_MAX;
+    b->pend_us[slot] = now_us();
+    b->pend_cmd[slot] = cmd;
+    b->pend_count++;
+    g_stats.requests++;
+    g_stats.bytes_out += (uint64_t)len;
+
+    if (b->state != BOT_CONNECTING && net_outbuf_flush(b->fd, &b->out) < 0) {
+        bot_close(i, 1);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Picks the suit to wish for with a Queen
+ *
+ * @param hand  Hand after the Queen is removed
+ *
+ * @return Suit character with the most cards in the hand
+ */
+static char best_suit(uint32_t hand) {
+    static const char suits[4] = { 'S', 'H', 'D', 'C' };
+    int best = 0;
+    int best_n = -1;
+    for (int s = 0; s < 4; s++) {
+        int n = __builtin_popcount((hand >> (8 * s)) & 0xFFu);
+        if (n > best_n) {
+            best = s;
+            best_n = n;
+        }
+    }
+    return suits[best];
+}
+
+/**
+ * @brief Makes the move of a bot whose turn it is
+ *
+ * The legal cards come from the engine itself: a game state holding only the bot's hand and the visible top card, suit and penalty is enough for legal_moves()
+ *
+ * @param i     Bot index
+ */
+static void bot_move(int i) {
+    Bot* b = &g_bots[i];
+
+    Game g;
+    memset(&g, 0, sizeof(g));
+    g.hands[0] = b->hand;
+    g.top_card = b->top;
+    g.active_suit = b->active_suit;
+    g.penalty = (unsigned char)b->penalty;
+    g.running = 1;
+
+    uint32_t legal = legal_moves(&g, 0);
+    int rc;
+    if (legal) {
+        int n = (int)(lg_rand() % (uint64_t)__builtin_popcount(legal));
+        while (n-- > 0) {
+            legal &= legal - 1;
+        }
+        unsigned char card = (unsigned char)__builtin_ctz(legal);
+        char cs[4];
+        card_to_str(card, cs);
+        if (cs[1] == 'Q') {
+            rc = bot_request(i, CMD_PLAY, "REQ PLAY card=%s wish=%c\n", cs, best_suit(b->hand & ~CARD_BIT(card)));
+        }
+        else {
+            rc = bot_request(i, CMD_PLAY, "REQ PLAY card=%s\n", cs);
+        }
+    }
+    else {
+        rc = bot_request(i, CMD_DRAW, "REQ DRAW\n");
+    }
+    b->moving = (rc == 0);
+}
+
+/**
+ * @brief Sends JOIN_ROOM for a group member once the room exists
+ *
+ * @param i     Bot index
+ */
+static void bot_join(int i) {
+    Bot* b = &g_bots[i];
+    if (bot_request(i, CMD_JOIN_ROOM, "REQ JOIN_ROOM room=%d\n", g_groups[b->group].room_id) == 0) {
+        b->state = BOT_ENTERING;
+    }
+}
+
+/**
+ * @brief Handles a successful response
+ *
+ * @param i     Bot index
+ * @param cmd   Command the response belongs to
+ * @param m     Parsed response
+ */
+static void on_resp(int i, ProtoCmd cmd, ProtoMsg* m) {
+    Bot* b = &g_bots[i];
+    Group* grp = &g_groups[b->group];
+
+    switch (cmd) {
+        case CMD_LOGIN:
+            if (b->host) {
+                if (grp->size < 2) {
+                    b->state = BOT_IDLE;
+                }
+                else if (bot_request(i, CMD_CREATE_ROOM, "REQ CREATE_ROOM name=%s size=%d\n", b->nick, grp->size) == 0) {
+                    b->state = BOT_ENTERING;
+                }
+            }
+            else if (grp->room_id >= 0) {
+                bot_join(i);
+            }
+            else {
+                b->state = BOT_WAIT_ROOM;
+            }
+            break;
+
+        case CMD_CREATE_ROOM: {
+            const char* room = proto_get(m, "room");
+            if (!room) {
+                b->state = BOT_IDLE;
+                break;
+            }
+            grp->room_id = atoi(room);
+            b->state = BOT_IN_ROOM;
+            for (int k = grp->first + 1; k < grp->first + grp->size; k++) {
+                if (g_bots[k].state == BOT_WAIT_ROOM) {
+                    bot_join(k);
+                }
+            }
+            break;
+        }
+
+        case CMD_JOIN_ROOM:
+            b->state = BOT_IN_ROOM;
+            grp->joined++;
+            if (grp->joined == grp->size - 1) {
+                bot_request(grp->first, CMD_START_GAME, "REQ START_GAME\n");
+            }
+            break;
+
+        case CMD_PROTO:
+            b->bin_in = 1;
+            break;
+
+        case CMD_PLAY:
+            g_stats.plays++;
+            b->moving = 0;
+            break;
+
+        case CMD_DRAW:
+            g_stats.draws++;
+            b->moving = 0;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Handles an ERR response
+ *
+ * A rejected PLAY falls back to DRAW so the game keeps moving, a failed step of the lobby lifecycle leaves the bot idle
+ *
+ * @param i     Bot index
+ * @param cmd   Command the error belongs to
+ */
+static void on_err(int i, ProtoCmd cmd) {
+    Bot* b = &g_bots[i];
+    g_stats.errors[cmd]++;
+
+    switch (cmd) {
+        case CMD_LOGIN:
+        case CMD_CREATE_ROOM:
+        case CMD_JOIN_ROOM:
+            b->state = BOT_IDLE;
+            break;
+
+        case CMD_PLAY:
+            b->moving = 0;
+            if (b->my_turn) {
+                b->moving = (bot_request(i, CMD_DRAW, "REQ DRAW\n") == 0);
+            }
+            break;
+
+        case CMD_DRAW:
+            b->moving = 0;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Moves if the tracked state says it is the bot's turn in a running, unpaused game
+ *
+ * @param i     Bot index
+ */
+static void bot_check_turn(int i) {
+    Bot* b = &g_bots[i];
+    b->my_turn = b->in_game && strcmp(b->turn, b->nick) == 0;
+    if (b->my_turn && !b->paused && !b->moving) {
+        bot_move(i);
+    }
+}
+
+/**
+ * @brief Handles a server event
+ *
+ * @param i     Bot index
+ * @param m     Parsed event
+ */
+static void on_evt(int i, ProtoMsg* m) {
+    Bot* b = &g_bots[i];
+
+    if (strcmp(m->cmd, "SERVER") == 0) {
+        if (b->state != BOT_WELCOME) {
+            return;
+        }
+        // LOGIN follows right behind the switch, the server reads it in the new mode
+        if (g_binary) {
+            if (bot_request(i, CMD_PROTO, "REQ PROTO mode=binary\n") < 0) {
+                return;
+            }
+            b->bin_out = 1;
+        }
+        if (bot_request(i, CMD_LOGIN, "REQ LOGIN nick=%s\n", b->nick) == 0) {
+            b->state = BOT_LOGIN;
+        }
+    }
+    else if (strcmp(m->cmd, "HAND") == 0) {
+        const char* cards = proto_get(m, "cards");
+        b->hand = 0;
+        for (const char* p = cards; p && p[0] && p[1]; p += 3) {
+            unsigned char c;
+            if (str_to_card(p, &c)) {
+                b->hand |= CARD_BIT(c);
+            }
+            if (p[2] != ',') {
+                break;
+            }
+        }
+    }
+    else if (strcmp(m->cmd, "STATE") == 0 || strcmp(m->cmd, "STATE_DELTA") == 0) {
+        // A delta carries only the fields that changed, the others keep their tracked value
+        const char* v;
+        if ((v = proto_get(m, "phase"))) {
+            b->in_game = strcmp(v, "GAME") == 0;
+        }
+        if ((v = proto_get(m, "paused"))) {
+            b->paused = atoi(v);
+        }
+        if ((v = proto_get(m, "top"))) {
+            str_to_card(v, &b->top);
+        }
+        if ((v = proto_get(m, "active_suit"))) {
+            b->active_suit = v[0];
+        }
+        if ((v = proto_get(m, "penalty"))) {
+            b->penalty = atoi(v);
+        }
+        if ((v = proto_get(m, "turn"))) {
+            snprintf(b->turn, sizeof(b->turn), "%s", v);
+        }
+        bot_check_turn(i);
+    }
+    else if (strcmp(m->cmd, "TOP") == 0) {
+        const char* card = proto_get(m, "card");
+        const char* suit = proto_get(m, "active_suit");
+        const char* penalty = proto_get(m, "penalty");
+        if (card && suit && penalty) {
+            str_to_card(card, &b->top);
+            b->active_suit = suit[0];
+            b->penalty = atoi(penalty);
+        }
+    }
+    else if (strcmp(m->cmd, "TURN") == 0) {
+        // Every move ends with EVT TURN, the state delta after it may be empty when the turn stays
+        const char* nick = proto_get(m, "nick");
+        if (nick) {
+            snprintf(b->turn, sizeof(b->turn), "%s", nick);
+            bot_check_turn(i);
+        }
+    }
+    else if (strcmp(m->cmd, "GAME_START") == 0) {
+        b->in_game = 1;
+        b->paused = 0;
+    }
+    else if (strcmp(m->cmd, "GAME_PAUSED") == 0) {
+        b->paused = 1;
+    }
+    else if (strcmp(m->cmd, "GAME_RESUMED") == 0) {
+        b->paused = 0;
+        bot_check_turn(i);
+    }
+    else if (strcmp(m->cmd, "GAME_END") == 0 || strcmp(m->cmd, "GAME_ABORT") == 0) {
+        b->in_game = 0;
+        b->my_turn = 0;
+        if (b->host) {
+            g_stats.games++;
+            bot_request(i, CMD_START_GAME, "REQ START_GAME\n");
+        }
+    }
+}
+
+/**
+ * @brief Processes one message received by a bot
+ *
+ * @param i     Bot index
+ * @param m     Parsed message
+ */
+static void bot_msg(int i, ProtoMsg* m) {
+    Bot* b = &g_bots[i];
+    if (m->type == PT_EVT) {
+        on_evt(i, m);
+        return;
+    }
+    if (m->type != PT_RESP && m->type != PT_ERR) {
+        return;
+    }
+    if (b->pend_count == 0) {
+        g_stats.errors[CMD_UNKNOWN]++;
+        return;
+    }
+
+    ProtoCmd cmd = b->pend_cmd[b->pend_head];
+    uint64_t us = now_us() - b->pend_us[b->pend_head];
+    b->pend_head = (b->pend_head + 1) % PENDING_MAX;
+    b->pend_count--;
+    hist_record(&g_stats.all, us);
+    hist_record(&g_stats.lat[cmd], us);
+
+    if (m->type == PT_ERR) {
+        on_err(i, cmd);
+    }
+    else {
+        on_resp(i, cmd, m);
+    }
+}
+
+/**
+ * @brief Processes one line received by a bot
+ *
+ * @param i     Bot index
+ * @param line  Line without terminator (tokenized in place)
+ * @param len   Line length
+ */
+static void bot_line(int i, char* line, size_t len) {
+    ProtoMsg m;
+    if (proto_parse(line, len, &m) != PROTO_OK) {
+        g_stats.errors[CMD_UNKNOWN]++;
+        return;
+    }
+    bot_msg(i, &m);
+}
+
+/**
+ * @brief Processes the next complete line in a bot's receive buffer
+ *
+ * @param i     Bot index
+ * @param p     Buffered bytes
+ * @param n     Number of buffered bytes
+ *
+ * @return Bytes consumed, 0 if no complete line is buffered
+ */
+static size_t bot_take_line(int i, char* p, size_t n) {
+    char* nl = memchr(p, '\n', n);
+    if (!nl) {
+        return 0;
+    }
+    size_t llen = (size_t)(nl - p);
+    if (llen > 0 && p[llen - 1] == '\r') {
+        llen--;
+    }
+    if (llen > 0) {
+        bot_line(i, p, llen);
+    }
+    return (size_t)(nl - p) + 1;
+}
+
+/**
+ * @brief Processes the next complete frame in a bot's receive buffer
+ *
+ * Message frames are decoded straight into a ProtoMsg, only nickname entries and text fallbacks go through wire_to_text()
+ *
+ * @param i     Bot index
+ * @param p     Buffered bytes
+ * @param n     Number of buffered bytes
+ *
+ * @return Bytes consumed, 0 if no complete frame is buffered or the connection was closed
+ */
+static size_t bot_take_frame(int i, char* p, size_t n) {
+    Bot* b = &g_bots[i];
+    size_t len;
+    int h = wire_frame_head((const unsigned char*)p, n, &len);
+    if (h < 0 || (h > 0 && len == 0)) {
+        bot_close(i, 1);
+        return 0;
+    }
+    if (h == 0 || (size_t)h + len > n) {
+        return 0;
+    }
+
+    const unsigned char* body = (const unsigned char*)p + h;
+    char text[1100];
+    ProtoMsg m;
+    if (body[0] == WIRE_OP_NICK || body[0] == WIRE_OP_TEXT) {
+        int tl = wire_to_text(body, len, &b->nicks, text, sizeof(text));
+        if (tl < 0) {
+            g_stats.errors[CMD_UNKNOWN]++;
+        }
+        else if (tl > 0) {
+            bot_line(i, text, (size_t)tl - 1);
+        }
+    }
+    else if (wire_decode(body, len, &b->nicks, text, sizeof(text), &m) == PROTO_OK) {
+        bot_msg(i, &m);
+    }
+    else {
+        g_stats.errors[CMD_UNKNOWN]++;
+    }
+    return (size_t)h + len;
+}
+
+/**
+ * @brief Reads everything the socket holds and processes the complete lines
+ *
+ * @param i     Bot index
+ */
+static void bot_readable(int i) {
+    Bot* b = &g_bots[i];
+
+    while (b->fd >= 0) {
+        ssize_t n = recv(b->fd, b->rbuf + b->rlen, sizeof(b->rbuf) - b->rlen, 0);
+        if (n == 0) {
+            bot_close(i, 1);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                bot_close(i, 1);
+            }
+            return;
+        }
+        g_stats.bytes_in += (uint64_t)n;
+        b->rlen += (size_t)n;
+
+        // The mode is checked per message: frames follow the RESP PROTO line directly
+        size_t start = 0;
+        while (b->fd >= 0 && start < b->rlen) {
+            size_t used = b->bin_in ? bot_take_frame(i, b->rbuf + start, b->rlen - start) : bot_take_line(i, b->rbuf + start, b->rlen - start);
+            if (used == 0) {
+                break;
+            }
+            start += used;
+        }
+        if (b->fd < 0) {
+            return;
+        }
+        if (start == 0 && b->rlen == sizeof(b->rbuf)) {
+            bot_close(i, 1);
+            return;
+        }
+        memmove(b->rbuf, b->rbuf + start, b->rlen - start);
+        b->rlen -= start;
+    }
+}
+
+/**
+ * @brief Handles the readiness events of one bot
+ *
+ * @param i         Bot index
+ * @param events    LOOP_IN / LOOP_OUT / LOOP_ERR bits
+ */
+static void bot_event(int i, uint32_t events) {
+    Bot* b = &g_bots[i];
+    if (b->fd < 0) {
+        return;
+    }
+
+    if (b->state == BOT_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(b->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            bot_close(i, 1);
+            return;
+        }
+        if (!(events & (LOOP_OUT | LOOP_IN))) {
+            return;
+        }
+        b->state = BOT_WELCOME;
+        g_stats.connected++;
+    }
+
+    if (events & LOOP_IN) {
+        bot_readable(i);
+    }
+    else if (events & LOOP_ERR) {
+        bot_close(i, 1);
+        return;
+    }
+    if (b->fd >= 0 && b->out.len > 0 && net_outbuf_flush(b->fd, &b->out) < 0) {
+        bot_close(i, 1);
+    }
+}
+
+/**
+ * @brief Starts the non-blocking connect of a bot
+ *
+ * @param i     Bot index
+ * @param addr  Server address
+ *
+ * @return 0 on success, -1 on error
+ */
+static int bot_connect(int i, const struct sockaddr_in* addr) {
+    Bot* b = &g_bots[i];
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(fd, (const struct sockaddr*)addr, sizeof(*addr)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    if (loop_add(&g_loop, fd, (uint32_t)i, LOOP_IN | LOOP_OUT | LOOP_EDGE) < 0) {
+        close(fd);
+        return -1;
+    }
+    b->fd = fd;
+    b->state = BOT_CONNECTING;
+    return 0;
+}
+
+/**
+ * @brief Sends the keepalives that are due
+ *
+ * @param now   Current time in microseconds
+ */
+static void send_pings(uint64_t now) {
+    for (int i = 0; i < g_bot_count; i++) {
+        Bot* b = &g_bots[i];
+        if (b->fd < 0 || b->state == BOT_CONNECTING || b->state == BOT_WELCOME || now < b->next_ping_us) {
+            continue;
+        }
+        bot_request(i, CMD_PING, "REQ PING\n");
+        b->next_ping_us = now + (uint64_t)g_ping_ms * 1000u;
+    }
+}
+
+/**
+ * @brief Raises the open file limit so every bot gets a socket
+ *
+ * @param want  Number of descriptors needed
+ */
+static void raise_fd_limit(int want) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+        return;
+    }
+    if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur >= (rlim_t)want) {
+        return;
+    }
+
+    rlim_t target = (rlim_t)want;
+    if (rl.rlim_max != RLIM_INFINITY && target > rl.rlim_max) {
+        target = rl.rlim_max;
+    }
+    rl.rlim_cur = target;
+    setrlimit(RLIMIT_NOFILE, &rl);
+
+    if (target < (rlim_t)want) {
+        fprintf(stderr, "Warning: open file limit %lu is below the %d descriptors needed for the bots\n", (unsigned long)target, want);
+    }
+}
+
+/**
+ * @brief Prints one latency row
+ *
+ * @param name  Row label
+ * @param h     Latency histogram in microseconds
+ */
+static void print_latency(const char* name, const Hist* h) {
+    printf("  %-12s %10llu %9llu %9llu %9llu %9llu\n", name, (unsigned long long)h->total,
+        (unsigned long long)hist_quantile(h, 0.50), (unsigned long long)hist_quantile(h, 0.99),
+        (unsigned long long)hist_quantile(h, 0.999), (unsigned long long)h->max
+    );
+}
+
+/**
+ * @brief Prints the results of the run
+ *
+ * @param dt    Run time in seconds
+ */
+static void print_report(double dt) {
+    uint64_t moves = g_stats.plays + g_stats.draws;
+    uint64_t errors = 0;
+    for (int c = 0; c < CMD_COUNT; c++) {
+        errors += g_stats.errors[c];
+    }
+
+    printf("bots:                %d (%llu connected, %llu connect failures, %llu disconnects)\n", g_bot_count,
+        (unsigned long long)g_stats.connected, (unsigned long long)g_stats.connect_failures, (unsigned long long)g_stats.disconnects);
+    printf("time:                %.3f s\n", dt);
+    printf("requests:            %llu (%.0f/s)\n", (unsigned long long)g_stats.requests, (double)g_stats.requests / dt);
+    printf("moves:               %llu (%.0f/s, %llu plays, %llu draws)\n", (unsigned long long)moves, (double)moves / dt,
+        (unsigned long long)g_stats.plays, (unsigned long long)g_stats.draws);
+    printf("games:               %llu\n", (unsigned long long)g_stats.games);
+    printf("bytes in/out:        %llu / %llu\n", (unsigned long long)g_stats.bytes_in, (unsigned long long)g_stats.bytes_out);
+    printf("errors:              %llu\n", (unsigned long long)errors);
+    for (int c = 0; c < CMD_COUNT; c++) {
+        if (g_stats.errors[c]) {
+            printf("  %-12s %10llu\n", proto_cmd_name((ProtoCmd)c), (unsigned long long)g_stats.errors[c]);
+        }
+    }
+
+    printf("latency (us):        %10s %9s %9s %9s %9s\n", "count", "p50", "p99", "p999", "max");
+    print_latency("all", &g_stats.all);
+    for (int c = 0; c < CMD_COUNT; c++) {
+        if (g_stats.lat[c].total) {
+            print_latency(proto_cmd_name((ProtoCmd)c), &g_stats.lat[c]);
+        }
+    }
+}
+
+/**
+ * @brief Prints command line usage
+ *
+ * @param prog  Program name
+ */
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [--ip X] [--port N] [--clients N] [--room-size 2-%d] [--duration SEC] [--ping-ms MS] [--prefix NICK] [--seed N] [--protocol text|binary]\n"
+        "Notes:\n"
+        "\tbots are nicknamed <prefix><index>, use different prefixes for load generators sharing a server\n"
+        "\tthe server's max_clients and max_rooms must cover the bots and their rooms\n",
+        prog, MAX_PLAYERS
+    );
+}
+
+/**
+ * @brief Load generator entry point
+ *
+ * @param argc  Argument count
+ * @param argv  Argument vector
+ *
+ * @return 0 on success, 1 on bad arguments or setup failure
+ */
+int main(int argc, char** argv) {
+    const char* ip = "127.0.0.1";
+    int port = 7777;
+    int clients = 100;
+    int room_size = MAX_PLAYERS;
+    int duration = 10;
+    const char* prefix = "bot";
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--ip") == 0) {
+            ip = argv[++i];
+        }
+        else if (strcmp(argv[i], "--port") == 0) {
+            port = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--clients") == 0) {
+            clients = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--room-size") == 0) {
+            room_size = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--duration") == 0) {
+            duration = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ping-ms") == 0) {
+            g_ping_ms = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--prefix") == 0) {
+            prefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--protocol") == 0) {
+            const char* mode = argv[++i];
+            if (strcmp(mode, "binary") != 0 && strcmp(mode, "text") != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            g_binary = strcmp(mode, "binary") == 0;
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (port <= 0 || port > 65535 || clients <= 0 || room_size < 2 || room_size > MAX_PLAYERS || duration <= 0 || g_ping_ms <= 0 || strlen(prefix) > 16) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
+        fprintf(stderr, "Error: invalid ip %s\n", ip);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal_stop);
+    signal(SIGTERM, on_signal_stop);
+    raise_fd_limit(clients + 64);
+    g_rng ^= seed * 0xBF58476D1CE4E5B9ULL;
+
+    g_bot_count = clients;
+    int group_count = (clients + room_size - 1) / room_size;
+    g_bots = calloc((size_t)clients, sizeof(*g_bots));
+    g_groups = calloc((size_t)group_count, sizeof(*g_groups));
+    LoopEvent* events = malloc(MAX_EVENTS * sizeof(*events));
+    if (!g_bots || !g_groups || !events || loop_init(&g_loop, MAX_EVENTS) < 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+
+    uint64_t t0 = now_us();
+    for (int g = 0; g < group_count; g++) {
+        g_groups[g].first = g * room_size;
+        g_groups[g].size = (clients - g * room_size < room_size) ? clients - g * room_size : room_size;
+        g_groups[g].room_id = -1;
+    }
+    for (int i = 0; i < clients; i++) {
+        Bot* b = &g_bots[i];
+        b->fd = -1;
+        b->group = i / room_size;
+        b->host = (i % room_size) == 0;
+        snprintf(b->nick, sizeof(b->nick), "%s%d", prefix, i);
+        b->next_ping_us = t0 + lg_rand() % ((uint64_t)g_ping_ms * 1000u);
+        if (bot_connect(i, &addr) < 0) {
+            g_stats.connect_failures++;
+            b->state = BOT_CLOSED;
+        }
+    }
+
+    uint64_t end = t0 + (uint64_t)duration * 1000000u;
+    uint64_t now = t0;
+    uint64_t next_tick = t0;
+    while (g_running && now < end) {
+        int n = loop_wait(&g_loop, events, TICK_MS);
+        if (n < 0) {
+            break;
+        }
+        for (int k = 0; k < n; k++) {
+            bot_event((int)events[k].tag, events[k].events);
+        }
+        now = now_us();
+        if (now >= next_tick) {
+            send_pings(now);
+            next_tick = now + TICK_MS * 1000u;
+        }
+    }
+
+    print_report((double)(now_us() - t0) / 1e6);
+
+    for (int i = 0; i < clients; i++) {
+        bot_close(i, 0);
+    }
+    loop_free(&g_loop);
+    free(events);
+    free(g_groups);
+    free(g_bots);
+    return 0;
+}
@@ -1,1253 +1,1647 @@
-#include "lobby.h"
-#include "client.h"
-#include "game.h"
-#include "protocol.h"
-
-#include <string.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-#include <stdarg.h>
-#include <unistd.h>
-
-#define MAX_ROOMS 64
-#define MAX_ROOM_PLAYERS 4
-#define OFFLINE_TIMEOUT_SEC 120
-
-/**
- * @brief Room lifecycle state
- */
-typedef enum { 
-    ROOM_EMPTY=0, 
-    ROOM_LOBBY=1, 
-    ROOM_GAME=2 
-} RoomPhase;
-
-typedef struct {
-    int used;               // Whether this room slot is currently allocated and valid
-    int id;                 // Unique room identifier visible to clients
-    char name[32];          // Room name 
-    int size;               // Target room capacity (2-4)
-
-    RoomPhase phase;        // Current room phase
-    int paused;             // Whether the running game is currently paused due to an offline player
-    time_t pause_started;
-
-    int players[MAX_ROOM_PLAYERS];  // Client indices of players in this room
-    int pcount;             // Current number of players present in the room
-    int host_idx;           // Client index of the host
-
-    Game game;              // Game state for this room
-} Room;
-
-static SendLineFn g_send;   // Function used to send a raw protocol line to a client
-static SendErrFn g_err;     // Function used to send an error response to a client
-static Client* g_clients;   // Pointer to the global client array
-static int g_max_clients;   // Maximum number of clients available
-
-static int g_limit_rooms=MAX_ROOMS;   // Runtime limit for number of rooms that can be allocated
-
-static Room g_rooms[MAX_ROOMS]; // Fixed-size room storage
-static int g_next_room_id=1;    // Auto-increment room id
-
-/**
- * @brief Sends a formatted protocol line to a single client
- *
- * Formats a message using printf-like formatting and sends it
- *
- * @param c     Client index
- * @param fmt   String for the outgoing line
- * @param ...   Format arguments
- */
-static void sendf(int c, const char* fmt, ...) {
-    char out[1024];
-    va_list ap;
-    va_start(ap, fmt);
-    vsnprintf(out, sizeof(out), fmt, ap);
-    va_end(ap);
-    g_send(c, out);
-}
-
-/**
- * @brief Sends current room/game state to a client
- *
- * @param r     Pointer to the room
- * @param ci    Target client index
- */
-static void room_send_state(Room* r, int ci) {
-    const char* phase = (r->phase == ROOM_GAME) ? "GAME" : "LOBBY";
-
-    char top[4] = "-";
-    if (r->phase == ROOM_GAME) card_to_str(r->game.top_card, top);
-
-    const char* turn_nick="-";
-    if (r->phase == ROOM_GAME && r->pcount > 0) {
-        int tci = r->players[r->game.turn_pos];
-        if (tci >= 0) {
-            turn_nick=g_clients[tci].nick;
-        }
-    }
-
-    sendf(ci, "EVT STATE room=%d phase=%s paused=%d top=%s active_suit=%c penalty=%d turn=%s\n", 
-        r->id, phase, r->paused ? 1 : 0, top, r->game.active_suit ? r->game.active_suit : '-', r->game.penalty, turn_nick
-    );
-}
-
-/**
- * @brief Sends the full player roster and online state to a specific client
- *
- * @param r     Pointer to the room.
- * @param to_ci Target client index.
- */
-static void room_send_roster(Room* r, int to_ci) {
-    if (!r) {
-        return;
-    }
-    if (to_ci < 0) {
-        return;
-    }
-    if (g_clients[to_ci].slot == C_EMPTY) {
-        return;
-    }
-
-    if (r->host_idx >= 0 && g_clients[r->host_idx].nick[0]) {
-        sendf(to_ci, "EVT HOST nick=%s\n", g_clients[r->host_idx].nick);
-    }
-
-    for (int i = 0; i < r->pcount; i++) {
-        int ci = r->players[i];
-        if (ci < 0) {
-            continue;
-        }
-        if (g_clients[ci].slot == C_EMPTY) {
-            continue;
-        }
-        if (!g_clients[ci].nick[0]) {
-            continue;
-        }
-
-        sendf(to_ci, "EVT PLAYER_JOIN nick=%s\n", g_clients[ci].nick);
-
-        if (g_clients[ci].online && g_clients[ci].fd >= 0) {
-            sendf(to_ci, "EVT PLAYER_ONLINE nick=%s\n", g_clients[ci].nick);
-        } 
-        else {
-            sendf(to_ci, "EVT PLAYER_OFFLINE nick=%s\n", g_clients[ci].nick);
-        }
-    }
-}
-
-/**
- * @brief Broadcasts a protocol line to all online clients in a room.
- *
- * Sends the given line to every player currently present in the room who is considered online and has a valid socket descriptor
- *
- * @param r     Pointer to the room
- * @param line  Line to broadcast
- */
-static void room_broadcast(Room* r, const char* line) {
-    for (int i = 0; i < r->pcount; i++) {
-        int ci = r->players[i];
-        if (ci >= 0 && g_clients[ci].slot != C_EMPTY && g_clients[ci].online && g_clients[ci].fd >= 0) {
-            g_send(ci, line);
-        }
-    }
-}
-
-/**
- * @brief Broadcasts a formatted protocol line to all online clients in a room
- *
- * Formats a formatted message sends it to all online players in the room
- *
- * @param r     Pointer to the room.
- * @param fmt   String for the outgoing line
- * @param ...   Format arguments
- */
-static void room_broadcastf(Room* r, const char* fmt, ...) {
-    char out[1024];
-    va_list ap;
-    va_start(ap, fmt);
-    vsnprintf(out, sizeof(out), fmt, ap);
-    va_end(ap);
-    room_broadcast(r, out);
-}
-
-/**
- * @brief Broadcasts the current state to all online players in the room
- *
- * @param r     Pointer to the room
- */
-static void room_broadcast_state(Room* r) {
-    for (int i = 0; i < r->pcount; i++) {
-        int ci = r->players[i];
-        if (ci >= 0 && g_clients[ci].slot != C_EMPTY && g_clients[ci].online && g_clients[ci].fd >= 0) {
-            room_send_state(r, ci);
-        }
-    }
-}
-
-/**
- * @brief Broadcasts a line to all online players except one client
- *
- * @param r         Pointer to the room
- * @param except_ci Client index to skip
- * @param line      Line to broadcast
- */
-static void room_broadcast_except(Room* r, int except_ci, const char* line) {
-    for (int i = 0; i < r->pcount; i++) {
-        int ci = r->players[i];
-        if (ci == except_ci) {
-            continue;
-        }
-        if (ci >= 0 && g_clients[ci].slot != C_EMPTY && g_clients[ci].online && g_clients[ci].fd >= 0) {
-            g_send(ci, line);
-        }
-    }
-}
-
-/**
- * @brief Checks whether a client is logged in
- *
- * A client is considered logged in if they have both a non-empty nickname and a non-empty session token
- *
- * @param c     Client index
- *
- * @return 1 if logged in, 0 otherwise
- */
-static int is_logged(int c) {
-    return g_clients[c].nick[0] != '\0' && g_clients[c].session[0] != '\0';
-}
-
-/**
- * @brief Finds an existing client slot by nickname
- *
- * Searches the global client array for a non-empty slot with a matching nick
- *
- * @param nick  Nickname to search for
- *
- * @return Client index if found, -1 otherwise
- */
-static int find_client_by_nick(const char* nick) {
-    for (int i = 0; i < g_max_clients; i++) {
-        if (g_clients[i].slot != C_EMPTY && g_clients[i].nick[0] != '\0') {
-            if (strcmp(g_clients[i].nick, nick) == 0) {
-                return i;
-            }
-        }
-    }
-    return -1;
-}
-
-/**
- * @brief Locates a room by its room id
- *
- * Searches the room table up to the runtime room limit and returns the room pointer if the room exists and is marked as used
- *
- * @param id    Room id
- *
- * @return Pointer to the room if found, NULL otherwise
- */
-static Room* room_by_id(int id) {
-    for (int i = 0; i < g_limit_rooms; i++) {
-        if (g_rooms[i].used && g_rooms[i].id == id) {
-            return &g_rooms[i];
-        }
-    }
-    return NULL;
-}
-
-/**
- * @brief Returns the player position of a client inside a room
- *
- * @param r             Pointer to the room
- * @param client_idx    Client index to locate
- *
- * @return Player position if found, -1 otherwise
- */
-static int room_pos_of(Room* r, int client_idx) {
-    for (int i = 0; i < r->pcount; i++) {
-        if (r->players[i] == client_idx) {
-            return i;
-        }
-    }
-    return -1;
-}
-
-/**
- * @brief Generates a new session token string
- *
- * Creates a pseudo-random session token and writes it into a provided output buffer
- *
- * @param out Output buffer
- */
-static void make_session(char out[64]) {
-    unsigned int a = (unsigned int)rand();
-    unsigned int b = (unsigned int)time(NULL);
-    snprintf(out, 64, "%08x%08x%08x%08x", a, b, (unsigned int)rand(), (unsigned int)rand());
-}
-
-/**
- * @brief Checks whether a client is currently active
- *
- * @param ci    Client index
- *
- * @return 1 if active, 0 otherwise
- */
-static int client_is_active(int ci) {
-    if (ci < 0) {
-        return 0;
-    }
-    if (g_clients[ci].slot == C_EMPTY) {
-        return 0;
-    }
-    if (!g_clients[ci].online) {
-        return 0;
-    }
-    if (g_clients[ci].fd < 0) {
-        return 0;
-    }
-
-    return 1;
-}
-
-/**
- * @brief Tests whether any player in the room is currently offline
- *
- * @param r     Pointer to the room
- *
- * @return 1 if at least one player is offline, 0 otherwise
- */
-static int room_any_offline(Room* r) {
-    if (!r || !r->used) {
-        return 0;
-    }
-    for (int i = 0; i < r->pcount; i++) {
-        int ci = r->players[i];
-        if (!client_is_active(ci)) {
-            return 1;
-        }
-    }
-    return 0;
-}
-
-/**
- * @brief Returns the client index of the first offline player in a room
- *
- * @param r     Pointer to the room
- *
- * @return Client index of an offline player, or -1 if all are online
- */
-static int room_first_offline(Room* r) {
-    if (!r || !r->used) {
-        return -1;
-    }
-    for (int i = 0; i < r->pcount; i++) {
-        int ci = r->players[i];
-        if (!client_is_active(ci)) {
-            return ci;
-        }
-    }
-    return -1;
-}
-
-/**
- * @brief Pauses an active game if not already paused
- *
- * @param r             Pointer to the room
- * @param reason_nick   Nickname that caused the pause
- */
-static void room_pause(Room* r, const char* reason_nick) {
-    if (!r || !r->used) {
-        return;
-    }
-    if (r->phase != ROOM_GAME) {
-        return;
-    }
-    if (r->paused) {
-        return;
-    }
-
-    r->paused = 1;
-    r->pause_started = time(NULL);
-
-    if (reason_nick && reason_nick[0]) {
-        room_broadcastf(r, "EVT GAME_PAUSED nick=%s timeout=%d\n", reason_nick, OFFLINE_TIMEOUT_SEC);
-    } 
-    else {
-        room_broadcastf(r, "EVT GAME_PAUSED timeout=%d\n", OFFLINE_TIMEOUT_SEC);
-    }
-}
-
-/**
- * @brief Resumes a paused game if all players are online again
- *
- * @param r     Pointer to the room
- */
-static void room_resume(Room* r) {
-    if (!r || !r->used) {
-        return;
-    }
-    if (r->phase != ROOM_GAME) {
-        return;
-    }
-    if (!r->paused) {
-        return;
-    }
-
-    if (!room_any_offline(r)) {
-        r->paused = 0;
-        r->pause_started = 0;
-        room_broadcast(r, "EVT GAME_RESUMED\n");
-    }
-}
-
-/**
- * @brief Aborts an active game and returns the room into lobby state.
- *
- * @param r         Pointer to the room
- * @param reason    Abort reason string
- */
-static void room_abort_game(Room* r, const char* reason) {
-    if (!r || !r->used) {
-        return;
-    }
-    if (r->phase != ROOM_GAME) {
-        return;
-    }
-
-    r->phase = ROOM_LOBBY;
-    r->paused = 0;
-    r->pause_started = 0;
-
-    for (int i = 0; i < r->pcount; i++) {
-        int ci = r->players[i];
-        if (ci >= 0 && g_clients[ci].slot != C_EMPTY) {
-            g_clients[ci].in_game = 0;
-        }
-    }
-
-    memset(&r->game, 0, sizeof(r->game));
-
-    if (!reason) {
-        reason = "offline_timeout";
-    }
-    room_broadcastf(r, "EVT GAME_ABORT reason=%s\n", reason);
-
-    room_broadcast_state(r);
-}
-
-
-/**
- * @brief Sends the current hand of one player to that player
- *
- * @param r     Pointer to the room
- * @param ppos  Player position
- */
-static void room_send_hand(Room* r, int ppos) {
-    int ci = r->players[ppos];
-    if (ci < 0) {
-        return;
-    }
-
-    char cards[512];
-    cards[0] = '\0';
-
-    for (int i = 0; i < r->game.hand_count[ppos]; i++) {
-        char cs[4];
-        card_to_str(r->game.hands[ppos][i], cs);
-        strcat(cards, cs);
-        if (i + 1 < r->game.hand_count[ppos]) {
-            strcat(cards, ",");
-        }
-    }
-
-    sendf(ci, "EVT HAND cards=%s\n", cards);
-}
-
-/**
- * @brief Removes a client from the room player list
- *
- * Updates the players array, decreases player count, reassigns host if the host left, and deletes the room if it becomes empty
- *
- * @param r             Pointer to the room
- * @param client_idx    Client index to remove
- */
-static void room_remove_player(Room* r, int client_idx) {
-    int pos = room_pos_of(r, client_idx);
-    if (pos < 0) {
-        return;
-    }
-
-    for (int i = pos; i < r->pcount - 1; i++) {
-        r->players[i] = r->players[i + 1];
-    }
-    r->players[r->pcount - 1] = -1;
-    r->pcount--;
-
-    if (r->host_idx == client_idx && r->pcount > 0) {
-        r->host_idx = r->players[0];
-        room_broadcastf(r, "EVT HOST nick=%s\n", g_clients[r->host_idx].nick);
-    }
-
-    if (r->pcount == 0) {
-        memset(r, 0, sizeof(*r));
-    }
-}
-
-/**
- * @brief Removes a player during an active game (compacts both room and game state).
- *
- * Removes the player at the given player position, shifts room players and also shifts game hands/hand counts. Adjusts turn position so the game can continue with remaining players
- *
- * @param r             Pointer to the room
- * @param removed_ppos  Player position to remove
- */
-static void room_remove_player_in_game(Room* r, int removed_ppos) {
-    if (!r) {
-        return;
-    }
-    if (removed_ppos < 0 || removed_ppos >= r->pcount) {
-        return;
-    }
-
-    int old_pcount = r->pcount;
-
-    if (r->game.turn_pos > removed_ppos) {
-        r->game.turn_pos--;
-    }
-
-    for (int i = removed_ppos; i < old_pcount - 1; i++) {
-        r->players[i] = r->players[i + 1];
-    }
-    r->players[old_pcount - 1] = -1;
-    r->pcount--;
-
-    for (int i = removed_ppos; i < old_pcount - 1; i++) {
-        r->game.hand_count[i] = r->game.hand_count[i + 1];
-        for (int k = 0; k < MAX_HAND; k++) {
-            r->game.hands[i][k] = r->game.hands[i + 1][k];
-        }
-    }
-    r->game.hand_count[old_pcount - 1] = 0;
-    for (int k = 0; k < MAX_HAND; k++) {
-        r->game.hands[old_pcount - 1][k] = 0;
-    }
-
-    if (r->pcount > 0) {
-        if (r->game.turn_pos >= r->pcount) {
-            r->game.turn_pos = 0;
-        }
-        if (r->game.turn_pos < 0) {
-            r->game.turn_pos = 0;
-        }
-    } 
-    else {
-        r->game.turn_pos = 0;
-    }
-
-    if (r->host_idx >= 0) {
-        int host_still_inside = 0;
-        for (int i = 0; i < r->pcount; i++) {
-            if (r->players[i] == r->host_idx) {
-                host_still_inside = 1;
-                break;
-            }
-        }
-        if (!host_still_inside && r->pcount > 0) {
-            r->host_idx = r->players[0];
-            room_broadcastf(r, "EVT HOST nick=%s\n", g_clients[r->host_idx].nick);
-        }
-    }
-
-    if (r->pcount == 0) {
-        memset(r, 0, sizeof(*r));
-    }
-}
-
-/**
- * @brief Validates that a client is allowed to perform an in-game action
- *
- * @param client_idx    Client index performing the action
- * @param out_r         Output pointer to the room on success
- * @param out_ppos      Output player position on success
- *
- * @return 1 if valid, 0 otherwise
- */
-static int ensure_in_game(int client_idx, Room** out_r, int* out_ppos) {
-    int rid=g_clients[client_idx].room_id;
-    if (rid < 0) { 
-        return 0;
-    }
-    Room* r = room_by_id(rid);
-    if (!r) {
-        return 0;
-    }
-    if (r->phase != ROOM_GAME) {
-        return 0;
-    }
-    if (r->paused) {
-        return 0;
-    }
-    int ppos = room_pos_of(r, client_idx);
-    if (ppos < 0) {
-        return 0;
-    }
-    *out_r = r;
-    *out_ppos = ppos;
-
-    return 1;
-}
-
-void lobby_init(SendLineFn s, SendErrFn e, void* clients_array, int max_clients, int max_rooms) {
-    g_send = s;
-    g_err = e;
-    g_clients = (Client*)clients_array;
-    g_max_clients = max_clients;
-
-    g_limit_rooms=max_rooms;
-    if (g_limit_rooms < 1) {
-        g_limit_rooms=1;
-    }
-    if (g_limit_rooms > MAX_ROOMS) {
-        g_limit_rooms=MAX_ROOMS;
-    }
-
-    memset(g_rooms, 0, sizeof(g_rooms));
-    g_next_room_id=1;
-
-    srand((unsigned int)time(NULL));
-}
-
-void lobby_tick(void) {
-    time_t now = time(NULL);
-
-    for (int ri = 0; ri < g_limit_rooms; ri++) {
-        if (!g_rooms[ri].used) {
-            continue;
-        }
-        Room* r = &g_rooms[ri];
-
-        if (r->phase == ROOM_GAME) {
-            if (room_any_offline(r)) {
-                int off = room_first_offline(r);
-                const char* who = (off >= 0 ? g_clients[off].nick : "");
-                room_pause(r, who);
-
-                if (r->paused && r->pause_started > 0) {
-                    if ((int)(now - r->pause_started) > OFFLINE_TIMEOUT_SEC) {
-                        room_abort_game(r, "reconnect_timeout");
-                        room_broadcast_state(r);
-                    }
-                }
-            }
-            else {
-                if (r->paused) {
-                    room_resume(r);
-                    room_broadcast_state(r);
-                }
-            }
-        }
-    }
-
-    for (int i = 0; i < g_max_clients; i++) {
-        if (g_clients[i].slot == C_EMPTY) {
-            continue;
-        }
-        if (g_clients[i].online) {
-            continue;
-        }
-
-        if ((int)(now - g_clients[i].last_seen) > OFFLINE_TIMEOUT_SEC) {
-            int rid=g_clients[i].room_id;
-            if (rid >= 0) {
-                Room* r = room_by_id(rid);
-                if (r) {
-                    room_broadcastf(r, "EVT PLAYER_LEAVE nick=%s\n", g_clients[i].nick);
-
-                    if (r->phase == ROOM_GAME) {
-                        room_abort_game(r, "player_removed");
-                    }
-
-                    room_remove_player(r, i);
-
-                    if (r->used && r->pcount > 0) {
-                        room_broadcast_state(r);
-                    }
-                }
-            }
-
-            g_clients[i].nick[0] = '\0';
-            g_clients[i].session[0] = '\0';
-            g_clients[i].room_id=-1;
-            g_clients[i].in_game = 0;
-            g_clients[i].fd = -1;
-            g_clients[i].slot = C_EMPTY;
-        }
-    }
-}
-
-void lobby_on_disconnect(int client_idx) {
-    if (client_idx < 0 || client_idx >= g_max_clients) {
-        return;
-    }
-
-    Client* c = &g_clients[client_idx];
-    c->online = 0;
-    c->last_seen = time(NULL);
-
-    if (c->room_id < 0) {
-        return;
-    }
-    Room* r = room_by_id(c->room_id);
-    if (!r) {
-        c->room_id=-1;
-        return;
-    }
-
-    room_broadcastf(r, "EVT PLAYER_OFFLINE nick=%s\n", c->nick);
-
-    if (r->phase == ROOM_GAME) {
-        room_pause(r, c->nick);
-        room_broadcast_state(r);
-    }
-}
-
-void lobby_handle_login(int client_idx, const char* nick) {
-    Client* c = &g_clients[client_idx];
-    c->online = 1;
-
-    if (!nick || !nick[0]) {
-        g_err(client_idx, "LOGIN", "BAD_FORMAT", "missing_nick");
-        return;
-    }
-    if (strlen(nick) >= sizeof(c->nick)) {
-        g_err(client_idx, "LOGIN", "INVALID_VALUE", "nick_too_long");
-        return;
-    }
-
-    int existing = find_client_by_nick(nick);
-    if (existing >= 0 && existing != client_idx) {
-        if (!g_clients[existing].online) {
-            g_err(client_idx, "LOGIN", "NICK_TAKEN", "use_resume_offline");
-        }
-        else {
-            g_err(client_idx, "LOGIN", "NICK_TAKEN", "already_online");
-        }
-        return;
-    }
-
-    snprintf(c->nick, sizeof(c->nick), "%s", nick);
-    make_session(c->session);
-
-    c->room_id=-1;
-    c->in_game = 0;
-
-    sendf(client_idx, "RESP LOGIN ok=1 session=%s\n", c->session);
-}
-
-void lobby_handle_logout(int client_idx) {
-    if (client_idx < 0 || client_idx >= g_max_clients) return;
-
-    Client* c = &g_clients[client_idx];
-
-    int rid=c->room_id;
-
-    if (rid >= 0) {
-        Room* r = room_by_id(rid);
-        if (r) {
-            room_broadcastf(r, "EVT PLAYER_LEAVE nick=%s\n", c->nick);
-
-            if (r->phase == ROOM_GAME) {
-                room_abort_game(r, "logout");
-            }
-
-            room_remove_player(r, client_idx);
-
-            if (r->used && r->pcount > 0) {
-                room_broadcast_state(r);
-            }
-        }
-    }
-
-    if (c->fd >= 0) {
-        sendf(client_idx, "RESP LOGOUT ok=1\n");
-        close(c->fd);
-    }
-
-    c->fd = -1;
-    c->online = 0;
-    c->last_seen = time(NULL);
-
-    c->nick[0] = '\0';
-    c->session[0] = '\0';
-    c->room_id=-1;
-    c->in_game = 0;
-
-    memset(c->rbuf, 0, sizeof(c->rbuf));
-    c->rlen = 0;
-    c->strikes = 0;
-
-    c->slot = C_EMPTY;
-}
-
-void lobby_handle_resume(int client_idx, const char* nick, const char* session) {
-    Client* c = &g_clients[client_idx];
-    c->online = 1;
-    c->last_seen = time(NULL);
-
-    int existing = find_client_by_nick(nick);
-    if (existing < 0) {
-        g_err(client_idx, "RESUME", "BAD_SESSION", "no_such_nick");
-        return;
-    }
-
-    if (strcmp(g_clients[existing].session, session) != 0) {
-        g_err(client_idx, "RESUME", "BAD_SESSION", "token");
-        return;
-    }
-
-    if (existing != client_idx && g_clients[existing].online) {
-        g_err(client_idx, "RESUME", "ALREADY_ONLINE", "use_login");
-        return;
-    }
-
-    if (existing != client_idx) {
-        Client* old = &g_clients[existing];
-
-        char tmp_nick[32];
-        char tmp_ses[64];
-        snprintf(tmp_nick, sizeof(tmp_nick), "%s", old->nick);
-        snprintf(tmp_ses,  sizeof(tmp_ses),  "%s", old->session);
-
-        snprintf(c->nick,    sizeof(c->nick),    "%s", tmp_nick);
-        snprintf(c->session, sizeof(c->session), "%s", tmp_ses);
-
-        c->room_id=old->room_id;
-        c->in_game = old->in_game;
-
-        if (c->room_id >= 0) {
-            Room* r = room_by_id(c->room_id);
-            if (r) {
-                for (int i = 0; i < r->pcount; i++) {
-                    if (r->players[i] == existing) r->players[i] = client_idx;
-                }
-                if (r->host_idx == existing) r->host_idx = client_idx;
-            }
-        }
-
-        memset(old, 0, sizeof(*old));
-        old->slot = C_EMPTY;
-    }
-
-    sendf(client_idx, "RESP RESUME ok=1\n");
-
-    if (c->room_id >= 0) {
-        Room* r = room_by_id(c->room_id);
-        if (r) {
-            char msg[128];
-            snprintf(msg, sizeof(msg), "EVT PLAYER_ONLINE nick=%s\n", c->nick);
-            room_broadcast_except(r, client_idx, msg);
-
-            room_send_roster(r, client_idx);
-            room_send_state(r, client_idx);
-
-            if (r->phase == ROOM_GAME) {
-                int ppos = room_pos_of(r, client_idx);
-                if (ppos >= 0) {
-                    room_send_hand(r, ppos);
-                }
-
-                char top[4];
-                card_to_str(r->game.top_card, top);
-                sendf(client_idx, "EVT TOP card=%s active_suit=%c penalty=%d\n",
-                    top, r->game.active_suit ? r->game.active_suit : '-',
-                    r->game.penalty);
-
-                int tci = r->players[r->game.turn_pos];
-                const char* tn = (tci >= 0) ? g_clients[tci].nick : "-";
-                sendf(client_idx, "EVT TURN nick=%s\n", tn);
-
-                if (r->paused) {
-                    room_resume(r);
-                    room_broadcast_state(r);
-                }
-            }
-        }
-    }
-}
-
-void lobby_handle_list_rooms(int client_idx) {
-    if (!is_logged(client_idx)) {
-        g_err(client_idx, "LIST_ROOMS", "NOT_LOGGED", "login_first");
-        return;
-    }
-
-    int count = 0;
-    for (int i = 0; i < g_limit_rooms; i++) {
-        if (g_rooms[i].used) {
-            count++;
-        }
-    }
-
-    sendf(client_idx, "RESP LIST_ROOMS ok=1 rooms=%d\n", count);
-
-    for (int i = 0; i < g_limit_rooms; i++) {
-        if (!g_rooms[i].used) {
-            continue;
-        }
-        Room* r = &g_rooms[i];
-        const char* st = (r->phase == ROOM_GAME) ? "GAME" : "LOBBY";
-        sendf(client_idx, "EVT ROOM id=%d name=%s players=%d/%d state=%s\n", r->id, r->name, r->pcount, r->size, st);
-    }
-}
-
-void lobby_handle_create_room(int client_idx, const char* name, int size) {
-    if (!is_logged(client_idx)) {
-        g_err(client_idx, "CREATE_ROOM", "NOT_LOGGED", "login_first");
-        return;
-    }
-    if (g_clients[client_idx].room_id >= 0) {
-        g_err(client_idx, "CREATE_ROOM", "BAD_STATE", "already_in_room");
-        return;
-    }
-
-    if (!name || !name[0]) {
-        g_err(client_idx, "CREATE_ROOM", "BAD_FORMAT", "missing_name");
-        return;
-    }
-    if (size < 2 || size > 4) {
-        g_err(client_idx, "CREATE_ROOM", "INVALID_VALUE", "size_2_4");
-        return;
-    }
-
-    int slot = -1;
-    for (int i = 0; i < g_limit_rooms; i++) {
-        if (!g_rooms[i].used) {
-            slot = i;
-            break;
-        }
-    }
-    if (slot < 0) {
-        g_err(client_idx, "CREATE_ROOM", "LIMIT_REACHED", "max_rooms");
-        return;
-    }
-
-    Room* r = &g_rooms[slot];
-    memset(r, 0, sizeof(*r));
-    r->used = 1;
-    r->id=g_next_room_id++;
-    snprintf(r->name, sizeof(r->name), "%s", name);
-    r->size = size;
-    r->phase = ROOM_LOBBY;
-    r->paused = 0;
-    r->pause_started = 0;
-    for (int i = 0; i < MAX_ROOM_PLAYERS; i++) {
-        r->players[i] = -1;
-    }
-
-    r->players[0] = client_idx;
-    r->pcount = 1;
-    r->host_idx = client_idx;
-
-    g_clients[client_idx].room_id=r->id;
-    g_clients[client_idx].in_game = 0;
-
-    sendf(client_idx, "RESP CREATE_ROOM ok=1 room=%d\n", r->id);
-    room_broadcastf(r, "EVT PLAYER_JOIN nick=%s\n", g_clients[client_idx].nick);
-    room_broadcastf(r, "EVT HOST nick=%s\n", g_clients[r->host_idx].nick);
-    room_broadcast_state(r);
-}
-
-void lobby_handle_join_room(int client_idx, int room_id) {
-    if (!is_logged(client_idx)) {
-        g_err(client_idx, "JOIN_ROOM", "NOT_LOGGED", "login_first");
-        return;
-    }
-    if (g_clients[client_idx].room_id >= 0) {
-        g_err(client_idx, "JOIN_ROOM", "BAD_STATE", "already_in_room");
-        return;
-    }
-
-    Room* r = room_by_id(room_id);
-    if (!r) {
-        g_err(client_idx, "JOIN_ROOM", "NO_SUCH_ROOM", "id");
-        return;
-    }
-    if (r->phase != ROOM_LOBBY) {
-        g_err(client_idx, "JOIN_ROOM", "BAD_STATE", "game_running");
-        return;
-    }
-    if (r->pcount >= r->size) {
-        g_err(client_idx, "JOIN_ROOM", "ROOM_FULL", "full");
-        return;
-    }
-
-    r->players[r->pcount++] = client_idx;
-    g_clients[client_idx].room_id=r->id;
-    g_clients[client_idx].in_game = 0;
-
-    sendf(client_idx, "RESP JOIN_ROOM ok=1 room=%d\n", r->id);
-    room_send_roster(r, client_idx);
-    {
-        char msg[128];
-        snprintf(msg, sizeof(msg), "EVT PLAYER_JOIN nick=%s\n", g_clients[client_idx].nick);
-        room_broadcast_except(r, client_idx, msg);
-    }
-    room_send_state(r, client_idx);
-    room_broadcast_state(r);
-}
-
-void lobby_handle_leave_room(int client_idx) {
-    if (!is_logged(client_idx)) {
-        g_err(client_idx, "LEAVE_ROOM", "NOT_LOGGED", "login_first");
-        return;
-    }
-
-    int rid=g_clients[client_idx].room_id;
-    if (rid < 0) {
-        g_err(client_idx, "LEAVE_ROOM", "BAD_STATE", "not_in_room");
-        return;
-    }
-
-    Room* r = room_by_id(rid);
-    if (!r) {
-        g_clients[client_idx].room_id=-1;
-        g_clients[client_idx].in_game = 0;
-        sendf(client_idx, "RESP LEAVE_ROO ok=1\n");
-        return;
-    }
-
-    room_broadcastf(r, "EVT PLAYER_LEAVE nick=%s\n", g_clients[client_idx].nick);
-
-    if (r->phase == ROOM_GAME) {
-        int removed_ppos = room_pos_of(r, client_idx);
-        if (removed_ppos >= 0) {
-            room_remove_player_in_game(r, removed_ppos);
-        } 
-        else {
-            room_remove_player(r, client_idx);
-        }
-    } 
-    else {
-        room_remove_player(r, client_idx);
-    }
-
-    g_clients[client_idx].room_id=-1;
-    g_clients[client_idx].in_game = 0;
-
-    sendf(client_idx, "RESP LEAVE_ROOM ok=1\n");
-
-    if (!r->used) return;
-
-    if (r->phase == ROOM_GAME) {
-        if (r->pcount < 2) {
-            if (r->pcount == 1) {
-                int wci = r->players[0];
-                if (wci >= 0 && g_clients[wci].nick[0]) {
-                    room_broadcastf(r, "EVT GAME_END winner=%s\n", g_clients[wci].nick);
-                }
-            } 
-            else {
-                room_broadcast(r, "EVT GAME_ABORT reason=not_enough_players\n");
-            }
-
-            r->phase = ROOM_LOBBY;
-            r->game.running = 0;
-            for (int i = 0; i < r->pcount; i++) {
-                g_clients[r->players[i]].in_game = 0;
-            }
-
-            room_broadcast_state(r);
-            return;
-        }
-
-        for (int ppos = 0; ppos < r->pcount; ppos++) {
-            room_send_hand(r, ppos);
-        }
-        {
-            int tci = r->players[r->game.turn_pos];
-            if (tci >= 0 && g_clients[tci].nick[0]) {
-                room_broadcastf(r, "EVT TURN nick=%s\n", g_clients[tci].nick);
-            }
-        }
-
-        room_broadcast_state(r);
-        return;
-    }
-
-    if (r->used && r->pcount > 0) {
-        room_broadcast_state(r);
-    }
-}
-
-
-
-void lobby_handle_start_game(int client_idx) {
-    if (!is_logged(client_idx)) {
-        g_err(client_idx, "START_GAME", "NOT_LOGGED", "login_first");
-        return;
-    }
-
-    int rid=g_clients[client_idx].room_id;
-    if (rid < 0) {
-        g_err(client_idx, "START_GAME", "BAD_STATE", "not_in_room"); 
-        return;
-    }
-
-    Room* r = room_by_id(rid);
-    if (!r) {
-        g_err(client_idx, "START_GAME", "BAD_STATE", "no_room");
-        return;
-    }
-    if (r->phase != ROOM_LOBBY) {
-        g_err(client_idx, "START_GAME", "BAD_STATE", "already_running");
-        return;
-    }
-    if (r->host_idx != client_idx) {
-        g_err(client_idx, "START_GAME", "NOT_HOST", "host_only");
-        return;
-    }
-    if (r->pcount < 2) {
-        g_err(client_idx, "START_GAME", "NOT_ENOUGH_PLAYERS", "need_at_least_two");
-        return;
-    }
-
-    init(&r->game, r->pcount, (unsigned int)time(NULL) ^ (unsigned int)r->id);
-    deal(&r->game, r->pcount, 4);
-    pick_start_top(&r->game);
-
-    r->phase = ROOM_GAME;
-    r->paused = 0;
-    r->pause_started = 0;
-
-    for (int i = 0; i < r->pcount; i++) {
-        g_clients[r->players[i]].in_game = 1;
-    }
-
-    sendf(client_idx, "RESP START_GAME ok=1\n");
-
-    room_broadcastf(r, "EVT GAME_START players=%d\n", r->pcount);
-
-    for (int p = 0; p < r->pcount; p++) {
-        room_send_hand(r, p);
-    }
-
-    char top[4];
-    card_to_str(r->game.top_card, top);
-    room_broadcastf(r, "EVT TOP card=%s active_suit=%c penalty=%d\n", top, r->game.active_suit, r->game.penalty);
-
-    int tci = r->players[r->game.turn_pos];
-    room_broadcastf(r, "EVT TURN nick=%s\n", g_clients[tci].nick);
-
-    room_broadcast_state(r);
-}
-
-void lobby_handle_play(int client_idx, const ProtoMsg* m) {
-    int rid=g_clients[client_idx].room_id;
-    if (rid >= 0) {
-        Room* rr = room_by_id(rid);
-        if (rr && rr->phase == ROOM_GAME && rr->paused) {
-            g_err(client_idx, "PLAY", "PAUSED", "wait_for_reconnect");
-            return;
-        }
-    }
-
-    Room* r;
-    int ppos;
-    if (!ensure_in_game(client_idx, &r, &ppos)) {
-        g_err(client_idx, "PLAY", "BAD_STATE", "no_game");
-        return;
-    }
-
-    const char* scard = proto_get(m, "card");
-    const char* wish  = proto_get(m, "wish");
-
-    if (!scard) { 
-        g_err(client_idx, "PLAY", "BAD_FORMAT", "missing_card");
-        return; 
-    }
-
-    unsigned char card;
-    if (!str_to_card(scard, &card)) {
-        g_err(client_idx, "PLAY", "BAD_FORMAT", "bad_card");
-        return;
-    }
-
-    Outcome o;
-    char errc[32] = {0};
-    if (!play(&r->game, r->pcount, ppos, card, wish, &o, errc)) {
-        g_err(client_idx, "PLAY", errc[0] ? errc : "ILLEGAL", "rejected");
-        return;
-    }
-
-    sendf(client_idx, "RESP PLAY ok=1\n");
-
-    if (wish && wish[0] && scard[1] == 'Q') {
-        room_broadcastf(r, "EVT PLAYED nick=%s card=%s wish=%c\n", g_clients[client_idx].nick, scard, wish[0]);
-    } 
-    else {
-        room_broadcastf(r, "EVT PLAYED nick=%s card=%s\n", g_clients[client_idx].nick, scard);
-    }
-
-    char top[4];
-    card_to_str(r->game.top_card, top);
-    room_broadcastf(r, "EVT TOP card=%s active_suit=%c penalty=%d\n", top, r->game.active_suit, r->game.penalty);
-
-    room_send_hand(r, ppos);
-
-    if (r->game.ended && o.winner_pos >= 0) {
-        int wci = r->players[o.winner_pos];
-        room_broadcastf(r, "EVT GAME_END winner=%s\n", g_clients[wci].nick);
-
-        r->phase = ROOM_LOBBY;
-        r->paused = 0;
-        r->pause_started = 0;
-        for (int i = 0; i < r->pcount; i++) {
-            g_clients[r->players[i]].in_game = 0;
-        }
-
-        room_broadcast_state(r);
-        return;
-    }
-
-    int tci = r->players[r->game.turn_pos];
-    room_broadcastf(r, "EVT TURN nick=%s\n", g_clients[tci].nick);
-
-    room_broadcast_state(r);
-}
-
-void lobby_handle_draw(int client_idx) {
-    int rid=g_clients[client_idx].room_id;
-    if (rid >= 0) {
-        Room* rr = room_by_id(rid);
-        if (rr && rr->phase == ROOM_GAME && rr->paused) {
-            g_err(client_idx, "DRAW", "PAUSED", "wait_for_reconnect");
-            return;
-        }
-    }
-
-    Room* r;
-    int ppos;
-    if (!ensure_in_game(client_idx, &r, &ppos)) {
-        g_err(client_idx, "DRAW", "BAD_STATE", "no_game");
-        return;
-    }
-
-    unsigned char drawn[MAX_HAND];
-    int drawn_count = 0;
-    char errc[32] = {0};
-
-    if (!draw(&r->game, r->pcount, ppos, drawn, &drawn_count, errc)) {
-        g_err(client_idx, "DRAW", errc[0] ? errc : "REJECTED", "rejected");
-        return;
-    }
-
-    sendf(client_idx, "RESP DRAW ok=1 count=%d\n", drawn_count);
-
-    room_send_hand(r, ppos);
-
-    int tci = r->players[r->game.turn_pos];
-    room_broadcastf(r, "EVT TURN nick=%s\n", g_clients[tci].nick);
-
-    room_broadcast_state(r);
-}
+#include "lobby.h"
+#include "client.h"
+#include "game.h"
+#include "protocol.h"
+#include "strmap.h"
+#include "slots.h"
+#include "timer.h"
+#include "shard.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/random.h>
+
+#define MAX_ROOM_PLAYERS 4
+#define OFFLINE_TIMEOUT_SEC 120
+#define STATE_LINE_MAX 320      // Longest EVT STATE / EVT STATE_DELTA line (every field value limited to 31 bytes)
+
+#define ROOM_SLOT_BITS 16                           // Low bits of a room id hold the room slot index
+#define ROOM_SLOT_MASK (LOBBY_MAX_ROOMS - 1)
+#define ROOM_GEN_SHIFT (ROOM_SLOT_BITS + SHARD_BITS) // The owning shard sits between the slot and the generation
+#define ROOM_GEN_MAX 0x7FF                          // Generation counter range (keeps ids positive)
+
+/**
+ * @brief Room lifecycle state
+ */
+typedef enum { 
+    ROOM_EMPTY=0, 
+    ROOM_LOBBY=1, 
+    ROOM_GAME=2 
+} RoomPhase;
+
+/**
+ * @brief Fields of the room state that can change, in the order of the EVT STATE line
+ */
+typedef enum {
+    SF_PHASE = 0,
+    SF_PAUSED,
+    SF_TOP,
+    SF_SUIT,
+    SF_PENALTY,
+    SF_TURN,
+    SF_COUNT
+} StateField;
+
+static const char* const g_state_keys[SF_COUNT] = { "phase", "paused", "top", "active_suit", "penalty", "turn" };
+
+typedef struct {
+    int used;               // Whether this room slot is currently allocated and valid
+    int id;                 // Room identifier visible to clients: (generation << ROOM_SLOT_BITS) | slot
+    char name[32];          // Room name 
+    int size;               // Target room capacity (2-4)
+
+    RoomPhase phase;        // Current room phase
+    int paused;             // Whether the running game is currently paused due to an offline player
+    time_t pause_started;
+    Timer pause_timer;      // Reconnect deadline while paused
+
+    int players[MAX_ROOM_PLAYERS];  // Client indices of players in this room
+    int pcount;             // Current number of players present in the room
+    int host_idx;           // Client index of the host
+
+    Game game;              // Game state for this room
+    ShardRoom listed;       // Listing last published to the room directory
+
+    char state_val[SF_COUNT][32];       // Rendered value of every state field
+    unsigned field_ver[SF_COUNT];       // State version in which each field last changed
+    unsigned state_ver;                 // State version, bumped whenever a field value changes (0 before the first render)
+    char state_line[STATE_LINE_MAX];    // EVT STATE line of the current version
+    char delta_line[STATE_LINE_MAX];    // EVT STATE_DELTA line last rendered
+    unsigned delta_ver;                 // State version of delta_line
+    unsigned delta_mask;                // Fields carried by delta_line (bit per StateField)
+    int state_dirty;        // Non-zero if a mutation may have changed a state field
+} Room;
+
+// Lobby state is per shard: every worker thread owns its own copy
+static _Thread_local SendLineFn g_send;          // Function used to send a raw protocol line to a client
+static _Thread_local SendErrFn g_err;            // Function used to send an error response to a client
+static _Thread_local CloseFn g_close;            // Function used to close a client connection
+static _Thread_local ReleaseFn g_release;        // Function used to return an empty client slot to the allocator
+static _Thread_local Client* g_clients;          // Pointer to the client array of this shard
+static _Thread_local int g_max_clients;          // Maximum number of clients available
+
+static _Thread_local StrMap g_by_nick;           // Nickname -> client index of every logged-in (online or offline) client
+static _Thread_local StrMap g_by_session;        // Session token -> client index
+
+static _Thread_local int g_limit_rooms;          // Runtime limit for number of rooms that can be allocated
+
+static _Thread_local Room* g_rooms;              // Room storage (g_limit_rooms entries)
+static _Thread_local unsigned short* g_room_gen; // Per-slot generation, bumped every time the slot is reused
+static _Thread_local SlotPool g_room_slots;      // Free room slots
+static _Thread_local TimerHeap g_timers;         // Offline expiry and pause deadlines
+static _Thread_local uint64_t g_session_rng;     // Fallback generator for session tokens (never shared with games)
+
+/**
+ * @brief Sends a formatted protocol line to a single client
+ *
+ * Formats a message using printf-like formatting and sends it
+ *
+ * @param c     Client index
+ * @param fmt   String for the outgoing line
+ * @param ...   Format arguments
+ */
+static void sendf(int c, const char* fmt, ...) {
+    char out[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(out, sizeof(out), fmt, ap);
+    va_end(ap);
+    g_send(c, out);
+}
+
+/**
+ * @brief Brings the state fields of a room up to date after a mutation
+ *
+ * Every mutation of the phase, pause flag, game or player list sets state_dirty. The fields are rendered again and compared with the previous values, a change bumps the state version once and re-renders the EVT STATE line
+ *
+ * @param r     Pointer to the room
+ */
+static void room_state_refresh(Room* r) {
+    if (!r->state_dirty) {
+        return;
+    }
+    r->state_dirty = 0;
+
+    char val[SF_COUNT][32];
+    snprintf(val[SF_PHASE], sizeof(val[SF_PHASE]), "%s", (r->phase == ROOM_GAME) ? "GAME" : "LOBBY");
+    snprintf(val[SF_PAUSED], sizeof(val[SF_PAUSED]), "%d", r->paused ? 1 : 0);
+    snprintf(val[SF_TOP], sizeof(val[SF_TOP]), "-");
+    if (r->phase == ROOM_GAME) card_to_str(r->game.top_card, val[SF_TOP]);
+    snprintf(val[SF_SUIT], sizeof(val[SF_SUIT]), "%c", r->game.active_suit ? r->game.active_suit : '-');
+    snprintf(val[SF_PENALTY], sizeof(val[SF_PENALTY]), "%d", r->game.penalty);
+
+    const char* turn_nick="-";
+    if (r->phase == ROOM_GAME && r->pcount > 0) {
+        int tci = r->players[r->game.turn_pos];
+        if (tci >= 0) {
+            turn_nick=g_clients[tci].nick;
+        }
+    }
+    snprintf(val[SF_TURN], sizeof(val[SF_TURN]), "%s", turn_nick);
+
+    int changed = 0;
+    for (int f = 0; f < SF_COUNT; f++) {
+        if (r->state_ver == 0 || strcmp(val[f], r->state_val[f]) != 0) {
+            memcpy(r->state_val[f], val[f], sizeof(val[f]));
+            r->field_ver[f] = r->state_ver + 1;
+            changed = 1;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    r->state_ver++;
+
+    snprintf(r->state_line, sizeof(r->state_line), "EVT STATE room=%d phase=%s paused=%s top=%s active_suit=%s penalty=%s turn=%s ver=%u\n", 
+        r->id, r->state_val[SF_PHASE], r->state_val[SF_PAUSED], r->state_val[SF_TOP], r->state_val[SF_SUIT], r->state_val[SF_PENALTY], r->state_val[SF_TURN], r->state_ver
+    );
+}
+
+/**
+ * @brief Sends the full EVT STATE line to a client
+ *
+ * Used when the client has no usable base version (room entered, RESUME), later updates are deltas against the version sent here
+ *
+ * @param r     Pointer to the room
+ * @param ci    Target client index
+ */
+static void room_send_state(Room* r, int ci) {
+    room_state_refresh(r);
+    g_send(ci, r->state_line);
+    g_clients[ci].state_ver = r->state_ver;
+}
+
+/**
+ * @brief Brings a client up to the current state version of its room
+ *
+ * Sends an EVT STATE_DELTA with the fields changed after the client's version, nothing if none did. The stream is reliable and ordered, so a version counts as acknowledged once its line is queued, a client that was offline in between gets the full line on RESUME
+ * Most clients of a broadcast share the same base, the delta line is rendered once per field set
+ *
+ * @param r     Pointer to the room (already refreshed)
+ * @param ci    Target client index
+ */
+static void room_send_delta(Room* r, int ci) {
+    Client* c = &g_clients[ci];
+    if (c->state_ver == 0 || c->state_ver > r->state_ver) {
+        room_send_state(r, ci);
+        return;
+    }
+
+    unsigned mask = 0;
+    for (int f = 0; f < SF_COUNT; f++) {
+        if (r->field_ver[f] > c->state_ver) {
+            mask |= 1u << f;
+        }
+    }
+    c->state_ver = r->state_ver;
+    if (mask == 0) {
+        return;
+    }
+
+    if (r->delta_ver != r->state_ver || r->delta_mask != mask) {
+        int n = snprintf(r->delta_line, sizeof(r->delta_line), "EVT STATE_DELTA ver=%u", r->state_ver);
+        for (int f = 0; f < SF_COUNT; f++) {
+            if (mask & (1u << f)) {
+                n += snprintf(r->delta_line + n, sizeof(r->delta_line) - (size_t)n, " %s=%s", g_state_keys[f], r->state_val[f]);
+            }
+        }
+        snprintf(r->delta_line + n, sizeof(r->delta_line) - (size_t)n, "\n");
+        r->delta_ver = r->state_ver;
+        r->delta_mask = mask;
+    }
+    g_send(ci, r->delta_line);
+}
+
+/**
+ * @brief Sends the full player roster and online state to a specific client
+ *
+ * @param r     Pointer to the room.
+ * @param to_ci Target client index.
+ */
+static void room_send_roster(Room* r, int to_ci) {
+    if (!r) {
+        return;
+    }
+    if (to_ci < 0) {
+        return;
+    }
+    if (g_clients[to_ci].slot == C_EMPTY) {
+        return;
+    }
+
+    if (r->host_idx >= 0 && g_clients[r->host_idx].nick[0]) {
+        sendf(to_ci, "EVT HOST nick=%s\n", g_clients[r->host_idx].nick);
+    }
+
+    for (int i = 0; i < r->pcount; i++) {
+        int ci = r->players[i];
+        if (ci < 0) {
+            continue;
+        }
+        if (g_clients[ci].slot == C_EMPTY) {
+            continue;
+        }
+        if (!g_clients[ci].nick[0]) {
+            continue;
+        }
+
+        sendf(to_ci, "EVT PLAYER_JOIN nick=%s\n", g_clients[ci].nick);
+
+        if (g_clients[ci].online && g_clients[ci].fd >= 0) {
+            sendf(to_ci, "EVT PLAYER_ONLINE nick=%s\n", g_clients[ci].nick);
+        } 
+        else {
+            sendf(to_ci, "EVT PLAYER_OFFLINE nick=%s\n", g_clients[ci].nick);
+        }
+    }
+}
+
+/**
+ * @brief Broadcasts a protocol line to all online clients in a room.
+ *
+ * Sends the given line to every player currently present in the room who is considered online and has a valid socket descriptor
+ *
+ * @param r     Pointer to the room
+ * @param line  Line to broadcast
+ */
+static void room_broadcast(Room* r, const char* line) {
+    for (int i = 0; i < r->pcount; i++) {
+        int ci = r->players[i];
+        if (ci >= 0 && g_clients[ci].slot != C_EMPTY && g_clients[ci].online && g_clients[ci].fd >= 0) {
+            g_send(ci, line);
+        }
+    }
+}
+
+/**
+ * @brief Broadcasts a formatted protocol line to all online clients in a room
+ *
+ * Formats a formatted message sends it to all online players in the room
+ *
+ * @param r     Pointer to the room.
+ * @param fmt   String for the outgoing line
+ * @param ...   Format arguments
+ */
+static void room_broadcastf(Room* r, const char* fmt, ...) {
+    char out[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(out, sizeof(out), fmt, ap);
+    va_end(ap);
+    room_broadcast(r, out);
+}
+
+/**
+ * @brief Publishes the listing of a room to the room directory if it changed
+ *
+ * The directory is shared by all shards, so it is only written when the player count or the phase differs from what was published last
+ *
+ * @param r     Pointer to the room
+ */
+static void room_publish(Room* r) {
+    int in_game = (r->phase == ROOM_GAME);
+    if (r->listed.id == r->id && r->listed.pcount == r->pcount && r->listed.in_game == in_game) {
+        return;
+    }
+    r->listed.id = r->id;
+    snprintf(r->listed.name, sizeof(r->listed.name), "%s", r->name);
+    r->listed.pcount = r->pcount;
+    r->listed.size = r->size;
+    r->listed.in_game = in_game;
+    shard_room_publish((int)(r - g_rooms), &r->listed);
+}
+
+/**
+ * @brief Broadcasts the current state to all online players in the room
+ *
+ * Every player gets an EVT STATE_DELTA against the version it holds, players already up to date get nothing
+ * Also refreshes the room directory, every change of a listed room field is followed by a state broadcast
+ *
+ * @param r     Pointer to the room
+ */
+static void room_broadcast_state(Room* r) {
+    room_publish(r);
+    room_state_refresh(r);
+    for (int i = 0; i < r->pcount; i++) {
+        int ci = r->players[i];
+        if (ci >= 0 && g_clients[ci].slot != C_EMPTY && g_clients[ci].online && g_clients[ci].fd >= 0) {
+            room_send_delta(r, ci);
+        }
+    }
+}
+
+/**
+ * @brief Broadcasts a line to all online players except one client
+ *
+ * @param r         Pointer to the room
+ * @param except_ci Client index to skip
+ * @param line      Line to broadcast
+ */
+static void room_broadcast_except(Room* r, int except_ci, const char* line) {
+    for (int i = 0; i < r->pcount; i++) {
+        int ci = r->players[i];
+        if (ci == except_ci) {
+            continue;
+        }
+        if (ci >= 0 && g_clients[ci].slot != C_EMPTY && g_clients[ci].online && g_clients[ci].fd >= 0) {
+            g_send(ci, line);
+        }
+    }
+}
+
+/**
+ * @brief Checks whether a client is logged in
+ *
+ * A client is considered logged in if they have both a non-empty nickname and a non-empty session token
+ *
+ * @param c     Client index
+ *
+ * @return 1 if logged in, 0 otherwise
+ */
+static int is_logged(int c) {
+    return g_clients[c].nick[0] != '\0' && g_clients[c].session[0] != '\0';
+}
+
+/**
+ * @brief Finds an existing client slot by nickname
+ *
+ * Looks the nick up in the nickname index
+ *
+ * @param nick  Nickname to search for
+ *
+ * @return Client index if found, -1 otherwise
+ */
+static int find_client_by_nick(const char* nick) {
+    return strmap_get(&g_by_nick, nick);
+}
+
+/**
+ * @brief Adds the nickname and session token of a client to the lookup indices
+ *
+ * @param ci    Client index
+ */
+static void index_add(int ci) {
+    if (g_clients[ci].nick[0]) {
+        strmap_put(&g_by_nick, g_clients[ci].nick, ci);
+    }
+    if (g_clients[ci].session[0]) {
+        strmap_put(&g_by_session, g_clients[ci].session, ci);
+    }
+}
+
+/**
+ * @brief Removes the nickname and session token of a client from the lookup indices
+ *
+ * Must be called before the nick or session of the client is cleared or overwritten
+ *
+ * @param ci    Client index
+ */
+static void index_remove(int ci) {
+    if (g_clients[ci].nick[0] && strmap_get(&g_by_nick, g_clients[ci].nick) == ci) {
+        strmap_del(&g_by_nick, g_clients[ci].nick);
+    }
+    if (g_clients[ci].session[0] && strmap_get(&g_by_session, g_clients[ci].session) == ci) {
+        strmap_del(&g_by_session, g_clients[ci].session);
+    }
+}
+
+/**
+ * @brief Locates a room by its room id
+ *
+ * The low bits of the id address the room slot directly. The full id must match as well, so ids of destroyed rooms whose slot has been reused and ids of rooms on other shards are rejected
+ *
+ * @param id    Room id
+ *
+ * @return Pointer to the room if found, NULL otherwise
+ */
+static Room* room_by_id(int id) {
+    if (id <= 0) {
+        return NULL;
+    }
+    int slot = id & ROOM_SLOT_MASK;
+    if (slot >= g_limit_rooms) {
+        return NULL;
+    }
+    Room* r = &g_rooms[slot];
+    if (!r->used || r->id != id) {
+        return NULL;
+    }
+    return r;
+}
+
+/**
+ * @brief Destroys a room and returns its slot to the free list
+ *
+ * @param r     Pointer to the room
+ */
+static void room_release(Room* r) {
+    int slot = (int)(r - g_rooms);
+    timers_cancel(&g_timers, &r->pause_timer);
+    shard_room_publish(slot, NULL);
+    memset(r, 0, sizeof(*r));
+    slots_release(&g_room_slots, slot);
+    shard_room_unreserve(shard_self());
+}
+
+/**
+ * @brief Returns the player position of a client inside a room
+ *
+ * @param r             Pointer to the room
+ * @param client_idx    Client index to locate
+ *
+ * @return Player position if found, -1 otherwise
+ */
+static int room_pos_of(Room* r, int client_idx) {
+    for (int i = 0; i < r->pcount; i++) {
+        if (r->players[i] == client_idx) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Advances a SplitMix64 generator
+ *
+ * @param state     Generator state
+ *
+ * @return Next 64-bit pseudo-random value
+ */
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Generates a new session token string
+ *
+ * Takes 128 bits from the kernel random source, falling back to a lobby-private generator, so tokens never consume a game's random stream
+ *
+ * @param out Output buffer
+ */
+static void make_session(char out[64]) {
+    uint64_t w[2];
+    if (getrandom(w, sizeof(w), GRND_NONBLOCK) != (ssize_t)sizeof(w)) {
+        w[0] = splitmix64(&g_session_rng);
+        w[1] = splitmix64(&g_session_rng);
+    }
+    snprintf(out, 64, "%016llx%016llx", (unsigned long long)w[0], (unsigned long long)w[1]);
+}
+
+/**
+ * @brief Checks whether a client is currently active
+ *
+ * @param ci    Client index
+ *
+ * @return 1 if active, 0 otherwise
+ */
+static int client_is_active(int ci) {
+    if (ci < 0) {
+        return 0;
+    }
+    if (g_clients[ci].slot == C_EMPTY) {
+        return 0;
+    }
+    if (!g_clients[ci].online) {
+        return 0;
+    }
+    if (g_clients[ci].fd < 0) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Tests whether any player in the room is currently offline
+ *
+ * @param r     Pointer to the room
+ *
+ * @return 1 if at least one player is offline, 0 otherwise
+ */
+static int room_any_offline(Room* r) {
+    if (!r || !r->used) {
+        return 0;
+    }
+    for (int i = 0; i < r->pcount; i++) {
+        int ci = r->players[i];
+        if (!client_is_active(ci)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the client index of the first offline player in a room
+ *
+ * @param r     Pointer to the room
+ *
+ * @return Client index of an offline player, or -1 if all are online
+ */
+static int room_first_offline(Room* r) {
+    if (!r || !r->used) {
+        return -1;
+    }
+    for (int i = 0; i < r->pcount; i++) {
+        int ci = r->players[i];
+        if (!client_is_active(ci)) {
+            return ci;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Arms a timer for the moment OFFLINE_TIMEOUT_SEC is exceeded
+ *
+ * @param t     Timer
+ * @param since Start of the timeout (wall-clock time)
+ * @param fn    Expiry callback
+ * @param arg   Callback argument
+ */
+static void arm_offline_deadline(Timer* t, time_t since, TimerFn fn, int arg) {
+    time_t left = since + OFFLINE_TIMEOUT_SEC + 1 - time(NULL);
+    if (left < 1) {
+        left = 1;
+    }
+    timers_arm(&g_timers, t, timer_now_ms() + (uint64_t)left * 1000u, fn, arg);
+}
+
+static void on_pause_timer(int slot);
+
+/**
+ * @brief Pauses an active game if not already paused
+ *
+ * @param r             Pointer to the room
+ * @param reason_nick   Nickname that caused the pause
+ */
+static void room_pause(Room* r, const char* reason_nick) {
+    if (!r || !r->used) {
+        return;
+    }
+    if (r->phase != ROOM_GAME) {
+        return;
+    }
+    if (r->paused) {
+        return;
+    }
+
+    r->paused = 1;
+    r->pause_started = time(NULL);
+    r->state_dirty = 1;
+    arm_offline_deadline(&r->pause_timer, r->pause_started, on_pause_timer, (int)(r - g_rooms));
+
+    if (reason_nick && reason_nick[0]) {
+        room_broadcastf(r, "EVT GAME_PAUSED nick=%s timeout=%d\n", reason_nick, OFFLINE_TIMEOUT_SEC);
+    } 
+    else {
+        room_broadcastf(r, "EVT GAME_PAUSED timeout=%d\n", OFFLINE_TIMEOUT_SEC);
+    }
+}
+
+/**
+ * @brief Resumes a paused game if all players are online again
+ *
+ * @param r     Pointer to the room
+ */
+static void room_resume(Room* r) {
+    if (!r || !r->used) {
+        return;
+    }
+    if (r->phase != ROOM_GAME) {
+        return;
+    }
+    if (!r->paused) {
+        return;
+    }
+
+    if (!room_any_offline(r)) {
+        r->paused = 0;
+        r->pause_started = 0;
+        r->state_dirty = 1;
+        timers_cancel(&g_timers, &r->pause_timer);
+        room_broadcast(r, "EVT GAME_RESUMED\n");
+    }
+}
+
+/**
+ * @brief Aborts an active game and returns the room into lobby state.
+ *
+ * @param r         Pointer to the room
+ * @param reason    Abort reason string
+ */
+static void room_abort_game(Room* r, const char* reason) {
+    if (!r || !r->used) {
+        return;
+    }
+    if (r->phase != ROOM_GAME) {
+        return;
+    }
+
+    r->phase = ROOM_LOBBY;
+    r->paused = 0;
+    r->pause_started = 0;
+    timers_cancel(&g_timers, &r->pause_timer);
+
+    for (int i = 0; i < r->pcount; i++) {
+        int ci = r->players[i];
+        if (ci >= 0 && g_clients[ci].slot != C_EMPTY) {
+            g_clients[ci].in_game = 0;
+        }
+    }
+
+    memset(&r->game, 0, sizeof(r->game));
+    r->state_dirty = 1;
+
+    if (!reason) {
+        reason = "offline_timeout";
+    }
+    room_broadcastf(r, "EVT GAME_ABORT reason=%s\n", reason);
+
+    room_broadcast_state(r);
+}
+
+/**
+ * @brief Brings the pause state of a running game in line with the online state of its players
+ *
+ * Pauses the game if a player is offline, resumes it if everybody is back
+ *
+ * @param r     Pointer to the room
+ */
+static void room_sync_pause(Room* r) {
+    if (!r || !r->used || r->phase != ROOM_GAME) {
+        return;
+    }
+
+    if (room_any_offline(r)) {
+        int off = room_first_offline(r);
+        const char* who = (off >= 0 ? g_clients[off].nick : "");
+        room_pause(r, who);
+    }
+    else if (r->paused) {
+        room_resume(r);
+        room_broadcast_state(r);
+    }
+}
+
+/**
+ * @brief Reconnect deadline of a paused game
+ *
+ * Aborts the game if a player is still offline after OFFLINE_TIMEOUT_SEC, otherwise resumes it
+ *
+ * @param slot  Room slot index
+ */
+static void on_pause_timer(int slot) {
+    Room* r = &g_rooms[slot];
+    if (!r->used || r->phase != ROOM_GAME || !r->paused) {
+        return;
+    }
+
+    if (!room_any_offline(r)) {
+        room_resume(r);
+        room_broadcast_state(r);
+        return;
+    }
+    if ((int)(time(NULL) - r->pause_started) > OFFLINE_TIMEOUT_SEC) {
+        room_abort_game(r, "reconnect_timeout");
+        room_broadcast_state(r);
+        return;
+    }
+    arm_offline_deadline(&r->pause_timer, r->pause_started, on_pause_timer, slot);
+}
+
+
+/**
+ * @brief Sends the current hand of one player to that player
+ *
+ * @param r     Pointer to the room
+ * @param ppos  Player position
+ */
+static void room_send_hand(Room* r, int ppos) {
+    int ci = r->players[ppos];
+    if (ci < 0) {
+        return;
+    }
+
+    char cards[3 * MAX_HAND + 1];
+
+    size_t len = 0;
+    uint32_t hand = r->game.hands[ppos];
+    while (hand) {
+        char cs[4];
+        card_to_str((unsigned char)__builtin_ctz(hand), cs);
+        hand &= hand - 1;
+        cards[len++] = cs[0];
+        cards[len++] = cs[1];
+        if (hand) {
+            cards[len++] = ',';
+        }
+    }
+    cards[len] = '\0';
+
+    sendf(ci, "EVT HAND cards=%s\n", cards);
+}
+
+/**
+ * @brief Removes a client from the room player list
+ *
+ * Updates the players array, decreases player count, reassigns host if the host left, and deletes the room if it becomes empty
+ *
+ * @param r             Pointer to the room
+ * @param client_idx    Client index to remove
+ */
+static void room_remove_player(Room* r, int client_idx) {
+    int pos = room_pos_of(r, client_idx);
+    if (pos < 0) {
+        return;
+    }
+
+    for (int i = pos; i < r->pcount - 1; i++) {
+        r->players[i] = r->players[i + 1];
+    }
+    r->players[r->pcount - 1] = -1;
+    r->pcount--;
+    r->state_dirty = 1;
+
+    if (r->host_idx == client_idx && r->pcount > 0) {
+        r->host_idx = r->players[0];
+        room_broadcastf(r, "EVT HOST nick=%s\n", g_clients[r->host_idx].nick);
+    }
+
+    if (r->pcount == 0) {
+        room_release(r);
+    }
+}
+
+/**
+ * @brief Removes a player during an active game (compacts both room and game state).
+ *
+ * Removes the player at the given player position, shifts room players and also shifts game hands/hand counts. Adjusts turn position so the game can continue with remaining players
+ *
+ * @param r             Pointer to the room
+ * @param removed_ppos  Player position to remove
+ */
+static void room_remove_player_in_game(Room* r, int removed_ppos) {
+    if (!r) {
+        return;
+    }
+    if (removed_ppos < 0 || removed_ppos >= r->pcount) {
+        return;
+    }
+
+    int old_pcount = r->pcount;
+
+    if (r->game.turn_pos > removed_ppos) {
+        r->game.turn_pos--;
+    }
+
+    for (int i = removed_ppos; i < old_pcount - 1; i++) {
+        r->players[i] = r->players[i + 1];
+    }
+    r->players[old_pcount - 1] = -1;
+    r->pcount--;
+    r->state_dirty = 1;
+
+    for (int i = removed_ppos; i < old_pcount - 1; i++) {
+        r->game.hands[i] = r->game.hands[i + 1];
+    }
+    r->game.hands[old_pcount - 1] = 0;
+
+    if (r->pcount > 0) {
+        if (r->game.turn_pos >= r->pcount) {
+            r->game.turn_pos = 0;
+        }
+        if (r->game.turn_pos < 0) {
+            r->game.turn_pos = 0;
+        }
+    } 
+    else {
+        r->game.turn_pos = 0;
+    }
+
+    if (r->host_idx >= 0) {
+        int host_still_inside = 0;
+        for (int i = 0; i < r->pcount; i++) {
+            if (r->players[i] == r->host_idx) {
+                host_still_inside = 1;
+                break;
+            }
+        }
+        if (!host_still_inside && r->pcount > 0) {
+            r->host_idx = r->players[0];
+            room_broadcastf(r, "EVT HOST nick=%s\n", g_clients[r->host_idx].nick);
+        }
+    }
+
+    if (r->pcount == 0) {
+        room_release(r);
+    }
+}
+
+/**
+ * @brief Validates that a client is allowed to perform an in-game action
+ *
+ * @param client_idx    Client index performing the action
+ * @param out_r         Output pointer to the room on success
+ * @param out_ppos      Output player position on success
+ *
+ * @return 1 if valid, 0 otherwise
+ */
+static int ensure_in_game(int client_idx, Room** out_r, int* out_ppos) {
+    int rid=g_clients[client_idx].room_id;
+    if (rid < 0) { 
+        return 0;
+    }
+    Room* r = room_by_id(rid);
+    if (!r) {
+        return 0;
+    }
+    if (r->phase != ROOM_GAME) {
+        return 0;
+    }
+    if (r->paused) {
+        return 0;
+    }
+    int ppos = room_pos_of(r, client_idx);
+    if (ppos < 0) {
+        return 0;
+    }
+    *out_r = r;
+    *out_ppos = ppos;
+
+    return 1;
+}
+
+int lobby_init(SendLineFn s, SendErrFn e, CloseFn cl, ReleaseFn rel, void* clients_array, int max_clients, int max_rooms, Arena* arena) {
+    g_send = s;
+    g_err = e;
+    g_close = cl;
+    g_release = rel;
+    g_clients = (Client*)clients_array;
+    g_max_clients = max_clients;
+
+    g_limit_rooms=max_rooms;
+    if (g_limit_rooms < 1) {
+        g_limit_rooms=1;
+    }
+    if (g_limit_rooms > LOBBY_MAX_ROOMS) {
+        g_limit_rooms=LOBBY_MAX_ROOMS;
+    }
+
+    g_rooms = arena_alloc(arena, (size_t)g_limit_rooms * sizeof(Room));
+    g_room_gen = arena_alloc(arena, (size_t)g_limit_rooms * sizeof(unsigned short));
+    if (!g_rooms || !g_room_gen) {
+        return -1;
+    }
+
+    slots_destroy(&g_room_slots);
+    if (slots_init(&g_room_slots, g_limit_rooms) < 0) {
+        return -1;
+    }
+
+    timers_destroy(&g_timers);
+    if (timers_init(&g_timers, max_clients + g_limit_rooms) < 0) {
+        return -1;
+    }
+
+    strmap_free(&g_by_nick);
+    strmap_free(&g_by_session);
+    if (strmap_init(&g_by_nick, (size_t)max_clients) < 0 || strmap_init(&g_by_session, (size_t)max_clients) < 0) {
+        return -1;
+    }
+
+    g_session_rng = ((uint64_t)time(NULL) << 32) ^ ((uint64_t)shard_self() << 24) ^ (uint64_t)getpid();
+
+    return 0;
+}
+
+/**
+ * @brief Removes an offline client whose session expired
+ *
+ * The client leaves its room (aborting a running game) and the slot is released
+ *
+ * @param i     Client index
+ */
+static void expire_client(int i) {
+    int rid=g_clients[i].room_id;
+    if (rid >= 0) {
+        Room* r = room_by_id(rid);
+        if (r) {
+            room_broadcastf(r, "EVT PLAYER_LEAVE nick=%s\n", g_clients[i].nick);
+
+            if (r->phase == ROOM_GAME) {
+                room_abort_game(r, "player_removed");
+            }
+
+            room_remove_player(r, i);
+
+            if (r->used && r->pcount > 0) {
+                room_broadcast_state(r);
+            }
+        }
+    }
+
+    if (g_clients[i].nick[0]) {
+        shard_nick_release(g_clients[i].nick);
+    }
+    index_remove(i);
+    g_clients[i].nick[0] = '\0';
+    g_clients[i].session[0] = '\0';
+    g_clients[i].room_id=-1;
+    g_clients[i].in_game = 0;
+    g_clients[i].fd = -1;
+    g_release(i);
+}
+
+/**
+ * @brief Offline deadline of a client: expires the session if the client did not come back in time
+ *
+ * @param ci    Client index
+ */
+static void on_offline_timer(int ci) {
+    Client* c = &g_clients[ci];
+    if (c->slot == C_EMPTY || c->online) {
+        return;
+    }
+    if ((int)(time(NULL) - c->last_seen) > OFFLINE_TIMEOUT_SEC) {
+        expire_client(ci);
+        return;
+    }
+    arm_offline_deadline(&c->offline_timer, c->last_seen, on_offline_timer, ci);
+}
+
+void lobby_tick(void) {
+    timers_run(&g_timers, timer_now_ms());
+}
+
+int lobby_next_timeout(void) {
+    return timers_timeout(&g_timers, timer_now_ms());
+}
+
+void lobby_room_counts(int* lobby, int* game, int* paused) {
+    *lobby = 0;
+    *game = 0;
+    *paused = 0;
+    for (int i = 0; i < g_limit_rooms; i++) {
+        const Room* r = &g_rooms[i];
+        if (!r->used) {
+            continue;
+        }
+        if (r->phase == ROOM_GAME) {
+            (*game)++;
+            *paused += r->paused != 0;
+        }
+        else if (r->phase == ROOM_LOBBY) {
+            (*lobby)++;
+        }
+    }
+}
+
+void lobby_on_disconnect(int client_idx) {
+    if (client_idx < 0 || client_idx >= g_max_clients) {
+        return;
+    }
+
+    Client* c = &g_clients[client_idx];
+    c->online = 0;
+    c->last_seen = time(NULL);
+    arm_offline_deadline(&c->offline_timer, c->last_seen, on_offline_timer, client_idx);
+    if (c->nick[0]) {
+        shard_nick_online(c->nick, 0);
+    }
+
+    if (c->room_id < 0) {
+        return;
+    }
+    Room* r = room_by_id(c->room_id);
+    if (!r) {
+        c->room_id=-1;
+        return;
+    }
+
+    room_broadcastf(r, "EVT PLAYER_OFFLINE nick=%s\n", c->nick);
+
+    if (r->phase == ROOM_GAME) {
+        room_pause(r, c->nick);
+        room_broadcast_state(r);
+    }
+}
+
+int lobby_room_shard(int room_id) {
+    if (room_id <= 0) {
+        return -1;
+    }
+    return (room_id >> ROOM_SLOT_BITS) & (SHARD_MAX - 1);
+}
+
+void lobby_on_migrate_out(int client_idx) {
+    Client* c = &g_clients[client_idx];
+    index_remove(client_idx);
+    timers_cancel(&g_timers, &c->offline_timer);
+}
+
+void lobby_on_migrate_in(int client_idx) {
+    index_add(client_idx);
+}
+
+void lobby_handle_login(int client_idx, const char* nick) {
+    Client* c = &g_clients[client_idx];
+    c->online = 1;
+
+    if (!nick || !nick[0]) {
+        g_err(client_idx, "LOGIN", "BAD_FORMAT", "missing_nick");
+        return;
+    }
+    if (strlen(nick) >= sizeof(c->nick)) {
+        g_err(client_idx, "LOGIN", "INVALID_VALUE", "nick_too_long");
+        return;
+    }
+
+    int existing = find_client_by_nick(nick);
+    if (existing >= 0 && existing != client_idx) {
+        if (!g_clients[existing].online) {
+            g_err(client_idx, "LOGIN", "NICK_TAKEN", "use_resume_offline");
+        }
+        else {
+            g_err(client_idx, "LOGIN", "NICK_TAKEN", "already_online");
+        }
+        return;
+    }
+
+    int owner_online = 0;
+    if (existing < 0 && !shard_nick_claim(nick, &owner_online)) {
+        g_err(client_idx, "LOGIN", "NICK_TAKEN", owner_online ? "already_online" : "use_resume_offline");
+        return;
+    }
+    if (c->nick[0] && strcmp(c->nick, nick) != 0) {
+        shard_nick_release(c->nick);
+    }
+
+    index_remove(client_idx);
+    snprintf(c->nick, sizeof(c->nick), "%s", nick);
+    make_session(c->session);
+    index_add(client_idx);
+
+    c->room_id=-1;
+    c->in_game = 0;
+
+    sendf(client_idx, "RESP LOGIN ok=1 session=%s\n", c->session);
+}
+
+void lobby_handle_logout(int client_idx) {
+    if (client_idx < 0 || client_idx >= g_max_clients) return;
+
+    Client* c = &g_clients[client_idx];
+
+    int rid=c->room_id;
+
+    if (rid >= 0) {
+        Room* r = room_by_id(rid);
+        if (r) {
+            room_broadcastf(r, "EVT PLAYER_LEAVE nick=%s\n", c->nick);
+
+            if (r->phase == ROOM_GAME) {
+                room_abort_game(r, "logout");
+            }
+
+            room_remove_player(r, client_idx);
+
+            if (r->used && r->pcount > 0) {
+                room_broadcast_state(r);
+            }
+        }
+    }
+
+    if (c->fd >= 0) {
+        sendf(client_idx, "RESP LOGOUT ok=1\n");
+        g_close(client_idx);
+    }
+
+    c->fd = -1;
+    c->online = 0;
+    c->last_seen = time(NULL);
+
+    if (c->nick[0]) {
+        shard_nick_release(c->nick);
+    }
+    index_remove(client_idx);
+    c->nick[0] = '\0';
+    c->session[0] = '\0';
+    c->room_id=-1;
+    c->in_game = 0;
+
+    c->rhead = 0;
+    c->rlen = 0;
+    c->rscan = 0;
+    c->strikes = 0;
+
+    timers_cancel(&g_timers, &c->offline_timer);
+    g_release(client_idx);
+}
+
+void lobby_handle_resume(int client_idx, const char* nick, const char* session) {
+    Client* c = &g_clients[client_idx];
+    c->online = 1;
+    c->last_seen = time(NULL);
+
+    int existing = find_client_by_nick(nick);
+    if (existing < 0) {
+        g_err(client_idx, "RESUME", "BAD_SESSION", "no_such_nick");
+        return;
+    }
+
+    if (strmap_get(&g_by_session, session) != existing) {
+        g_err(client_idx, "RESUME", "BAD_SESSION", "token");
+        return;
+    }
+
+    if (existing != client_idx && g_clients[existing].online) {
+        g_err(client_idx, "RESUME", "ALREADY_ONLINE", "use_login");
+        return;
+    }
+
+    if (existing != client_idx) {
+        Client* old = &g_clients[existing];
+
+        char tmp_nick[32];
+        char tmp_ses[64];
+        snprintf(tmp_nick, sizeof(tmp_nick), "%s", old->nick);
+        snprintf(tmp_ses,  sizeof(tmp_ses),  "%s", old->session);
+
+        if (c->nick[0] && strcmp(c->nick, tmp_nick) != 0) {
+            shard_nick_release(c->nick);
+        }
+        index_remove(client_idx);
+        snprintf(c->nick,    sizeof(c->nick),    "%s", tmp_nick);
+        snprintf(c->session, sizeof(c->session), "%s", tmp_ses);
+        index_add(client_idx);
+
+        c->room_id=old->room_id;
+        c->in_game = old->in_game;
+
+        if (c->room_id >= 0) {
+            Room* r = room_by_id(c->room_id);
+            if (r) {
+                for (int i = 0; i < r->pcount; i++) {
+                    if (r->players[i] == existing) r->players[i] = client_idx;
+                }
+                if (r->host_idx == existing) r->host_idx = client_idx;
+                r->state_dirty = 1;
+            }
+        }
+
+        timers_cancel(&g_timers, &old->offline_timer);
+        memset(old, 0, sizeof(*old));
+        g_release(existing);
+    }
+
+    shard_nick_online(c->nick, 1);
+    sendf(client_idx, "RESP RESUME ok=1\n");
+
+    if (c->room_id >= 0) {
+        Room* r = room_by_id(c->room_id);
+        if (r) {
+            char msg[128];
+            snprintf(msg, sizeof(msg), "EVT PLAYER_ONLINE nick=%s\n", c->nick);
+            room_broadcast_except(r, client_idx, msg);
+
+            room_send_roster(r, client_idx);
+            room_send_state(r, client_idx);
+
+            if (r->phase == ROOM_GAME) {
+                int ppos = room_pos_of(r, client_idx);
+                if (ppos >= 0) {
+                    room_send_hand(r, ppos);
+                }
+
+                char top[4];
+                card_to_str(r->game.top_card, top);
+                sendf(client_idx, "EVT TOP card=%s active_suit=%c penalty=%d\n",
+                    top, r->game.active_suit ? r->game.active_suit : '-',
+                    r->game.penalty);
+
+                int tci = r->players[r->game.turn_pos];
+                const char* tn = (tci >= 0) ? g_clients[tci].nick : "-";
+                sendf(client_idx, "EVT TURN nick=%s\n", tn);
+
+                if (r->paused) {
+                    room_resume(r);
+                    room_broadcast_state(r);
+                }
+            }
+        }
+    }
+}
+
+void lobby_handle_list_rooms(int client_idx) {
+    if (!is_logged(client_idx)) {
+        g_err(client_idx, "LIST_ROOMS", "NOT_LOGGED", "login_first");
+        return;
+    }
+
+    int count = shard_rooms_lock();
+
+    sendf(client_idx, "RESP LIST_ROOMS ok=1 rooms=%d\n", count);
+
+    int cap = shard_rooms_cap();
+    for (int i = 0; i < cap; i++) {
+        const ShardRoom* e = shard_room_at(i);
+        if (!e->id) {
+            continue;
+        }
+        const char* st = e->in_game ? "GAME" : "LOBBY";
+        sendf(client_idx, "EVT ROOM id=%d name=%s players=%d/%d state=%s\n", e->id, e->name, e->pcount, e->size, st);
+    }
+
+    shard_rooms_unlock();
+}
+
+/**
+ * @brief Checks whether a client may create a room, sending the error if not
+ *
+ * @param client_idx    Index of the client creating the room
+ * @param name          Room name
+ * @param size          Room capacity
+ *
+ * @return 1 if the room can be created, 0 otherwise
+ */
+static int create_room_allowed(int client_idx, const char* name, int size) {
+    if (!is_logged(client_idx)) {
+        g_err(client_idx, "CREATE_ROOM", "NOT_LOGGED", "login_first");
+        return 0;
+    }
+    if (g_clients[client_idx].room_id >= 0) {
+        g_err(client_idx, "CREATE_ROOM", "BAD_STATE", "already_in_room");
+        return 0;
+    }
+
+    if (!name || !name[0]) {
+        g_err(client_idx, "CREATE_ROOM", "BAD_FORMAT", "missing_name");
+        return 0;
+    }
+    if (size < 2 || size > 4) {
+        g_err(client_idx, "CREATE_ROOM", "INVALID_VALUE", "size_2_4");
+        return 0;
+    }
+    return 1;
+}
+
+void lobby_handle_create_room(int client_idx, const char* name, int size, int reserved) {
+    if (!create_room_allowed(client_idx, name, size)) {
+        if (reserved) {
+            shard_room_unreserve(shard_self());
+        }
+        return;
+    }
+
+    // max_rooms is global, the slot pool of a shard only bounds the rooms it can hold
+    if (!reserved && !shard_room_reserve()) {
+        g_err(client_idx, "CREATE_ROOM", "LIMIT_REACHED", "max_rooms");
+        return;
+    }
+    int slot = slots_alloc(&g_room_slots);
+    if (slot < 0) {
+        shard_room_unreserve(shard_self());
+        g_err(client_idx, "CREATE_ROOM", "LIMIT_REACHED", "max_rooms");
+        return;
+    }
+
+    Room* r = &g_rooms[slot];
+    memset(r, 0, sizeof(*r));
+    r->used = 1;
+    g_room_gen[slot] = (unsigned short)(g_room_gen[slot] % ROOM_GEN_MAX + 1);
+    r->id = (g_room_gen[slot] << ROOM_GEN_SHIFT) | (shard_self() << ROOM_SLOT_BITS) | slot;
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->size = size;
+    r->phase = ROOM_LOBBY;
+    r->paused = 0;
+    r->pause_started = 0;
+    for (int i = 0; i < MAX_ROOM_PLAYERS; i++) {
+        r->players[i] = -1;
+    }
+
+    r->players[0] = client_idx;
+    r->pcount = 1;
+    r->host_idx = client_idx;
+    r->state_dirty = 1;
+
+    g_clients[client_idx].room_id=r->id;
+    g_clients[client_idx].in_game = 0;
+    g_clients[client_idx].state_ver = 0;
+
+    sendf(client_idx, "RESP CREATE_ROOM ok=1 room=%d\n", r->id);
+    room_broadcastf(r, "EVT PLAYER_JOIN nick=%s\n", g_clients[client_idx].nick);
+    room_broadcastf(r, "EVT HOST nick=%s\n", g_clients[r->host_idx].nick);
+    room_broadcast_state(r);
+}
+
+void lobby_handle_join_room(int client_idx, int room_id) {
+    if (!is_logged(client_idx)) {
+        g_err(client_idx, "JOIN_ROOM", "NOT_LOGGED", "login_first");
+        return;
+    }
+    if (g_clients[client_idx].room_id >= 0) {
+        g_err(client_idx, "JOIN_ROOM", "BAD_STATE", "already_in_room");
+        return;
+    }
+
+    Room* r = room_by_id(room_id);
+    if (!r) {
+        g_err(client_idx, "JOIN_ROOM", "NO_SUCH_ROOM", "id");
+        return;
+    }
+    if (r->phase != ROOM_LOBBY) {
+        g_err(client_idx, "JOIN_ROOM", "BAD_STATE", "game_running");
+        return;
+    }
+    if (r->pcount >= r->size) {
+        g_err(client_idx, "JOIN_ROOM", "ROOM_FULL", "full");
+        return;
+    }
+
+    r->players[r->pcount++] = client_idx;
+    r->state_dirty = 1;
+    g_clients[client_idx].room_id=r->id;
+    g_clients[client_idx].in_game = 0;
+    g_clients[client_idx].state_ver = 0;
+
+    sendf(client_idx, "RESP JOIN_ROOM ok=1 room=%d\n", r->id);
+    room_send_roster(r, client_idx);
+    {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "EVT PLAYER_JOIN nick=%s\n", g_clients[client_idx].nick);
+        room_broadcast_except(r, client_idx, msg);
+    }
+    room_send_state(r, client_idx);
+    room_broadcast_state(r);
+}
+
+void lobby_handle_leave_room(int client_idx) {
+    if (!is_logged(client_idx)) {
+        g_err(client_idx, "LEAVE_ROOM", "NOT_LOGGED", "login_first");
+        return;
+    }
+
+    int rid=g_clients[client_idx].room_id;
+    if (rid < 0) {
+        g_err(client_idx, "LEAVE_ROOM", "BAD_STATE", "not_in_room");
+        return;
+    }
+
+    Room* r = room_by_id(rid);
+    if (!r) {
+        g_clients[client_idx].room_id=-1;
+        g_clients[client_idx].in_game = 0;
+        sendf(client_idx, "RESP LEAVE_ROO ok=1\n");
+        return;
+    }
+
+    room_broadcastf(r, "EVT PLAYER_LEAVE nick=%s\n", g_clients[client_idx].nick);
+
+    if (r->phase == ROOM_GAME) {
+        int removed_ppos = room_pos_of(r, client_idx);
+        if (removed_ppos >= 0) {
+            room_remove_player_in_game(r, removed_ppos);
+        } 
+        else {
+            room_remove_player(r, client_idx);
+        }
+    } 
+    else {
+        room_remove_player(r, client_idx);
+    }
+
+    g_clients[client_idx].room_id=-1;
+    g_clients[client_idx].in_game = 0;
+
+    sendf(client_idx, "RESP LEAVE_ROOM ok=1\n");
+
+    if (!r->used) return;
+
+    if (r->phase == ROOM_GAME) {
+        if (r->pcount < 2) {
+            if (r->pcount == 1) {
+                int wci = r->players[0];
+                if (wci >= 0 && g_clients[wci].nick[0]) {
+                    room_broadcastf(r, "EVT GAME_END winner=%s\n", g_clients[wci].nick);
+                }
+            } 
+            else {
+                room_broadcast(r, "EVT GAME_ABORT reason=not_enough_players\n");
+            }
+
+            r->phase = ROOM_LOBBY;
+            r->game.running = 0;
+            r->state_dirty = 1;
+            for (int i = 0; i < r->pcount; i++) {
+                g_clients[r->players[i]].in_game = 0;
+            }
+
+            room_broadcast_state(r);
+            return;
+        }
+
+        for (int ppos = 0; ppos < r->pcount; ppos++) {
+            room_send_hand(r, ppos);
+        }
+        {
+            int tci = r->players[r->game.turn_pos];
+            if (tci >= 0 && g_clients[tci].nick[0]) {
+                room_broadcastf(r, "EVT TURN nick=%s\n", g_clients[tci].nick);
+            }
+        }
+
+        room_broadcast_state(r);
+        room_sync_pause(r);
+        return;
+    }
+
+    if (r->used && r->pcount > 0) {
+        room_broadcast_state(r);
+    }
+}
+
+
+
+void lobby_handle_start_game(int client_idx) {
+    if (!is_logged(client_idx)) {
+        g_err(client_idx, "START_GAME", "NOT_LOGGED", "login_first");
+        return;
+    }
+
+    int rid=g_clients[client_idx].room_id;
+    if (rid < 0) {
+        g_err(client_idx, "START_GAME", "BAD_STATE", "not_in_room"); 
+        return;
+    }
+
+    Room* r = room_by_id(rid);
+    if (!r) {
+        g_err(client_idx, "START_GAME", "BAD_STATE", "no_room");
+        return;
+    }
+    if (r->phase != ROOM_LOBBY) {
+        g_err(client_idx, "START_GAME", "BAD_STATE", "already_running");
+        return;
+    }
+    if (r->host_idx != client_idx) {
+        g_err(client_idx, "START_GAME", "NOT_HOST", "host_only");
+        return;
+    }
+    if (r->pcount < 2) {
+        g_err(client_idx, "START_GAME", "NOT_ENOUGH_PLAYERS", "need_at_least_two");
+        return;
+    }
+
+    init(&r->game, r->pcount, ((uint64_t)time(NULL) << 32) ^ (uint64_t)(unsigned int)r->id);
+    deal(&r->game, r->pcount, 4);
+    pick_start_top(&r->game);
+
+    r->phase = ROOM_GAME;
+    r->paused = 0;
+    r->pause_started = 0;
+    r->state_dirty = 1;
+
+    for (int i = 0; i < r->pcount; i++) {
+        g_clients[r->players[i]].in_game = 1;
+    }
+
+    sendf(client_idx, "RESP START_GAME ok=1\n");
+
+    room_broadcastf(r, "EVT GAME_START players=%d\n", r->pcount);
+
+    for (int p = 0; p < r->pcount; p++) {
+        room_send_hand(r, p);
+    }
+
+    char top[4];
+    card_to_str(r->game.top_card, top);
+    room_broadcastf(r, "EVT TOP card=%s active_suit=%c penalty=%d\n", top, r->game.active_suit, r->game.penalty);
+
+    int tci = r->players[r->game.turn_pos];
+    room_broadcastf(r, "EVT TURN nick=%s\n", g_clients[tci].nick);
+
+    room_broadcast_state(r);
+    room_sync_pause(r);
+}
+
+void lobby_handle_play(int client_idx, ProtoMsg* m) {
+    int rid=g_clients[client_idx].room_id;
+    if (rid >= 0) {
+        Room* rr = room_by_id(rid);
+        if (rr && rr->phase == ROOM_GAME && rr->paused) {
+            g_err(client_idx, "PLAY", "PAUSED", "wait_for_reconnect");
+            return;
+        }
+    }
+
+    Room* r;
+    int ppos;
+    if (!ensure_in_game(client_idx, &r, &ppos)) {
+        g_err(client_idx, "PLAY", "BAD_STATE", "no_game");
+        return;
+    }
+
+    const char* scard = proto_get(m, "card");
+    const char* wish  = proto_get(m, "wish");
+
+    if (!scard) { 
+        g_err(client_idx, "PLAY", "BAD_FORMAT", "missing_card");
+        return; 
+    }
+
+    unsigned char card;
+    if (!str_to_card(scard, &card)) {
+        g_err(client_idx, "PLAY", "BAD_FORMAT", "bad_card");
+        return;
+    }
+
+    Outcome o;
+    char errc[32] = {0};
+    if (!play(&r->game, r->pcount, ppos, card, wish, &o, errc)) {
+        g_err(client_idx, "PLAY", errc[0] ? errc : "ILLEGAL", "rejected");
+        return;
+    }
+    r->state_dirty = 1;
+
+    sendf(client_idx, "RESP PLAY ok=1\n");
+
+    if (wish && wish[0] && scard[1] == 'Q') {
+        room_broadcastf(r, "EVT PLAYED nick=%s card=%s wish=%c\n", g_clients[client_idx].nick, scard, wish[0]);
+    } 
+    else {
+        room_broadcastf(r, "EVT PLAYED nick=%s card=%s\n", g_clients[client_idx].nick, scard);
+    }
+
+    char top[4];
+    card_to_str(r->game.top_card, top);
+    room_broadcastf(r, "EVT TOP card=%s active_suit=%c penalty=%d\n", top, r->game.active_suit, r->game.penalty);
+
+    room_send_hand(r, ppos);
+
+    if (r->game.ended && o.winner_pos >= 0) {
+        int wci = r->players[o.winner_pos];
+        room_broadcastf(r, "EVT GAME_END winner=%s\n", g_clients[wci].nick);
+
+        r->phase = ROOM_LOBBY;
+        r->paused = 0;
+        r->pause_started = 0;
+        r->state_dirty = 1;
+        for (int i = 0; i < r->pcount; i++) {
+            g_clients[r->players[i]].in_game = 0;
+        }
+
+        room_broadcast_state(r);
+        return;
+    }
+
+    int tci = r->players[r->game.turn_pos];
+    room_broadcastf(r, "EVT TURN nick=%s\n", g_clients[tci].nick);
+
+    room_broadcast_state(r);
+}
+
+void lobby_handle_draw(int client_idx) {
+    int rid=g_clients[client_idx].room_id;
+    if (rid >= 0) {
+        Room* rr = room_by_id(rid);
+        if (rr && rr->phase == ROOM_GAME && rr->paused) {
+            g_err(client_idx, "DRAW", "PAUSED", "wait_for_reconnect");
+            return;
+        }
+    }
+
+    Room* r;
+    int ppos;
+    if (!ensure_in_game(client_idx, &r, &ppos)) {
+        g_err(client_idx, "DRAW", "BAD_STATE", "no_game");
+        return;
+    }
+
+    unsigned char drawn[MAX_HAND];
+    int drawn_count = 0;
+    char errc[32] = {0};
+
+    if (!draw(&r->game, r->pcount, ppos, drawn, &drawn_count, errc)) {
+        g_err(client_idx, "DRAW", errc[0] ? errc : "REJECTED", "rejected");
+        return;
+    }
+    r->state_dirty = 1;
+
+    sendf(client_idx, "RESP DRAW ok=1 count=%d\n", drawn_count);
+
+    room_send_hand(r, ppos);
+
+    int tci = r->players[r->game.turn_pos];
+    room_broadcastf(r, "EVT TURN nick=%s\n", g_clients[tci].nick);
+
+    room_broadcast_state(r);
+}
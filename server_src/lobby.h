@@ -1,150 +1,210 @@
-/**
- * @file lobby.h
- * @brief Lobby and room management layer
- *
- * Handles login, resume, rooms, player membership, and high-level game control
- * 
- * Seminar work of "Fundamentals of Computer Networks"
- */
-
-#ifndef LOBBY_H
-#define LOBBY_H
-
-#pragma once
-#include "protocol.h"
-
-/**
- * @brief Callback for sending protocol lines to clients
- */
-typedef void (*SendLineFn)(int client_idx, const char* line);
-
-/**
- * @brief Callback for sending protocol error responses
- */
-typedef void (*SendErrFn)(int client_idx, const char* cmd, const char* code, const char* msg);
-
-/**
- * @brief Initializes the lobby subsystem
- *
- * @param s             Callback for sending lines
- * @param e             Callback for sending errors
- * @param clients_array Pointer to Client array
- * @param max_clients   Maximum number of clients
- * @param max_rooms     Maximum number of rooms
- */
-void lobby_init(SendLineFn s, SendErrFn e, void* clients_array, int max_clients, int max_rooms);
-
-/**
- * @brief Periodic lobby maintenance
- *
- * Handles offline timeouts, room cleanup, and paused games
- */
-void lobby_tick(void);
-
-/**
- * @brief Notifies lobby about client disconnection
- *
- * @param client_idx    Client index
- */
-void lobby_on_disconnect(int client_idx);
-
-/**
- * @brief Handles a client login request
- *
- * Assigns a nickname to the client, generates a new session token, and marks the client as logged in
- *
- * @param client_idx    Index of the client in the client array
- * @param nick          Nickname requested by the client
- */
-void lobby_handle_login(int client_idx, const char* nick);
-
-/**
- * @brief Logs out a client from the server
- *
- * Removes the client from any room, notifies other players, closes the network connection, and frees the client slot
- *
- * @param client_idx    Index of the client in the client array
- */
-void lobby_handle_logout(int client_idx);
-
-/**
- * @brief Resumes a previously disconnected client session
- *
- * Reattaches the client to an existing offline session using a nickname and session token. If the client was in a room or an active game, the state is restored
- *
- * @param client_idx    Index of the newly connected client slot
- * @param nick          Nickname of the session to resume
- * @param session       Session token associated with the nickname
- */
-void lobby_handle_resume(int client_idx, const char* nick, const char* session);
-
-/**
- * @brief Sends a list of available rooms to the client
- *
- * Each room includes its ID, name, player count, and current state
- *
- * @param client_idx    Index of the requesting client
- */
-void lobby_handle_list_rooms(int client_idx);
-
-/**
- * @brief Creates a new room and assigns the client as its host
- *
- * The room is created in lobby state and the client automatically joins it as the first player
- *
- * @param client_idx    Index of the client creating the room.
- * @param name          Human-readable name of the room.
- * @param size          Maximum number of players (2–4).
- */
-void lobby_handle_create_room(int client_idx, const char* name, int size);
-
-/**
- * @brief Adds the client to an existing room
- *
- * The client joins the room if it exists, is not full, and is currently in lobby state
- *
- * @param client_idx    Index of the joining client
- * @param room_id       Identifier of the room to join
- */
-void lobby_handle_join_room(int client_idx, int room_id);
-
-/**
- * @brief Removes the client from their current room
- *
- * If the client is the host, host privileges are transferred
- * If the room becomes empty, it is destroyed
- *
- * @param client_idx    Index of the leaving client
- */
-void lobby_handle_leave_room(int client_idx);
-
-/**
- * @brief Starts the game in the client’s current room
- *
- * Only the room host may start the game. The game can start once at least two players are present in the room
- *
- * @param client_idx    Index of the client requesting game start
- */
-void lobby_handle_start_game(int client_idx);
-
-/**
- * @brief Handles a card play request from a client
- *
- * Validates the move according to game rules and updates the game state. Broadcasts the result to all players
- *
- * @param client_idx    Index of the playing client
- * @param m             Parsed protocol message containing play data
- */
-void lobby_handle_play(int client_idx, const ProtoMsg* m);
-
-/**
- * @brief Handles a draw-card request from a client
- *
- * The client draws one or more cards depending on the current penalty state and game rules
- *
- * @param client_idx    Index of the client drawing cards
- */
-void lobby_handle_draw(int client_idx);
-
-
-#endif
+/**
+ * @file lobby.h
+ * @brief Lobby and room management layer
+ *
+ * Handles login, resume, rooms, player membership, and high-level game control
+ * 
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#pragma once
+#include "protocol.h"
+#include "arena.h"
+
+#define LOBBY_MAX_ROOMS (1 << 16)   // Upper bound for rooms per shard (room ids carry a 16-bit slot index)
+
+/**
+ * @brief Callback for sending protocol lines to clients
+ */
+typedef void (*SendLineFn)(int client_idx, const char* line);
+
+/**
+ * @brief Callback for sending protocol error responses
+ */
+typedef void (*SendErrFn)(int client_idx, const char* cmd, const char* code, const char* msg);
+
+/**
+ * @brief Callback for closing a client connection (queued output is flushed first)
+ */
+typedef void (*CloseFn)(int client_idx);
+
+/**
+ * @brief Callback for releasing an empty client slot (offline and logged out)
+ */
+typedef void (*ReleaseFn)(int client_idx);
+
+/**
+ * @brief Initializes the lobby subsystem of the calling shard
+ *
+ * @param s             Callback for sending lines
+ * @param e             Callback for sending errors
+ * @param cl            Callback for closing connections
+ * @param rel           Callback for releasing client slots
+ * @param clients_array Pointer to Client array
+ * @param max_clients   Maximum number of clients
+ * @param max_rooms     Maximum number of rooms on this shard (clamped to LOBBY_MAX_ROOMS)
+ * @param arena         Arena the room table is allocated from
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int lobby_init(SendLineFn s, SendErrFn e, CloseFn cl, ReleaseFn rel, void* clients_array, int max_clients, int max_rooms, Arena* arena);
+
+/**
+ * @brief Lobby maintenance, runs the lobby timers that are due
+ *
+ * Handles offline timeouts, room cleanup, and paused games
+ */
+void lobby_tick(void);
+
+/**
+ * @brief Returns the time until the next lobby deadline
+ *
+ * @return Milliseconds until lobby_tick() has work to do, -1 if no deadline is pending
+ */
+int lobby_next_timeout(void);
+
+/**
+ * @brief Notifies lobby about client disconnection
+ *
+ * @param client_idx    Client index
+ */
+void lobby_on_disconnect(int client_idx);
+
+/**
+ * @brief Returns the shard that owns a room
+ *
+ * @param room_id   Room id as seen by clients
+ *
+ * @return Shard index encoded in the id, -1 for an invalid id
+ */
+int lobby_room_shard(int room_id);
+
+/**
+ * @brief Counts the rooms of this shard by phase
+ *
+ * @param lobby     Output: rooms waiting for a game
+ * @param game      Output: rooms with a running game
+ * @param paused    Output: running games paused for an offline player
+ */
+void lobby_room_counts(int* lobby, int* game, int* paused);
+
+/**
+ * @brief Detaches a client that is about to be handed over to another shard
+ *
+ * The client must be online and not in a room. Its nickname and session stop resolving on this shard
+ *
+ * @param client_idx    Client index
+ */
+void lobby_on_migrate_out(int client_idx);
+
+/**
+ * @brief Attaches a client handed over from another shard
+ *
+ * @param client_idx    Client index the slot contents were copied to
+ */
+void lobby_on_migrate_in(int client_idx);
+
+/**
+ * @brief Handles a client login request
+ *
+ * Assigns a nickname to the client, generates a new session token, and marks the client as logged in
+ *
+ * @param client_idx    Index of the client in the client array
+ * @param nick          Nickname requested by the client
+ */
+void lobby_handle_login(int client_idx, const char* nick);
+
+/**
+ * @brief Logs out a client from the server
+ *
+ * Removes the client from any room, notifies other players, closes the network connection, and frees the client slot
+ *
+ * @param client_idx    Index of the client in the client array
+ */
+void lobby_handle_logout(int client_idx);
+
+/**
+ * @brief Resumes a previously disconnected client session
+ *
+ * Reattaches the client to an existing offline session using a nickname and session token. If the client was in a room or an active game, the state is restored
+ *
+ * @param client_idx    Index of the newly connected client slot
+ * @param nick          Nickname of the session to resume
+ * @param session       Session token associated with the nickname
+ */
+void lobby_handle_resume(int client_idx, const char* nick, const char* session);
+
+/**
+ * @brief Sends a list of available rooms to the client
+ *
+ * Each room includes its ID, name, player count, and current state
+ *
+ * @param client_idx    Index of the requesting client
+ */
+void lobby_handle_list_rooms(int client_idx);
+
+/**
+ * @brief Creates a new room and assigns the client as its host
+ *
+ * The room is created in lobby state and the client automatically joins it as the first player
+ *
+ * @param client_idx    Index of the client creating the room.
+ * @param name          Human-readable name of the room.
+ * @param size          Maximum number of players (2–4).
+ * @param reserved      Non-zero if the room was already reserved on this shard (shard_room_target()), the reservation is consumed either way
+ */
+void lobby_handle_create_room(int client_idx, const char* name, int size, int reserved);
+
+/**
+ * @brief Adds the client to an existing room
+ *
+ * The client joins the room if it exists, is not full, and is currently in lobby state
+ *
+ * @param client_idx    Index of the joining client
+ * @param room_id       Identifier of the room to join
+ */
+void lobby_handle_join_room(int client_idx, int room_id);
+
+/**
+ * @brief Removes the client from their current room
+ *
+ * If the client is the host, host privileges are transferred
+ * If the room becomes empty, it is destroyed
+ *
+ * @param client_idx    Index of the leaving client
+ */
+void lobby_handle_leave_room(int client_idx);
+
+/**
+ * @brief Starts the game in the client’s current room
+ *
+ * Only the room host may start the game. The game can start once at least two players are present in the room
+ *
+ * @param client_idx    Index of the client requesting game start
+ */
+void lobby_handle_start_game(int client_idx);
+
+/**
+ * @brief Handles a card play request from a client
+ *
+ * Validates the move according to game rules and updates the game state. Broadcasts the result to all players
+ *
+ * @param client_idx    Index of the playing client
+ * @param m             Parsed protocol message containing play data
+ */
+void lobby_handle_play(int client_idx, ProtoMsg* m);
+
+/**
+ * @brief Handles a draw-card request from a client
+ *
+ * The client draws one or more cards depending on the current penalty state and game rules
+ *
+ * @param client_idx    Index of the client drawing cards
+ */
+void lobby_handle_draw(int client_idx);
+
+
+#endif
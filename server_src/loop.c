@@ -0,0 +1,116 @@
+#include "loop.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+/**
+ * @brief Converts LOOP_* interest bits to epoll flags
+ *
+ * @param events    LOOP_IN / LOOP_OUT / LOOP_EDGE bits
+ *
+ * @return epoll event mask
+ */
+static uint32_t to_epoll(uint32_t events) {
+    uint32_t e = 0;
+    if (events & LOOP_IN) {
+        e |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (events & LOOP_OUT) {
+        e |= EPOLLOUT;
+    }
+    if (events & LOOP_EDGE) {
+        e |= EPOLLET;
+    }
+    return e;
+}
+
+/**
+ * @brief Performs one epoll_ctl() call
+ *
+ * @param l         Event loop
+ * @param op        EPOLL_CTL_ADD or EPOLL_CTL_MOD
+ * @param fd        Descriptor
+ * @param tag       Tag stored in the event data
+ * @param events    LOOP_* interest bits
+ *
+ * @return 0 on success, -1 on error
+ */
+static int ctl(EventLoop* l, int op, int fd, uint32_t tag, uint32_t events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = to_epoll(events);
+    ev.data.u32 = tag;
+    return epoll_ctl(l->fd, op, fd, &ev);
+}
+
+int loop_init(EventLoop* l, int max_events) {
+    if (!l || max_events < 1) {
+        return -1;
+    }
+    l->fd = epoll_create1(EPOLL_CLOEXEC);
+    if (l->fd < 0) {
+        return -1;
+    }
+    l->evbuf = calloc((size_t)max_events, sizeof(struct epoll_event));
+    if (!l->evbuf) {
+        close(l->fd);
+        l->fd = -1;
+        return -1;
+    }
+    l->max_events = max_events;
+    return 0;
+}
+
+void loop_free(EventLoop* l) {
+    if (!l) {
+        return;
+    }
+    if (l->fd >= 0) {
+        close(l->fd);
+    }
+    free(l->evbuf);
+    l->fd = -1;
+    l->evbuf = NULL;
+    l->max_events = 0;
+}
+
+int loop_add(EventLoop* l, int fd, uint32_t tag, uint32_t events) {
+    return ctl(l, EPOLL_CTL_ADD, fd, tag, events);
+}
+
+int loop_mod(EventLoop* l, int fd, uint32_t tag, uint32_t events) {
+    return ctl(l, EPOLL_CTL_MOD, fd, tag, events);
+}
+
+int loop_del(EventLoop* l, int fd) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    return epoll_ctl(l->fd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int loop_wait(EventLoop* l, LoopEvent* out, int timeout_ms) {
+    struct epoll_event* evs = (struct epoll_event*)l->evbuf;
+
+    int n = epoll_wait(l->fd, evs, l->max_events, timeout_ms);
+    if (n < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        uint32_t e = 0;
+        if (evs[i].events & (EPOLLIN | EPOLLRDHUP)) {
+            e |= LOOP_IN;
+        }
+        if (evs[i].events & EPOLLOUT) {
+            e |= LOOP_OUT;
+        }
+        if (evs[i].events & (EPOLLERR | EPOLLHUP)) {
+            e |= LOOP_ERR;
+        }
+        out[i].tag = evs[i].data.u32;
+        out[i].events = e;
+    }
+    return n;
+}
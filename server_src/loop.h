@@ -0,0 +1,102 @@
+/**
+ * @file loop.h
+ * @brief Readiness-based event loop (epoll reactor)
+ *
+ * Every registered descriptor carries a 32-bit tag (for clients the slot index) that is handed back with each readiness event, so a wakeup only touches the descriptors that are actually ready
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef LOOP_H
+#define LOOP_H
+
+#pragma once
+#include <stdint.h>
+
+#define LOOP_IN     0x01u   // Readable
+#define LOOP_OUT    0x02u   // Writable
+#define LOOP_ERR    0x04u   // Error or hang-up (reported only, never requested)
+#define LOOP_EDGE   0x08u   // Edge-triggered registration
+
+/**
+ * @brief One readiness event returned by loop_wait()
+ */
+typedef struct {
+    uint32_t tag;       // Tag given to loop_add()
+    uint32_t events;    // LOOP_IN / LOOP_OUT / LOOP_ERR bits
+} LoopEvent;
+
+/**
+ * @brief Event loop instance
+ */
+typedef struct {
+    int fd;             // epoll instance descriptor
+    void* evbuf;        // Kernel event buffer (max_events entries)
+    int max_events;     // Capacity of evbuf
+} EventLoop;
+
+/**
+ * @brief Creates an event loop
+ *
+ * @param l             Loop to initialize
+ * @param max_events    Maximum number of events returned by one loop_wait() call
+ *
+ * @return 0 on success, -1 on error
+ */
+int loop_init(EventLoop* l, int max_events);
+
+/**
+ * @brief Releases all resources of an event loop
+ *
+ * @param l     Loop to destroy
+ */
+void loop_free(EventLoop* l);
+
+/**
+ * @brief Registers a descriptor
+ *
+ * @param l         Event loop
+ * @param fd        Descriptor to watch
+ * @param tag       Value reported back in LoopEvent.tag
+ * @param events    LOOP_IN / LOOP_OUT / LOOP_EDGE bits
+ *
+ * @return 0 on success, -1 on error
+ */
+int loop_add(EventLoop* l, int fd, uint32_t tag, uint32_t events);
+
+/**
+ * @brief Changes the tag or interest set of a registered descriptor
+ *
+ * @param l         Event loop
+ * @param fd        Registered descriptor
+ * @param tag       New tag
+ * @param events    New LOOP_IN / LOOP_OUT / LOOP_EDGE bits
+ *
+ * @return 0 on success, -1 on error
+ */
+int loop_mod(EventLoop* l, int fd, uint32_t tag, uint32_t events);
+
+/**
+ * @brief Unregisters a descriptor
+ *
+ * Closing a descriptor unregisters it implicitly, this is only needed when the descriptor stays open
+ *
+ * @param l     Event loop
+ * @param fd    Registered descriptor
+ *
+ * @return 0 on success, -1 on error
+ */
+int loop_del(EventLoop* l, int fd);
+
+/**
+ * @brief Waits for readiness events
+ *
+ * @param l             Event loop
+ * @param out           Output array (at least max_events entries)
+ * @param timeout_ms    Timeout in milliseconds, -1 waits forever
+ *
+ * @return Number of events stored in out, 0 on timeout or interruption, -1 on error
+ */
+int loop_wait(EventLoop* l, LoopEvent* out, int timeout_ms);
+
+#endif
@@ -1,579 +1,2078 @@
-#include <stdio.h>
-#include <string.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <errno.h>
-#include <poll.h>
-#include <time.h>
-#include <signal.h>
-
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-
-#include "net.h"
-#include "protocol.h"
-#include "lobby.h"
-#include "client.h"
-#include "config.h"
-
-#define MAX_CLIENTS 128
-#define MAX_ROOMS 64
-#define LINE_MAX 1024
-#define CLIENT_IDLE_TIMEOUT_SEC 15
-
-static Client g_clients[MAX_CLIENTS];       // Global array of all client slots
-static int g_limit_clients = MAX_CLIENTS;   // Runtime limit for how many client slots are used
-
-static volatile sig_atomic_t g_running = 1; // Main loop running flag
-
-/**
- * @brief Signal handler for graceful shutdown
- *
- * Handles SIGINT/SIGTERM and requests main loop termination
- *
- * @param sig   Signal number
- */
-static void on_signal_stop(int sig) {
-    (void)sig;
-    g_running = 0;
-}
-
-/**
- * @brief Allocates a free client slot and initializes it for a new connection
- *
- * Uses g_limit_clients as the runtime maximum. The client is marked as connected+online, fd is set, room_id is initialized to -1, and last_seen is updated
- *
- * @param fd    Accepted client socket file descriptor
- *
- * @return Index of allocated client slot, or -1 if no free slot exists
- */
-static int alloc_client(int fd) {
-    for (int i = 0; i < g_limit_clients; i++) {
-        if (g_clients[i].slot == C_EMPTY) {
-            memset(&g_clients[i], 0, sizeof(g_clients[i]));
-            g_clients[i].slot = C_CONNECTED;
-            g_clients[i].fd = fd;
-            g_clients[i].room_id = -1;
-            g_clients[i].last_seen = time(NULL);
-            g_clients[i].online = 1;
-            return i;
-        }
-    }
-    return -1;
-}
-
-/**
- * @brief Drops a client connection (disconnect handling)
- *
- * Marks the client as offline and informs lobby layer
- *
- * @param idx   Client slot index
- */
-static void drop_client(int idx) {
-    if (idx < 0) {
-        return;
-    }
-    if (g_clients[idx].slot == C_EMPTY) {
-        return;
-    }
-
-    lobby_on_disconnect(idx);
-
-    if (g_clients[idx].fd >= 0) {
-        close(g_clients[idx].fd);
-    }
-
-    g_clients[idx].fd = -1;
-    g_clients[idx].online = 0;
-    g_clients[idx].last_seen = time(NULL);
-}
-
-/**
- * @brief Periodically drops idle clients based on the last received activity timestamp
- */
-static void keepalive_tick(void) {
-    time_t now = time(NULL);
-
-    for (int i = 0; i < g_limit_clients; i++) {
-        if (g_clients[i].slot == C_EMPTY) {
-            continue;
-        } 
-        if (!g_clients[i].online) {
-            continue;
-        }
-        if (g_clients[i].fd < 0) {
-            continue;
-        }
-
-        if ((int)(now - g_clients[i].last_seen) > CLIENT_IDLE_TIMEOUT_SEC) {
-            drop_client(i);
-        }
-    }
-}
-
-/**
- * @brief Sends a single protocol line to a client if they are online
- *
- * No-op if the slot is empty or the client is offline
- *
- * @param idx   Client slot index
- * @param line  Text line ending with '\n'
- */
-static void send_line(int idx, const char* line) {
-    if (g_clients[idx].slot == C_EMPTY) {
-        return;
-    }
-    if (g_clients[idx].fd < 0) {
-        return;
-    }
-    net_send_all(g_clients[idx].fd, line, strlen(line));
-}
-
-
-/**
- * @brief Sends an error response in protocol format
- *
- * Format: "ERR <cmd> code=<code> msg=<msg>\n"
- *
- * @param idx   Client slot index
- * @param cmd   Command name that caused the error (or "?" when unknown)
- * @param code  Error code token
- * @param msg   Error message token
- */
-static void send_err(int idx, const char* cmd, const char* code, const char* msg) {
-    char out[LINE_MAX];
-    snprintf(out, sizeof(out), "ERR %s code=%s msg=%s\n", cmd, code, msg);
-    send_line(idx, out);
-}
-
-
-/**
- * @brief Dispatches a parsed request message to the lobby/game handlers
- *
- * Validates required fields for some commands before calling lobby handlers
- *
- * @param idx   Client slot index
- * @param m     Parsed protocol message (must be PT_REQ)
- */
-static void handle_req(int idx, const ProtoMsg* m) {
-    if (strcmp(m->cmd, "LOGIN") == 0) {
-        const char* nick = proto_get(m, "nick");
-        if (!nick) { 
-            send_err(idx, "LOGIN", "BAD_FORMAT", "missing_nick"); 
-            return; 
-        }
-        lobby_handle_login(idx, nick);
-
-        return;
-    }
-    if (strcmp(m->cmd, "RESUME") == 0) {
-        const char* nick = proto_get(m, "nick");
-        const char* ses  = proto_get(m, "session");
-        if (!nick || !ses) {
-            send_err(idx, "RESUME", "BAD_FORMAT", "missing_fields");
-            return;
-        }
-        lobby_handle_resume(idx, nick, ses);
-
-        return;
-    }
-    if (strcmp(m->cmd, "LIST_ROOMS") == 0) {
-        lobby_handle_list_rooms(idx);
-        return;
-    }
-    if (strcmp(m->cmd, "CREATE_ROOM") == 0) {
-        const char* name = proto_get(m, "name");
-        const char* size = proto_get(m, "size");
-        if (!name || !size) {
-            send_err(idx, "CREATE_ROOM", "BAD_FORMAT", "missing_fields");
-            return;
-        }
-        lobby_handle_create_room(idx, name, atoi(size));
-
-        return;
-    }
-    if (strcmp(m->cmd, "JOIN_ROOM") == 0) {
-        const char* room = proto_get(m, "room");
-        if (!room) {
-            send_err(idx, "JOIN_ROOM", "BAD_FORMAT", "missing_room");
-            return;
-        }
-        lobby_handle_join_room(idx, atoi(room));
-        
-        return;
-    }
-    if (strcmp(m->cmd, "LEAVE_ROOM") == 0) {
-        lobby_handle_leave_room(idx);
-        return;
-    }
-    if (strcmp(m->cmd, "START_GAME") == 0) {
-        lobby_handle_start_game(idx);
-        return;
-    }
-    if (strcmp(m->cmd, "PLAY") == 0) {
-        lobby_handle_play(idx, m);
-        return;
-    }
-    if (strcmp(m->cmd, "DRAW") == 0) {
-        lobby_handle_draw(idx);
-        return;
-    }
-    if (strcmp(m->cmd, "LOGOUT") == 0) {
-        lobby_handle_logout(idx);
-        return;
-    }
-    if (strcmp(m->cmd, "PING") == 0) {
-        Client* c = &g_clients[idx];
-        c->online = 1;
-        c->last_seen = time(NULL);
-        send_line(idx, "RESP PONG\n");
-
-        return;
-    }
-
-    send_err(idx, m->cmd, "UNKNOWN_CMD", "unknown");
-}
-
-/**
- * @brief Parses one complete line and processes it as a request
- *
- * Invalid protocol increments strikes, returns BAD_FORMAT, and disconnects after 3 strikes
- *
- * @param idx   Client slot index
- * @param line  Null-terminated line
- */
-static void process_line(int idx, const char* line) {
-    ProtoMsg m;
-    ProtoResult r = proto_parse(line, &m);
-    if (r != PROTO_OK) {
-        g_clients[idx].strikes++;
-        send_err(idx, "?", "BAD_FORMAT", "parse_error");
-        if (g_clients[idx].strikes >= 3) {
-            drop_client(idx);
-        }
-
-        return;
-    }
-    if (m.type != PT_REQ) {
-        send_err(idx, m.cmd, "BAD_FORMAT", "expected_req");
-        return;
-    }
-    handle_req(idx, &m);
-}
-
-/**
- * @brief Reads incoming data from a non-blocking socket and processes full lines
- *
- * Buffers partial reads. Splits by '\n'. Each complete line is validated for maximum length and then passed to process_line()
- *
- * @param idx   Client slot index
- */
-static void on_readable(int idx) {
-    Client* c = &g_clients[idx];
-    char tmp[2048];
-
-    for (;;) {
-        ssize_t n = recv(c->fd, tmp, sizeof(tmp), 0);
-        if (n > 0) {
-            c->last_seen = time(NULL);
-            if (c->rlen + (size_t)n > sizeof(c->rbuf)) {
-                send_err(idx, "?", "BAD_FORMAT", "buffer_overflow");
-                drop_client(idx);
-
-                return;
-            }
-            memcpy(c->rbuf + c->rlen, tmp, (size_t)n);
-            c->rlen += (size_t)n;
-
-            size_t start = 0;
-            for (size_t i = 0; i < c->rlen; i++) {
-                if (c->rbuf[i] == '\n') {
-                    size_t len = i - start + 1;
-                    if (len >= LINE_MAX) {
-                        send_err(idx, "?", "BAD_FORMAT", "line_too_long");
-                        drop_client(idx);
-
-                        return;
-                    }
-                    char line[LINE_MAX];
-                    memcpy(line, c->rbuf + start, len);
-                    line[len] = '\0';
-
-                    for (size_t k = 0; k < len; k++) {
-                        if (line[k] == '\r' || line[k] == '\n') {
-                            line[k] = '\0';
-                        }
-                    }
-
-                    if (line[0] != '\0') {
-                        process_line(idx, line);
-                    }
-                    start = i + 1;
-                }
-            }
-            if (start > 0) {
-                memmove(c->rbuf, c->rbuf + start, c->rlen - start);
-                c->rlen -= start;
-            }
-            continue;
-        }
-
-        if (n == 0) {
-            drop_client(idx);
-            return;
-        }
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            return;
-        }
-
-        drop_client(idx);
-
-        return;
-    }
-}
-
-/**
- * @brief Prints server usage/help text
- *
- * @param prog  Program name
- */
-static void usage(const char* prog) {
-    fprintf(stderr,
-        "Usage: %s [-c server.ini] [--ip X] [--port N] [--max-clients N] [--max-rooms N]\n"
-        "Notes:\n"
-        "\tclient limit = %d\n"
-        "\troom limit = %d\n"
-        "Stop:\n"
-        "\tType 'quit' or 'exit'\n",
-        prog, MAX_CLIENTS, MAX_ROOMS
-    );
-}
-
-/**
- * @brief Reads stdin command and stops the server
- *
- * Called only when poll() indicates stdin is readable
- * If stdin is closed, server is stopped as well
- */
-static void handle_stdin_quit(void) {
-    char buf[256];
-    if (!fgets(buf, (int)sizeof(buf), stdin)) {
-        g_running = 0;
-        return;
-    }
-
-    for (size_t i = 0; buf[i]; i++) {
-        if (buf[i] == '\r' || buf[i] == '\n') {
-            buf[i] = '\0';
-            break;
-        }
-    }
-
-    if (strcmp(buf, "quit") == 0 || strcmp(buf, "exit") == 0 || strcmp(buf, "q") == 0) {
-        g_running = 0;
-    }
-}
-
-/**
- * @brief Server entry point
- *
- * @param argc  Argument count
- * @param argv  Argument vector
- *
- * @return 0 on clean exit, non-zero on startup/validation failure
- */
-int main(int argc, char** argv) {
-    signal(SIGPIPE, SIG_IGN);
-
-    signal(SIGINT, on_signal_stop);
-    signal(SIGTERM, on_signal_stop);
-
-    ServerConfig cfg;
-    config_defaults(&cfg);
-
-    const char* config_path = NULL;
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-            usage(argv[0]);
-            return 0;
-        }
-        if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) {
-            if (i + 1 >= argc) { 
-                usage(argv[0]);
-                return 2;
-            }
-            config_path = argv[i + 1];
-            i++;
-        }
-    }
-
-    if (config_path) {
-        if (!config_load_file(&cfg, config_path)) {
-            fprintf(stderr, "Warning: cannot load config file '%s', using defaults\n", config_path);
-        }
-    }
-
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) {
-            i++;
-            continue;
-        }
-
-        if (strcmp(argv[i], "--ip") == 0) {
-            if (i + 1 >= argc) {
-                usage(argv[0]);
-                return 2;
-            }
-            snprintf(cfg.ip, sizeof(cfg.ip), "%s", argv[++i]);
-
-            continue;
-        }
-        if (strcmp(argv[i], "--port") == 0) {
-            if (i + 1 >= argc) {
-                usage(argv[0]);
-                return 2;
-            }
-            cfg.port = atoi(argv[++i]);
-
-            continue;
-        }
-        if (strcmp(argv[i], "--max-clients") == 0 || strcmp(argv[i], "--max_clients") == 0) {
-            if (i + 1 >= argc) {
-                usage(argv[0]);
-                return 2;
-            }
-            cfg.max_clients = atoi(argv[++i]);
-
-            continue;
-        }
-        if (strcmp(argv[i], "--max-rooms") == 0 || strcmp(argv[i], "--max_rooms") == 0) {
-            if (i + 1 >= argc) {
-                usage(argv[0]);
-                return 2;
-            }
-            cfg.max_rooms = atoi(argv[++i]);
-
-            continue;
-        }
-        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-            usage(argv[0]);
-            return 0;
-        }
-    }
-
-    if (cfg.port < 1 || cfg.port > 65535) {
-        fprintf(stderr, "Error: invalid port (%d)\n", cfg.port);
-        return 2;
-    }
-    if (cfg.max_clients < 1) {
-        fprintf(stderr, "Error: invalid max_clients %d\n", cfg.max_clients);
-        return 2;
-    }
-    if (cfg.max_rooms < 1) {
-        fprintf(stderr, "Error: invalid max_rooms %d\n", cfg.max_rooms);
-        return 2;
-    }
-
-    if (cfg.max_clients > MAX_CLIENTS) cfg.max_clients = MAX_CLIENTS;
-    if (cfg.max_rooms > MAX_ROOMS) cfg.max_rooms = MAX_ROOMS;
-
-    g_limit_clients = cfg.max_clients;
-
-    config_print(&cfg);
-
-    lobby_init(send_line, send_err, g_clients, cfg.max_clients, cfg.max_rooms);
-
-    int lfd = net_listen(cfg.ip, cfg.port);
-    if (lfd < 0) {
-        fprintf(stderr, "Listen failed\n");
-        return 1;
-    }
-    printf("Listening on %s:%d\n", cfg.ip, cfg.port);
-    printf("Type 'quit' or 'exit' to stop\n");
-
-    struct pollfd pfds[MAX_CLIENTS + 2];
-    int map[MAX_CLIENTS + 2];
-
-    while (g_running) {
-        int nfd = 0;
-
-        pfds[nfd].fd = 0;
-        pfds[nfd].events = POLLIN;
-        map[nfd] = -2;
-        nfd++;
-
-        pfds[nfd].fd = lfd;
-        pfds[nfd].events = POLLIN;
-        map[nfd] = -1;
-        nfd++;
-
-        for (int i = 0; i < g_limit_clients; i++) {
-            if (g_clients[i].slot != C_EMPTY && g_clients[i].fd >= 0) {
-                pfds[nfd].fd = g_clients[i].fd;
-                pfds[nfd].events = POLLIN;
-                map[nfd] = i;
-                nfd++;
-            }
-        }
-
-        int rc = poll(pfds, nfd, 250);
-        if (rc < 0) {
-            continue;
-        }
-
-        if (pfds[0].revents & POLLIN) {
-            handle_stdin_quit();
-        }
-
-        if (pfds[1].revents & POLLIN) {
-            for (;;) {
-                int cfd = accept(lfd, NULL, NULL);
-                if (cfd < 0) {
-                    break;
-                }
-                net_set_nonblock(cfd);
-                int idx = alloc_client(cfd);
-                if (idx < 0) {
-                    close(cfd);
-                }
-                else {
-                    send_line(idx, "EVT SERVER msg=welcome\n");
-                }
-            }
-        }
-
-        for (int p = 2; p < nfd; p++) {
-            int idx = map[p];
-            if (idx < 0) {
-                continue;
-            }
-
-            if (pfds[p].revents & POLLIN) {
-                on_readable(idx);
-            }
-            if (pfds[p].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-                drop_client(idx);
-            }
-        }
-
-        lobby_tick();
-        keepalive_tick();
-    }
-
-    printf("Shutting down...\n");
-
-    for (int i = 0; i < g_limit_clients; i++) {
-        if (g_clients[i].slot != C_EMPTY && g_clients[i].fd >= 0) {
-            close(g_clients[i].fd);
-            g_clients[i].fd = -1;
-        }
-    }
-
-    if (lfd >= 0) {
-        close(lfd);
-    }
-
-    return 0;
-}
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "net.h"
+#include "protocol.h"
+#include "lobby.h"
+#include "client.h"
+#include "config.h"
+#include "loop.h"
+#include "slots.h"
+#include "arena.h"
+#include "timer.h"
+#include "shard.h"
+#include "uring.h"
+#include "stats.h"
+#include "admin.h"
+#include "wire.h"
+
+#define MAX_CLIENTS_LIMIT (1 << 20)  // Upper bound for max_clients (sanity limit, storage is sized at startup)
+#define LINE_MAX 1024
+#define CLIENT_IDLE_TIMEOUT_SEC 15
+#define LOOP_BATCH 256              // Maximum readiness events handled per wakeup
+#define ACCEPT_BATCH 16             // Maximum connections accepted per listener wakeup, leaves the rest to other shards
+#define GAUGE_PERIOD_MS 1000        // Interval at which every shard samples its load gauges
+
+#define URING_ENTRIES 1024          // Submission ring size of the io_uring backend
+#define URING_BUFS 512              // Provided receive buffers per shard (io_uring backend)
+#define URING_BUF_SIZE 2048         // Size of one provided receive buffer
+#define URING_SEND_CHUNK 4096       // Staging buffer per client for one in-flight send (io_uring backend)
+
+#define OP_RECV    1u               // io_uring tag kinds (top byte of the 64-bit tag)
+#define OP_SEND    2u
+#define OP_ACCEPT  3u
+#define OP_INBOX   4u
+#define OP_CONSOLE 5u
+#define OP_CANCEL  6u
+
+#define IO_RECV 0x01u               // Client slot has a multishot receive armed (io_uring backend)
+#define IO_SEND 0x02u               // Client slot has a send in flight from its staging buffer (io_uring backend)
+
+#define TAG_ADMIN  0xFFFFFFF0u      // First event tag of the metrics endpoint (ADMIN_TAGS tags, shard 0 only)
+#define TAG_INBOX  0xFFFFFFFDu      // Event tag of the shard inbox
+#define TAG_STDIN  0xFFFFFFFEu      // Event tag of the stdin console
+#define TAG_LISTEN 0xFFFFFFFFu      // Event tag of the listening socket
+
+static int g_limit_clients;                 // Number of client slots of every shard (the global max_clients is enforced by shard_client_reserve())
+static size_t g_max_outbuf;                 // Outbound queue limit per client in bytes
+static int g_limit_rooms;                   // Number of room slots of every shard (the global max_rooms is enforced by shard_room_reserve())
+static int g_lfds[SHARD_MAX];               // Listening sockets: one per shard with reuseport, otherwise g_lfds[0] is shared
+static int g_listeners;                     // Number of listening sockets in g_lfds
+static int g_io_uring;                      // Non-zero if shards should run the io_uring backend
+static int g_admin_lfd = -1;                // Listening socket of the metrics endpoint, -1 if disabled
+
+// Everything below is owned by one shard: every worker thread has its own copy
+static _Thread_local Arena g_arena;             // Storage of the client and room tables of this shard
+static _Thread_local Client* g_clients;         // Client slots of this shard
+static _Thread_local SlotPool g_client_slots;   // Free client slots
+static _Thread_local EventLoop g_loop = { .fd = -1 }; // Event loop watching the listener, the inbox and all online clients of this shard
+static _Thread_local TimerHeap g_timers;        // Keepalive deadlines of online clients
+static _Thread_local int g_lfd = -1;            // Listening socket watched by this shard
+
+static _Thread_local int* g_drop_list;          // Clients scheduled for disconnect at a safe point
+static _Thread_local int g_drop_count;          // Number of entries in g_drop_list
+
+static _Thread_local int* g_dirty_list;         // Clients with output staged during this loop iteration
+static _Thread_local int g_dirty_count;         // Number of entries in g_dirty_list
+
+static _Thread_local ShardStats* g_stats;       // Statistics this shard records into
+static _Thread_local Timer g_gauge_timer;       // Next sample of the load gauges
+
+static _Thread_local Uring g_ring = { .fd = -1 }; // io_uring instance, only set up when this shard runs the io_uring backend
+static _Thread_local int g_use_ring;            // Non-zero if this shard runs the io_uring backend
+static _Thread_local unsigned* g_client_gen;    // Per-slot generation, tells completions of a previous connection apart
+static _Thread_local unsigned char* g_io_busy;  // Per-slot IO_RECV / IO_SEND bits (io_uring backend)
+static _Thread_local char* g_send_stage;        // Per-slot staging buffers for in-flight sends (io_uring backend)
+static _Thread_local ShardMsg** g_moving;       // Per-slot handover waiting for the slot's operations to finish (io_uring backend)
+
+static volatile sig_atomic_t g_running = 1; // Main loop running flag, shared by all shards
+
+/**
+ * @brief Signal handler for graceful shutdown
+ *
+ * Handles SIGINT/SIGTERM and requests main loop termination
+ *
+ * @param sig   Signal number
+ */
+static void on_signal_stop(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/**
+ * @brief Initializes a client for a new connection
+ *
+ * The client is marked as connected+online, fd is set, room_id is initialized to -1, and last_seen is updated
+ *
+ * @param c     Client to initialize
+ * @param fd    Accepted client socket file descriptor
+ */
+static void init_client(Client* c, int fd) {
+    memset(c, 0, sizeof(*c));
+    c->slot = C_CONNECTED;
+    c->fd = fd;
+    c->room_id = -1;
+    c->last_seen = time(NULL);
+    c->online = 1;
+}
+
+/**
+ * @brief Allocates a free client slot and initializes it for a new connection
+ *
+ * Takes the slot from the client free list (sized by g_limit_clients)
+ *
+ * @param fd    Accepted client socket file descriptor
+ *
+ * @return Index of allocated client slot, or -1 if no free slot exists
+ */
+static int alloc_client(int fd) {
+    int i = slots_alloc(&g_client_slots);
+    if (i < 0) {
+        return -1;
+    }
+    init_client(&g_clients[i], fd);
+    return i;
+}
+
+/**
+ * @brief Marks a client slot as empty and returns it to the free list
+ *
+ * The connection must already be closed. The client also gives back its share of the global client limit
+ *
+ * @param idx   Client slot index
+ */
+static void release_client(int idx) {
+    g_clients[idx].slot = C_EMPTY;
+    slots_release(&g_client_slots, idx);
+    shard_client_unreserve(shard_self());
+}
+
+/**
+ * @brief Closes the socket of a client and releases its outbound queue
+ *
+ * Queued output gets one last non-blocking flush attempt, whatever does not fit into the socket buffer is discarded
+ * With io_uring the socket is shut down first: operations in flight hold a reference to it, and the shutdown makes them complete
+ *
+ * @param idx   Client slot index
+ */
+static void close_client(int idx) {
+    Client* c = &g_clients[idx];
+    if (c->fd >= 0) {
+        if (!g_use_ring || !(g_io_busy[idx] & IO_SEND)) {
+            net_outbuf_flush(c->fd, &c->out);
+        }
+        if (g_use_ring) {
+            shutdown(c->fd, SHUT_RDWR);
+        }
+        close(c->fd);
+    }
+    net_outbuf_free(&c->out);
+    free(c->wire);
+    c->wire = NULL;
+    timers_cancel(&g_timers, &c->idle_timer);
+    c->fd = -1;
+    c->closing = 0;
+}
+
+/**
+ * @brief Drops a client connection (disconnect handling)
+ *
+ * Marks the client as offline and informs lobby layer
+ *
+ * @param idx   Client slot index
+ */
+static void drop_client(int idx) {
+    if (idx < 0) {
+        return;
+    }
+    if (g_clients[idx].slot == C_EMPTY) {
+        return;
+    }
+    if (g_clients[idx].fd >= 0) {
+        stats_add(&g_stats->drops, 1);
+    }
+
+    lobby_on_disconnect(idx);
+
+    close_client(idx);
+
+    g_clients[idx].online = 0;
+    g_clients[idx].last_seen = time(NULL);
+}
+
+/**
+ * @brief Schedules a client for disconnect
+ *
+ * Used where dropping immediately is unsafe, e.g. while the lobby layer is broadcasting. The client receives nothing more until drop_pending() runs
+ *
+ * @param idx   Client slot index
+ */
+static void schedule_drop(int idx) {
+    if (g_clients[idx].closing) {
+        return;
+    }
+    g_clients[idx].closing = 1;
+    g_drop_list[g_drop_count++] = idx;
+}
+
+/**
+ * @brief Drops all clients scheduled by schedule_drop()
+ *
+ * Disconnect notifications may push further clients over their limit, those are dropped in the same pass
+ */
+static void drop_pending(void) {
+    while (g_drop_count > 0) {
+        int idx = g_drop_list[--g_drop_count];
+        if (g_clients[idx].closing) {
+            drop_client(idx);
+        }
+    }
+}
+
+/**
+ * @brief Starts writing the queued output of a client
+ *
+ * With epoll the queue is written directly. With io_uring a send of the queue front is queued from the client's staging buffer, at most one per client, and the next one follows from its completion
+ *
+ * @param idx   Client slot index
+ *
+ * @return 0 on success (data may remain queued), -1 on error
+ */
+static int flush_client(int idx) {
+    Client* c = &g_clients[idx];
+    if (!g_use_ring) {
+        return (net_outbuf_flush(c->fd, &c->out) < 0) ? -1 : 0;
+    }
+    if (g_io_busy[idx] & IO_SEND) {
+        return 0;
+    }
+
+    char* stage = g_send_stage + (size_t)idx * URING_SEND_CHUNK;
+    size_t n = net_outbuf_peek(&c->out, stage, URING_SEND_CHUNK);
+    if (n == 0) {
+        return 0;
+    }
+    uint64_t tag = ((uint64_t)OP_SEND << 56) | ((uint64_t)(g_client_gen[idx] & 0xFFFFFFu) << 32) | (uint32_t)idx;
+    if (uring_send(&g_ring, c->fd, stage, n, tag) < 0) {
+        return -1;
+    }
+    g_io_busy[idx] |= IO_SEND;
+    return 0;
+}
+
+/**
+ * @brief Starts watching the socket of a client that just got its slot
+ *
+ * epoll reports readiness edge-triggered, io_uring gets a multishot receive. The slot generation is bumped, so completions of an earlier connection in the same slot are ignored
+ *
+ * @param idx   Client slot index
+ *
+ * @return 0 on success, -1 on error
+ */
+static int watch_client(int idx) {
+    g_client_gen[idx]++;
+    if (!g_use_ring) {
+        return loop_add(&g_loop, g_clients[idx].fd, (uint32_t)idx, LOOP_IN | LOOP_OUT | LOOP_EDGE);
+    }
+
+    uint64_t tag = ((uint64_t)OP_RECV << 56) | ((uint64_t)(g_client_gen[idx] & 0xFFFFFFu) << 32) | (uint32_t)idx;
+    if (uring_recv(&g_ring, g_clients[idx].fd, tag) < 0) {
+        return -1;
+    }
+    g_io_busy[idx] |= IO_RECV;
+    return 0;
+}
+
+/**
+ * @brief Writes staged output of all clients touched during this loop iteration
+ *
+ * Every client gets one sendmsg() (or one queued io_uring send) for all lines produced while handling its events instead of one send() per line
+ * Drops triggered by failed writes notify the lobby, which may stage more output, so both lists are processed until empty
+ */
+static void flush_dirty(void) {
+    while (g_dirty_count > 0 || g_drop_count > 0) {
+        while (g_dirty_count > 0) {
+            int idx = g_dirty_list[--g_dirty_count];
+            Client* c = &g_clients[idx];
+            if (!c->dirty) {
+                continue;
+            }
+            c->dirty = 0;
+            if (c->fd < 0 || c->closing) {
+                continue;
+            }
+            if (flush_client(idx) < 0) {
+                schedule_drop(idx);
+            }
+        }
+        drop_pending();
+    }
+}
+
+/**
+ * @brief Writes queued output of a client whose socket became writable
+ *
+ * @param idx   Client slot index
+ */
+static void on_writable(int idx) {
+    Client* c = &g_clients[idx];
+    if (c->closing) {
+        return;
+    }
+    if (net_outbuf_flush(c->fd, &c->out) < 0) {
+        schedule_drop(idx);
+    }
+}
+
+static void on_idle_timer(int idx);
+
+/**
+ * @brief Arms the keepalive timer of a client for the moment its idle timeout would be exceeded
+ *
+ * Activity only updates last_seen. The timer is checked against last_seen when it fires and re-armed if the client was active meanwhile
+ *
+ * @param idx   Client slot index
+ * @param now   Current wall-clock time
+ */
+static void arm_idle_timer(int idx, time_t now) {
+    Client* c = &g_clients[idx];
+    time_t left = c->last_seen + CLIENT_IDLE_TIMEOUT_SEC + 1 - now;
+    if (left < 1) {
+        left = 1;
+    }
+    timers_arm(&g_timers, &c->idle_timer, timer_now_ms() + (uint64_t)left * 1000u, on_idle_timer, idx);
+}
+
+/**
+ * @brief Keepalive deadline of a client: drops the client if it has been idle for too long
+ *
+ * @param idx   Client slot index
+ */
+static void on_idle_timer(int idx) {
+    Client* c = &g_clients[idx];
+    if (c->slot == C_EMPTY || !c->online || c->fd < 0) {
+        return;
+    }
+
+    time_t now = time(NULL);
+    if ((int)(now - c->last_seen) > CLIENT_IDLE_TIMEOUT_SEC) {
+        drop_client(idx);
+        return;
+    }
+    arm_idle_timer(idx, now);
+}
+
+/**
+ * @brief Samples the load gauges of this shard and re-arms itself
+ *
+ * Scanning the slots once per second keeps the counting off the request path
+ *
+ * @param arg   Unused
+ */
+static void on_gauge_timer(int arg) {
+    (void)arg;
+    uint64_t online = 0;
+    uint64_t offline = 0;
+    uint64_t outq = 0;
+    for (int i = 0; i < g_limit_clients; i++) {
+        const Client* c = &g_clients[i];
+        if (c->slot == C_EMPTY) {
+            continue;
+        }
+        if (c->online) {
+            online++;
+            outq += c->out.len;
+        }
+        else {
+            offline++;
+        }
+    }
+
+    int lobby;
+    int game;
+    int paused;
+    lobby_room_counts(&lobby, &game, &paused);
+
+    stats_set(&g_stats->online, online);
+    stats_set(&g_stats->offline, offline);
+    stats_set(&g_stats->outq, outq);
+    stats_set(&g_stats->rooms_lobby, (uint64_t)lobby);
+    stats_set(&g_stats->rooms_game, (uint64_t)game);
+    stats_set(&g_stats->paused, (uint64_t)paused);
+    timers_arm(&g_timers, &g_gauge_timer, timer_now_ms() + GAUGE_PERIOD_MS, on_gauge_timer, 0);
+}
+
+/**
+ * @brief Computes how long the event loop may wait for readiness events
+ *
+ * @return Milliseconds until the nearest keepalive or lobby deadline, -1 if none is armed
+ */
+static int next_timeout(void) {
+    int a = timers_timeout(&g_timers, timer_now_ms());
+    int b = lobby_next_timeout();
+    if (a < 0) {
+        return b;
+    }
+    if (b < 0) {
+        return a;
+    }
+    return (a < b) ? a : b;
+}
+
+/**
+ * @brief Sends a single protocol line to a client if they are online
+ *
+ * The line is staged in the outbound queue and written by flush_dirty() at the end of the loop iteration, together with all other lines produced for this client meanwhile
+ * A client whose queue grows beyond the configured limit is scheduled for disconnect instead of blocking the server
+ * Connections in binary mode get the line converted to frames here, so the lobby keeps producing text for everyone
+ * No-op if the slot is empty, the client is offline or already scheduled for disconnect
+ *
+ * @param idx   Client slot index
+ * @param line  Text line ending with '\n'
+ */
+static void send_line(int idx, const char* line) {
+    Client* c = &g_clients[idx];
+    if (c->slot == C_EMPTY) {
+        return;
+    }
+    if (c->fd < 0 || c->closing) {
+        return;
+    }
+
+    size_t len = strlen(line);
+    unsigned char frames[LINE_MAX + 128];
+    if (c->wire) {
+        int n = wire_encode(line, len, c->wire, frames, sizeof(frames));
+        if (n < 0) {
+            schedule_drop(idx);
+            return;
+        }
+        line = (const char*)frames;
+        len = (size_t)n;
+    }
+    if (net_outbuf_append(&c->out, line, len) < 0 || c->out.len > g_max_outbuf) {
+        schedule_drop(idx);
+        return;
+    }
+    stats_add(&g_stats->bytes_out, len);
+    if (c->dirty) {
+        return;
+    }
+    if (g_dirty_count < g_limit_clients) {
+        c->dirty = 1;
+        g_dirty_list[g_dirty_count++] = idx;
+    }
+    else if (flush_client(idx) < 0) {
+        schedule_drop(idx);
+    }
+}
+
+
+/**
+ * @brief Sends an error response in protocol format
+ *
+ * Format: "ERR <cmd> code=<code> msg=<msg>\n"
+ * The command name is cut to MAX_CMD - 1 bytes and the line always ends with "\n", even if it had to be truncated
+ *
+ * @param idx   Client slot index
+ * @param cmd   Command name that caused the error (or "?" when unknown)
+ * @param code  Error code token
+ * @param msg   Error message token
+ */
+static void send_err(int idx, const char* cmd, const char* code, const char* msg) {
+    char out[LINE_MAX];
+    int n = snprintf(out, sizeof(out), "ERR %.*s code=%s msg=%s\n", MAX_CMD - 1, cmd, code, msg);
+    if (n < 0) {
+        return;
+    }
+    if ((size_t)n >= sizeof(out)) {
+        out[sizeof(out) - 2] = '\n';
+    }
+    send_line(idx, out);
+}
+
+
+/**
+ * @brief Checks whether a client may be handed over to another shard
+ *
+ * Only connected clients outside of rooms move: they own nothing on this shard except their slot and nickname
+ *
+ * @param idx   Client slot index
+ *
+ * @return 1 if the client can move, 0 otherwise
+ */
+static int can_migrate(int idx) {
+    Client* c = &g_clients[idx];
+    return c->fd >= 0 && !c->closing && c->room_id < 0 && !g_moving[idx];
+}
+
+/**
+ * @brief Completes the handover of a client once no operation of this shard refers to its socket any more
+ *
+ * Pending output gets one flush attempt, then the slot contents travel with the message. The slot is freed here without giving back its share of the client limit, the slot claimed on the target takes over
+ * If input that arrived during the handover overflowed rbuf, the client is dropped on this shard instead
+ *
+ * @param idx   Client slot index
+ */
+static void finish_migration(int idx) {
+    Client* c = &g_clients[idx];
+    ShardMsg* m = g_moving[idx];
+    g_moving[idx] = NULL;
+
+    if (c->closing) {
+        if (c->nick[0]) {
+            shard_nick_move(c->nick, shard_self(), 1);
+        }
+        lobby_on_migrate_in(idx);
+        if (m->cmd == HANDOFF_CREATE_ROOM) {
+            shard_room_unreserve(m->target);
+        }
+        shard_client_unclaim(m->target);
+        free(m);
+        drop_client(idx);
+        return;
+    }
+
+    net_outbuf_flush(c->fd, &c->out);
+    m->client = *c;
+    m->client.dirty = 0;
+
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    slots_release(&g_client_slots, idx);
+    shard_client_unclaim(shard_self());
+
+    shard_post(m->target, m);
+}
+
+/**
+ * @brief Hands a client over to another shard, which continues with the given request
+ *
+ * The socket leaves this shard and the input that follows the current line travels with the client. With epoll the handover completes right away. With io_uring the multishot receive is cancelled first, data it still delivers is appended to rbuf, and the last completion of the slot completes the handover
+ *
+ * @param idx       Client slot index
+ * @param target    Target shard
+ * @param cmd       Request to run on the target shard
+ * @param room_id   Room to join (HANDOFF_JOIN_ROOM)
+ * @param nick      Nickname to resume (HANDOFF_RESUME)
+ * @param session   Session token to resume (HANDOFF_RESUME)
+ * @param name      Room name (HANDOFF_CREATE_ROOM)
+ * @param size      Room capacity (HANDOFF_CREATE_ROOM)
+ *
+ * @return 0 if the handover started, -1 if the client stays on this shard (also when the target has no free client slot)
+ */
+static int migrate_client(int idx, int target, HandoffCmd cmd, int room_id, const char* nick, const char* session, const char* name, int size) {
+    Client* c = &g_clients[idx];
+
+    ShardMsg* m = malloc(sizeof(*m));
+    if (!m) {
+        return -1;
+    }
+    if (!shard_client_claim(target)) {
+        free(m);
+        return -1;
+    }
+    if (g_use_ring) {
+        uint64_t recv_tag = ((uint64_t)OP_RECV << 56) | ((uint64_t)(g_client_gen[idx] & 0xFFFFFFu) << 32) | (uint32_t)idx;
+        if ((g_io_busy[idx] & IO_RECV) && uring_cancel(&g_ring, recv_tag, (uint64_t)OP_CANCEL << 56) < 0) {
+            shard_client_unclaim(target);
+            free(m);
+            return -1;
+        }
+    }
+    m->cmd = cmd;
+    m->target = target;
+    m->room_id = room_id;
+    snprintf(m->nick, sizeof(m->nick), "%s", nick ? nick : "");
+    snprintf(m->session, sizeof(m->session), "%s", session ? session : "");
+    snprintf(m->name, sizeof(m->name), "%s", name ? name : "");
+    m->size = size;
+
+    lobby_on_migrate_out(idx);
+    if (c->nick[0]) {
+        shard_nick_move(c->nick, target, 1);
+    }
+    timers_cancel(&g_timers, &c->idle_timer);
+
+    g_moving[idx] = m;
+    if (g_use_ring) {
+        if (!(g_io_busy[idx] & (IO_RECV | IO_SEND))) {
+            finish_migration(idx);
+        }
+        return 0;
+    }
+
+    loop_del(&g_loop, c->fd);
+    finish_migration(idx);
+    return 0;
+}
+
+/**
+ * @brief Handles LOGIN (requires nick)
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_login(int idx, ProtoMsg* m) {
+    const char* nick = proto_get(m, "nick");
+    if (!nick) { 
+        send_err(idx, "LOGIN", "BAD_FORMAT", "missing_nick"); 
+        return; 
+    }
+    lobby_handle_login(idx, nick);
+}
+
+/**
+ * @brief Handles RESUME (requires nick and session)
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_resume(int idx, ProtoMsg* m) {
+    const char* nick = proto_get(m, "nick");
+    const char* ses  = proto_get(m, "session");
+    if (!nick || !ses) {
+        send_err(idx, "RESUME", "BAD_FORMAT", "missing_fields");
+        return;
+    }
+    // Sessions live on the shard that owns the nickname, the client moves there to pick it up
+    int owner = shard_nick_owner(nick);
+    if (owner >= 0 && owner != shard_self() && strlen(ses) < sizeof(g_clients[idx].session) && can_migrate(idx)) {
+        if (migrate_client(idx, owner, HANDOFF_RESUME, -1, nick, ses, NULL, 0) == 0) {
+            return;
+        }
+    }
+    lobby_handle_resume(idx, nick, ses);
+}
+
+/**
+ * @brief Handles LIST_ROOMS
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_list_rooms(int idx, ProtoMsg* m) {
+    (void)m;
+    lobby_handle_list_rooms(idx);
+}
+
+/**
+ * @brief Handles CREATE_ROOM (requires name and size)
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_create_room(int idx, ProtoMsg* m) {
+    const char* name = proto_get(m, "name");
+    const char* size = proto_get(m, "size");
+    if (!name || !size) {
+        send_err(idx, "CREATE_ROOM", "BAD_FORMAT", "missing_fields");
+        return;
+    }
+    // Rooms live on the shard that creates them, a client whose shard has no free room slot moves to one that has
+    if (g_clients[idx].session[0] && can_migrate(idx)) {
+        int target = shard_room_target();
+        if (target >= 0 && target != shard_self()) {
+            if (migrate_client(idx, target, HANDOFF_CREATE_ROOM, -1, NULL, NULL, name, atoi(size)) == 0) {
+                return;
+            }
+            shard_room_unreserve(target);
+        }
+    }
+    lobby_handle_create_room(idx, name, atoi(size), 0);
+}
+
+/**
+ * @brief Handles JOIN_ROOM (requires room)
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_join_room(int idx, ProtoMsg* m) {
+    const char* room = proto_get(m, "room");
+    if (!room) {
+        send_err(idx, "JOIN_ROOM", "BAD_FORMAT", "missing_room");
+        return;
+    }
+    int room_id = atoi(room);
+    int owner = lobby_room_shard(room_id);
+    // Clients that are not logged in get their error here, only a possible join is worth the move
+    if (owner >= 0 && owner < shard_count() && owner != shard_self() && g_clients[idx].session[0] && can_migrate(idx)) {
+        if (migrate_client(idx, owner, HANDOFF_JOIN_ROOM, room_id, NULL, NULL, NULL, 0) == 0) {
+            return;
+        }
+    }
+    lobby_handle_join_room(idx, room_id);
+}
+
+/**
+ * @brief Handles LEAVE_ROOM
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_leave_room(int idx, ProtoMsg* m) {
+    (void)m;
+    lobby_handle_leave_room(idx);
+}
+
+/**
+ * @brief Handles START_GAME
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_start_game(int idx, ProtoMsg* m) {
+    (void)m;
+    lobby_handle_start_game(idx);
+}
+
+/**
+ * @brief Handles PLAY (fields are validated by the lobby layer)
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_play(int idx, ProtoMsg* m) {
+    lobby_handle_play(idx, m);
+}
+
+/**
+ * @brief Handles DRAW
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_draw(int idx, ProtoMsg* m) {
+    (void)m;
+    lobby_handle_draw(idx);
+}
+
+/**
+ * @brief Handles LOGOUT
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_logout(int idx, ProtoMsg* m) {
+    (void)m;
+    lobby_handle_logout(idx);
+}
+
+/**
+ * @brief Handles PING (keepalive)
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_ping(int idx, ProtoMsg* m) {
+    (void)m;
+    Client* c = &g_clients[idx];
+    c->online = 1;
+    c->last_seen = time(NULL);
+    send_line(idx, "RESP PONG\n");
+}
+
+/**
+ * @brief Handles PROTO (mode=binary or mode=text)
+ *
+ * The response is the last message in the old mode, everything after it (in both directions) uses the new one
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed request
+ */
+static void req_proto(int idx, ProtoMsg* m) {
+    Client* c = &g_clients[idx];
+    const char* mode = proto_get(m, "mode");
+    if (!mode) {
+        send_err(idx, "PROTO", "BAD_FORMAT", "missing_mode");
+        return;
+    }
+
+    if (strcmp(mode, "binary") == 0) {
+        send_line(idx, "RESP PROTO ok=1 mode=binary\n");
+        if (!c->wire) {
+            c->wire = calloc(1, sizeof(*c->wire));
+            if (!c->wire) {
+                schedule_drop(idx);
+            }
+        }
+    }
+    else if (strcmp(mode, "text") == 0) {
+        send_line(idx, "RESP PROTO ok=1 mode=text\n");
+        free(c->wire);
+        c->wire = NULL;
+    }
+    else {
+        send_err(idx, "PROTO", "BAD_FORMAT", "unknown_mode");
+    }
+}
+
+/**
+ * @brief Request handler signature
+ */
+typedef void (*ReqHandler)(int idx, ProtoMsg* m);
+
+/**
+ * @brief Request handlers indexed by command ID
+ */
+static const ReqHandler g_handlers[CMD_COUNT] = {
+    [CMD_LOGIN]       = req_login,
+    [CMD_RESUME]      = req_resume,
+    [CMD_LOGOUT]      = req_logout,
+    [CMD_PING]        = req_ping,
+    [CMD_LIST_ROOMS]  = req_list_rooms,
+    [CMD_CREATE_ROOM] = req_create_room,
+    [CMD_JOIN_ROOM]   = req_join_room,
+    [CMD_LEAVE_ROOM]  = req_leave_room,
+    [CMD_START_GAME]  = req_start_game,
+    [CMD_PLAY]        = req_play,
+    [CMD_DRAW]        = req_draw,
+    [CMD_PROTO]       = req_proto,
+};
+
+/**
+ * @brief Dispatches a parsed request message to the lobby/game handlers
+ *
+ * The parser already resolved the command token to a command ID, so dispatch is a single table lookup
+ * The time spent in the handler is recorded in the shard's histogram of the command
+ *
+ * @param idx   Client slot index
+ * @param m     Parsed protocol message (must be PT_REQ)
+ */
+static void handle_req(int idx, ProtoMsg* m) {
+    uint64_t t0 = stats_now_ns();
+    ReqHandler h = g_handlers[m->cmd_id];
+    if (!h) {
+        send_err(idx, m->cmd, "UNKNOWN_CMD", "unknown");
+    }
+    else {
+        h(idx, m);
+    }
+    hist_record(&g_stats->req[m->cmd_id], stats_now_ns() - t0);
+}
+
+/**
+ * @brief Processes a parsed message as a request
+ *
+ * Invalid protocol increments strikes, returns BAD_FORMAT, and disconnects after 3 strikes
+ *
+ * @param idx   Client slot index
+ * @param r     Parse result
+ * @param m     Parsed message
+ */
+static void process_msg(int idx, ProtoResult r, ProtoMsg* m) {
+    if (r != PROTO_OK) {
+        g_clients[idx].strikes++;
+        stats_add(&g_stats->strikes, 1);
+        send_err(idx, "?", "BAD_FORMAT", "parse_error");
+        if (g_clients[idx].strikes >= 3) {
+            drop_client(idx);
+        }
+
+        return;
+    }
+    if (m->type != PT_REQ) {
+        send_err(idx, m->cmd, "BAD_FORMAT", "expected_req");
+        return;
+    }
+    handle_req(idx, m);
+}
+
+/**
+ * @brief Parses one complete line and processes it as a request
+ *
+ * @param idx   Client slot index
+ * @param line  Line inside the receive buffer, tokenized in place
+ * @param len   Line length without terminator
+ */
+static void process_line(int idx, char* line, size_t len) {
+    ProtoMsg m;
+    ProtoResult r = proto_parse(line, len, &m);
+    process_msg(idx, r, &m);
+}
+
+/**
+ * @brief Decodes one complete frame of a binary-mode connection and processes it as a request
+ *
+ * Message frames fill the key-value index directly, without tokenizing any text
+ *
+ * @param idx   Client slot index
+ * @param body  Frame body (opcode first), left unmodified
+ * @param len   Body length
+ */
+static void process_frame(int idx, const unsigned char* body, size_t len) {
+    char text[LINE_MAX];
+    ProtoMsg m;
+
+    if (body[0] == WIRE_OP_TEXT) {
+        // The parser terminates the line behind its last byte, which here is the next frame
+        memcpy(text, body + 1, len - 1);
+        process_line(idx, text, len - 1);
+        return;
+    }
+    ProtoResult r = wire_decode(body, len, NULL, text, sizeof(text), &m);
+    process_msg(idx, r, &m);
+}
+
+/**
+ * @brief Describes the free space of the receive ring
+ *
+ * The free space is split in two when it wraps around the end of rbuf. An empty ring always starts at offset 0, so it is handed out in one piece
+ *
+ * @param c     Client
+ * @param iov   Output segments
+ *
+ * @return Number of segments stored in iov, 0 if the ring is full
+ */
+static int rbuf_free_iov(Client* c, struct iovec iov[2]) {
+    size_t space = sizeof(c->rbuf) - c->rlen;
+    size_t tail = (c->rhead + c->rlen) & (sizeof(c->rbuf) - 1);
+    size_t first = sizeof(c->rbuf) - tail;
+
+    if (space == 0) {
+        return 0;
+    }
+    iov[0].iov_base = c->rbuf + tail;
+    if (first >= space) {
+        iov[0].iov_len = space;
+        return 1;
+    }
+    iov[0].iov_len = first;
+    iov[1].iov_base = c->rbuf;
+    iov[1].iov_len = space - first;
+    return 2;
+}
+
+/**
+ * @brief Finds the next line terminator in the receive ring
+ *
+ * Searches at most two contiguous segments with memchr(), which the C library vectorizes
+ *
+ * @param c     Client
+ * @param from  Offset after rhead to start at
+ *
+ * @return Offset of the '\n' after rhead, rlen if the buffered data holds none
+ */
+static size_t rbuf_find_newline(const Client* c, size_t from) {
+    size_t pos = (c->rhead + from) & (sizeof(c->rbuf) - 1);
+    size_t left = c->rlen - from;
+    size_t first = sizeof(c->rbuf) - pos;
+    if (first > left) {
+        first = left;
+    }
+
+    const char* p = memchr(c->rbuf + pos, '\n', first);
+    if (p) {
+        return from + (size_t)(p - (c->rbuf + pos));
+    }
+    if (left > first) {
+        p = memchr(c->rbuf, '\n', left - first);
+        if (p) {
+            return from + first + (size_t)(p - c->rbuf);
+        }
+    }
+    return c->rlen;
+}
+
+/**
+ * @brief Takes the next complete frame of a binary-mode connection out of the receive ring and processes it
+ *
+ * Frames are decoded in place unless they wrap around the end of rbuf. A malformed or oversized length prefix drops the client, since the stream cannot be resynchronized
+ *
+ * @param idx   Client slot index
+ *
+ * @return 1 if a frame was processed, 0 if no complete frame is buffered, -1 if the client was dropped or is being handed over
+ */
+static int take_frame(int idx) {
+    Client* c = &g_clients[idx];
+    const size_t mask = sizeof(c->rbuf) - 1;
+    unsigned char head[WIRE_HEAD_MAX];
+    unsigned char wrapped[LINE_MAX];
+
+    size_t avail = (c->rlen < sizeof(head)) ? c->rlen : sizeof(head);
+    for (size_t i = 0; i < avail; i++) {
+        head[i] = (unsigned char)c->rbuf[(c->rhead + i) & mask];
+    }
+    size_t len;
+    int h = wire_frame_head(head, avail, &len);
+    if (h == 0) {
+        return 0;
+    }
+    if (h < 0 || len == 0 || len >= LINE_MAX) {
+        send_err(idx, "?", "BAD_FORMAT", "bad_frame");
+        drop_client(idx);
+
+        return -1;
+    }
+    if ((size_t)h + len > c->rlen) {
+        return 0;
+    }
+
+    size_t start = (c->rhead + (size_t)h) & mask;
+    const unsigned char* body = (const unsigned char*)c->rbuf + start;
+    if (start + len > sizeof(c->rbuf)) {
+        size_t first = sizeof(c->rbuf) - start;
+        memcpy(wrapped, c->rbuf + start, first);
+        memcpy(wrapped + first, c->rbuf, len - first);
+        body = wrapped;
+    }
+    c->rhead = (c->rhead + (size_t)h + len) & mask;
+    c->rlen -= (size_t)h + len;
+    c->rscan = 0;
+
+    stats_add(&g_stats->lines, 1);
+    process_frame(idx, body, len);
+    if (c->fd < 0 || g_moving[idx]) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Processes every complete line buffered in rbuf
+ *
+ * Lines are parsed in place inside the ring. Only a line whose terminator wraps around the end of rbuf is copied to the stack first, since the parser terminates the line behind its last byte
+ * Each line is taken out of the ring before it is handled, so a handover started by the request carries only the input that follows it
+ * The search for the terminator resumes at rscan, so bytes of a partial line are not scanned again when more data arrives
+ * A connection in binary mode is served frame by frame instead. The mode is checked before every message, so input pipelined behind a PROTO request is read in the new mode
+ *
+ * @param idx   Client slot index
+ *
+ * @return 0 if the client is still served by this shard, -1 if it was dropped or is being handed over
+ */
+static int process_input(int idx) {
+    Client* c = &g_clients[idx];
+    const size_t mask = sizeof(c->rbuf) - 1;
+    char wrapped[LINE_MAX];
+
+    for (;;) {
+        if (c->wire) {
+            int r = take_frame(idx);
+            if (r < 0) {
+                return -1;
+            }
+            if (r == 0) {
+                break;
+            }
+            continue;
+        }
+
+        size_t i = rbuf_find_newline(c, c->rscan);
+        if (i == c->rlen) {
+            c->rscan = c->rlen;
+            break;
+        }
+
+        size_t len = i + 1;
+        if (len >= LINE_MAX) {
+            send_err(idx, "?", "BAD_FORMAT", "line_too_long");
+            drop_client(idx);
+
+            return -1;
+        }
+        char* line = c->rbuf + c->rhead;
+        if (c->rhead + i >= sizeof(c->rbuf)) {
+            size_t first = sizeof(c->rbuf) - c->rhead;
+            memcpy(wrapped, line, first);
+            memcpy(wrapped + first, c->rbuf, i - first);
+            line = wrapped;
+        }
+        size_t llen = i;
+        char* cr = memchr(line, '\r', llen);
+        if (cr) {
+            llen = (size_t)(cr - line);
+        }
+
+        c->rhead = (c->rhead + len) & mask;
+        c->rlen -= len;
+        c->rscan = 0;
+
+        if (llen > 0) {
+            stats_add(&g_stats->lines, 1);
+            process_line(idx, line, llen);
+            if (c->fd < 0 || g_moving[idx]) {
+                return -1;
+            }
+        }
+    }
+    if (c->rlen == 0) {
+        c->rhead = 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies data from a provided receive buffer into rbuf and processes the complete lines
+ *
+ * During a handover the data is only buffered, the target shard processes it
+ *
+ * @param idx   Client slot index
+ * @param data  Received bytes
+ * @param n     Number of bytes
+ */
+static void on_received(int idx, const char* data, size_t n) {
+    Client* c = &g_clients[idx];
+    c->last_seen = time(NULL);
+    stats_add(&g_stats->bytes_in, n);
+    if (c->rlen + n > sizeof(c->rbuf)) {
+        if (g_moving[idx]) {
+            c->closing = 1;
+            return;
+        }
+        send_err(idx, "?", "BAD_FORMAT", "buffer_overflow");
+        drop_client(idx);
+
+        return;
+    }
+
+    struct iovec iov[2] = { { NULL, 0 }, { NULL, 0 } };
+    rbuf_free_iov(c, iov);
+    size_t first = n < iov[0].iov_len ? n : iov[0].iov_len;
+    memcpy(iov[0].iov_base, data, first);
+    if (n > first) {
+        memcpy(iov[1].iov_base, data + first, n - first);
+    }
+    c->rlen += n;
+
+    if (!g_moving[idx]) {
+        process_input(idx);
+    }
+}
+
+/**
+ * @brief Reads incoming data from a non-blocking socket and processes full lines
+ *
+ * readv() writes straight into the free space of the receive ring, partial lines stay where they are. Splits by '\n' in process_input()
+ * The socket is registered edge-triggered, so it is drained until readv() reports EAGAIN
+ *
+ * @param idx   Client slot index
+ */
+static void on_readable(int idx) {
+    Client* c = &g_clients[idx];
+
+    for (;;) {
+        struct iovec iov[2];
+        int segs = rbuf_free_iov(c, iov);
+        if (segs == 0) {
+            send_err(idx, "?", "BAD_FORMAT", "buffer_overflow");
+            drop_client(idx);
+
+            return;
+        }
+
+        ssize_t n = readv(c->fd, iov, segs);
+        if (n > 0) {
+            c->last_seen = time(NULL);
+            stats_add(&g_stats->bytes_in, (uint64_t)n);
+            c->rlen += (size_t)n;
+            process_input(idx);
+            if (c->fd < 0) {
+                return;
+            }
+            continue;
+        }
+
+        if (n == 0) {
+            drop_client(idx);
+            return;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        }
+
+        drop_client(idx);
+
+        return;
+    }
+}
+
+/**
+ * @brief Takes over a client handed over by another shard and runs the request it moved for
+ *
+ * The client gets a fresh slot and joins the event loop of this shard. Complete lines that arrived behind the request are processed right away, the socket reports anything newer on registration
+ *
+ * @param m     Handover message
+ */
+static void adopt_client(ShardMsg* m) {
+    int idx = slots_alloc(&g_client_slots);
+    if (idx >= 0) {
+        g_clients[idx] = m->client;
+        if (watch_client(idx) < 0) {
+            memset(&g_clients[idx], 0, sizeof(g_clients[idx]));
+            slots_release(&g_client_slots, idx);
+            idx = -1;
+        }
+    }
+    if (idx < 0) {
+        if (m->client.nick[0]) {
+            shard_nick_release(m->client.nick);
+        }
+        close(m->client.fd);
+        net_outbuf_free(&m->client.out);
+        free(m->client.wire);
+        shard_client_unreserve(shard_self());
+        if (m->cmd == HANDOFF_CREATE_ROOM) {
+            shard_room_unreserve(shard_self());
+        }
+        return;
+    }
+
+    Client* c = &g_clients[idx];
+    arm_idle_timer(idx, time(NULL));
+    if (g_use_ring && c->out.len > 0 && flush_client(idx) < 0) {
+        schedule_drop(idx);
+    }
+    lobby_on_migrate_in(idx);
+
+    switch (m->cmd) {
+        case HANDOFF_JOIN_ROOM:
+            lobby_handle_join_room(idx, m->room_id);
+            break;
+        case HANDOFF_RESUME:
+            lobby_handle_resume(idx, m->nick, m->session);
+            break;
+        case HANDOFF_CREATE_ROOM:
+            lobby_handle_create_room(idx, m->name, m->size, 1);
+            break;
+        case HANDOFF_ACCEPT:
+            send_line(idx, "EVT SERVER msg=welcome\n");
+            break;
+    }
+
+    if (c->fd >= 0 && c->rlen > 0) {
+        process_input(idx);
+    }
+}
+
+/**
+ * @brief Takes over all clients waiting in the inbox of this shard
+ */
+static void on_inbox(void) {
+    ShardMsg* m = shard_take();
+    while (m) {
+        ShardMsg* next = m->next;
+        adopt_client(m);
+        free(m);
+        m = next;
+    }
+}
+
+/**
+ * @brief Raises the open file limit so every client slot can hold a socket
+ *
+ * Only the soft limit is raised, up to the hard limit. A warning is printed if the hard limit is too low
+ *
+ * @param want  Number of descriptors needed
+ */
+static void raise_fd_limit(int want) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+        return;
+    }
+    if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur >= (rlim_t)want) {
+        return;
+    }
+
+    rlim_t target = (rlim_t)want;
+    if (rl.rlim_max != RLIM_INFINITY && target > rl.rlim_max) {
+        target = rl.rlim_max;
+    }
+    rl.rlim_cur = target;
+    setrlimit(RLIMIT_NOFILE, &rl);
+
+    if (target < (rlim_t)want) {
+        fprintf(stderr, "Warning: open file limit %lu is below the %d descriptors needed for max_clients\n", (unsigned long)target, want);
+    }
+}
+
+/**
+ * @brief Prints server usage/help text
+ *
+ * @param prog  Program name
+ */
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [-c server.ini] [--ip X] [--port N] [--max-clients N] [--max-rooms N] [--max-outbuf BYTES] [--workers N] [--backlog N] [--reuseport] [--io-uring] [--admin-ip X] [--admin-port N]\n"
+        "Notes:\n"
+        "\tclient limit = %d\n"
+        "\troom limit = %d\n"
+        "\tclient and room storage is allocated at startup from max_clients/max_rooms\n"
+        "\tworker limit = %d (0 = one per online CPU), room slots are split evenly between workers, every worker gets twice its share of client slots, max_clients/max_rooms count across all of them\n"
+        "\t--reuseport opens one SO_REUSEPORT listener per worker\n"
+        "\t--io-uring serves clients through io_uring (falls back to epoll where unavailable), with several workers it implies --reuseport\n"
+        "\t--admin-port serves Prometheus metrics at http://admin-ip:admin-port/metrics (0 = disabled)\n"
+        "Console:\n"
+        "\tType 'stats' to print request latency and traffic counters, 'stats reset' to start a new interval\n"
+        "Stop:\n"
+        "\tType 'quit' or 'exit'\n",
+        prog, MAX_CLIENTS_LIMIT, LOBBY_MAX_ROOMS, SHARD_MAX
+    );
+}
+
+/**
+ * @brief Reads and runs one stdin console command
+ *
+ * Called only when the event loop reports stdin as readable
+ * quit/exit/q stop the server, stats prints the statistics of all shards and stats reset starts a new measurement interval
+ * If stdin is closed, server is stopped as well
+ */
+static void handle_stdin(void) {
+    char buf[256];
+    if (!fgets(buf, (int)sizeof(buf), stdin)) {
+        g_running = 0;
+        return;
+    }
+
+    for (size_t i = 0; buf[i]; i++) {
+        if (buf[i] == '\r' || buf[i] == '\n') {
+            buf[i] = '\0';
+            break;
+        }
+    }
+
+    if (strcmp(buf, "quit") == 0 || strcmp(buf, "exit") == 0 || strcmp(buf, "q") == 0) {
+        g_running = 0;
+    }
+    else if (strcmp(buf, "stats") == 0) {
+        stats_print(stdout);
+    }
+    else if (strcmp(buf, "stats reset") == 0) {
+        stats_reset();
+        printf("stats reset\n");
+        fflush(stdout);
+    }
+}
+
+/**
+ * @brief Takes a freshly accepted connection into this shard and greets it
+ *
+ * The connection is closed right away if the global client limit is reached. If this shard has no free slot, the connection is handed to the shard the slot was reserved on
+ *
+ * @param cfd   Accepted non-blocking socket
+ */
+static void add_client(int cfd) {
+    int target = shard_client_reserve();
+    if (target < 0) {
+        close(cfd);
+        return;
+    }
+    if (target != shard_self()) {
+        ShardMsg* m = malloc(sizeof(*m));
+        if (!m) {
+            shard_client_unreserve(target);
+            close(cfd);
+            return;
+        }
+        memset(m, 0, sizeof(*m));
+        m->cmd = HANDOFF_ACCEPT;
+        m->target = target;
+        m->room_id = -1;
+        init_client(&m->client, cfd);
+        shard_post(target, m);
+        return;
+    }
+    int idx = alloc_client(cfd);
+    if (idx < 0) {
+        shard_client_unreserve(target);
+        close(cfd);
+        return;
+    }
+    if (watch_client(idx) < 0) {
+        close(cfd);
+        g_clients[idx].fd = -1;
+        release_client(idx);
+        return;
+    }
+    arm_idle_timer(idx, g_clients[idx].last_seen);
+    send_line(idx, "EVT SERVER msg=welcome\n");
+}
+
+/**
+ * @brief Accepts pending connections on the listener of this shard
+ *
+ * At most ACCEPT_BATCH connections are taken per wakeup. The listener is level-triggered, so whatever is left wakes this shard again (or, for a shared listener, another shard), which keeps one shard from taking a whole reconnect storm at once
+ */
+static void on_accept(void) {
+    for (int k = 0; k < ACCEPT_BATCH; k++) {
+        int cfd = net_accept(g_lfd);
+        if (cfd < 0) {
+            break;
+        }
+        add_client(cfd);
+    }
+}
+
+/**
+ * @brief Allocates the client table, timers, lobby and event loop of the calling shard
+ *
+ * Every shard gets g_limit_clients slots, twice its share of max_clients, as handovers may gather more clients on one shard than accepts bring in. The global client limit and the slots of every shard are accounted by shard_client_reserve()
+ *
+ * @return 0 on success, -1 on error (reported on stderr)
+ */
+static int shard_open(void) {
+    g_stats = stats_shard(shard_self());
+    arena_init(&g_arena, 1 << 20);
+    g_clients = arena_alloc(&g_arena, (size_t)g_limit_clients * sizeof(Client));
+    g_drop_list = arena_alloc(&g_arena, (size_t)g_limit_clients * sizeof(int));
+    g_dirty_list = arena_alloc(&g_arena, (size_t)g_limit_clients * sizeof(int));
+    g_client_gen = arena_alloc(&g_arena, (size_t)g_limit_clients * sizeof(unsigned));
+    g_io_busy = arena_alloc(&g_arena, (size_t)g_limit_clients);
+    g_moving = arena_alloc(&g_arena, (size_t)g_limit_clients * sizeof(ShardMsg*));
+    if (!g_clients || !g_drop_list || !g_dirty_list || !g_client_gen || !g_io_busy || !g_moving) {
+        fprintf(stderr, "Cannot allocate storage for %d clients\n", g_limit_clients);
+        return -1;
+    }
+
+    if (g_io_uring) {
+        g_send_stage = arena_alloc(&g_arena, (size_t)g_limit_clients * URING_SEND_CHUNK);
+        if (g_send_stage && uring_init(&g_ring, URING_ENTRIES, URING_BUFS, URING_BUF_SIZE) == 0) {
+            g_use_ring = 1;
+        }
+        else {
+            fprintf(stderr, "Warning: io_uring is not available on worker %d, using epoll\n", shard_self());
+        }
+    }
+
+    // One keepalive deadline per client slot plus the gauge sampler
+    if (timers_init(&g_timers, g_limit_clients + 1) < 0) {
+        fprintf(stderr, "Timer init failed\n");
+        return -1;
+    }
+
+    if (slots_init(&g_client_slots, g_limit_clients) < 0) {
+        fprintf(stderr, "Client pool init failed\n");
+        return -1;
+    }
+
+    if (lobby_init(send_line, send_err, close_client, release_client, g_clients, g_limit_clients, g_limit_rooms, &g_arena) < 0) {
+        fprintf(stderr, "Lobby init failed\n");
+        return -1;
+    }
+
+    if (loop_init(&g_loop, LOOP_BATCH) < 0) {
+        fprintf(stderr, "Event loop init failed\n");
+        return -1;
+    }
+    g_lfd = g_lfds[(g_listeners > 1) ? shard_self() : 0];
+    int console = 0;    // Non-zero if the epoll instance watches the console or the metrics endpoint
+    if (shard_self() == 0) {
+        // stdin stays level-triggered: fgets() consumes one line per wakeup.
+        // Regular files (e.g. </dev/null) cannot be watched, the console is then simply unavailable
+        console = loop_add(&g_loop, 0, TAG_STDIN, LOOP_IN) == 0;
+        if (g_admin_lfd >= 0) {
+            if (admin_attach(&g_loop, g_admin_lfd, TAG_ADMIN) < 0) {
+                fprintf(stderr, "Metrics endpoint registration failed\n");
+                return -1;
+            }
+            console = 1;
+        }
+    }
+    on_gauge_timer(0);
+
+    if (g_use_ring) {
+        // The epoll instance only carries the console and the metrics endpoint here, io_uring polls the epoll descriptor itself
+        if (uring_accept(&g_ring, g_lfd, (uint64_t)OP_ACCEPT << 56) < 0 || uring_poll(&g_ring, shard_inbox_fd(shard_self()), (uint64_t)OP_INBOX << 56) < 0) {
+            fprintf(stderr, "io_uring registration failed\n");
+            return -1;
+        }
+        if (console) {
+            uring_poll(&g_ring, g_loop.fd, (uint64_t)OP_CONSOLE << 56);
+        }
+        return 0;
+    }
+
+    if (loop_add(&g_loop, g_lfd, TAG_LISTEN, LOOP_IN) < 0 || loop_add(&g_loop, shard_inbox_fd(shard_self()), TAG_INBOX, LOOP_IN) < 0) {
+        fprintf(stderr, "Event loop registration failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Closes all connections of the calling shard and releases its storage
+ */
+static void shard_close(void) {
+    admin_detach();
+    if (g_clients) {
+        for (int i = 0; i < g_limit_clients; i++) {
+            if (g_clients[i].slot != C_EMPTY) {
+                close_client(i);
+            }
+            if (g_moving[i]) {
+                free(g_moving[i]);
+                g_moving[i] = NULL;
+            }
+        }
+    }
+
+    if (g_use_ring) {
+        uring_free(&g_ring);
+        g_use_ring = 0;
+    }
+    loop_free(&g_loop);
+    slots_destroy(&g_client_slots);
+    timers_destroy(&g_timers);
+    arena_destroy(&g_arena);
+    g_clients = NULL;
+}
+
+/**
+ * @brief Handles an event of a descriptor that only shard 0 watches (console, metrics endpoint)
+ *
+ * @param ev    Readiness event
+ *
+ * @return 1 if the event was handled, 0 if it belongs to something else
+ */
+static int on_console_event(const LoopEvent* ev) {
+    if (ev->tag == TAG_STDIN) {
+        handle_stdin();
+        return 1;
+    }
+    if (admin_owns(ev->tag)) {
+        admin_event(ev->tag, ev->events);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs the event loop of the calling shard until the server stops
+ */
+static void shard_run(void) {
+    LoopEvent evs[LOOP_BATCH];
+
+    while (g_running) {
+        int n = loop_wait(&g_loop, evs, next_timeout());
+        if (n < 0) {
+            continue;
+        }
+        uint64_t t0 = stats_now_ns();
+
+        for (int e = 0; e < n; e++) {
+            uint32_t tag = evs[e].tag;
+
+            if (on_console_event(&evs[e])) {
+                continue;
+            }
+            if (tag == TAG_LISTEN) {
+                on_accept();
+                continue;
+            }
+            if (tag == TAG_INBOX) {
+                on_inbox();
+                drop_pending();
+                continue;
+            }
+
+            int idx = (int)tag;
+            if (idx >= g_limit_clients) {
+                continue;
+            }
+            // A slot dropped or handed over earlier in this batch may already be offline or reused.
+            // Errors are detected by recv() itself, so a stale event can never drop a fresh client
+            if (g_clients[idx].slot == C_EMPTY || g_clients[idx].fd < 0) {
+                continue;
+            }
+            if (evs[e].events & LOOP_OUT) {
+                on_writable(idx);
+            }
+            if (evs[e].events & (LOOP_IN | LOOP_ERR)) {
+                on_readable(idx);
+            }
+            drop_pending();
+        }
+
+        timers_run(&g_timers, timer_now_ms());
+        lobby_tick();
+        drop_pending();
+        flush_dirty();
+        hist_record(&g_stats->loop, stats_now_ns() - t0);
+    }
+}
+
+/**
+ * @brief Handles a completion of a client's multishot receive (io_uring backend)
+ *
+ * A receive that ended without error is re-armed, end of stream or an error drops the client. Completions of an earlier connection in the same slot only return their buffer
+ *
+ * @param ev    Completion
+ */
+static void on_recv_done(const UringEvent* ev) {
+    int idx = (int)(uint32_t)ev->tag;
+    unsigned gen = (unsigned)(ev->tag >> 32) & 0xFFFFFFu;
+
+    if (idx < g_limit_clients && gen == (g_client_gen[idx] & 0xFFFFFFu)) {
+        Client* c = &g_clients[idx];
+        if (!(ev->flags & URING_MORE)) {
+            g_io_busy[idx] &= (unsigned char)~IO_RECV;
+        }
+        if (c->slot != C_EMPTY && c->fd >= 0) {
+            if (ev->res > 0 && (ev->flags & URING_BUFFER)) {
+                on_received(idx, uring_buf(&g_ring, ev->buf), (size_t)ev->res);
+            }
+            if (!(ev->flags & URING_MORE) && c->fd >= 0 && !g_moving[idx]) {
+                // Running out of provided buffers ends a multishot receive as well
+                if (ev->res > 0 || ev->res == -ENOBUFS) {
+                    uint64_t tag = ((uint64_t)OP_RECV << 56) | ((uint64_t)(g_client_gen[idx] & 0xFFFFFFu) << 32) | (uint32_t)idx;
+                    if (uring_recv(&g_ring, c->fd, tag) == 0) {
+                        g_io_busy[idx] |= IO_RECV;
+                    }
+                    else {
+                        drop_client(idx);
+                    }
+                }
+                else {
+                    drop_client(idx);
+                }
+            }
+            if (g_moving[idx] && !(g_io_busy[idx] & (IO_RECV | IO_SEND))) {
+                finish_migration(idx);
+            }
+        }
+    }
+
+    if (ev->flags & URING_BUFFER) {
+        uring_buf_return(&g_ring, ev->buf);
+    }
+}
+
+/**
+ * @brief Handles the completion of a send from a client's staging buffer (io_uring backend)
+ *
+ * Sent bytes leave the outbound queue and the next part of the queue goes out. The staging buffer is free again even if the completion belongs to an earlier connection in the same slot
+ *
+ * @param ev    Completion
+ */
+static void on_send_done(const UringEvent* ev) {
+    int idx = (int)(uint32_t)ev->tag;
+    unsigned gen = (unsigned)(ev->tag >> 32) & 0xFFFFFFu;
+    if (idx >= g_limit_clients) {
+        return;
+    }
+    g_io_busy[idx] &= (unsigned char)~IO_SEND;
+
+    Client* c = &g_clients[idx];
+    if (c->slot == C_EMPTY || c->fd < 0) {
+        return;
+    }
+    if (gen == (g_client_gen[idx] & 0xFFFFFFu)) {
+        if (ev->res < 0 && !g_moving[idx]) {
+            schedule_drop(idx);
+            return;
+        }
+        if (ev->res > 0) {
+            net_outbuf_consume(&c->out, (size_t)ev->res);
+        }
+    }
+
+    if (g_moving[idx]) {
+        if (!(g_io_busy[idx] & (IO_RECV | IO_SEND))) {
+            finish_migration(idx);
+        }
+        return;
+    }
+    if (!c->closing && c->out.len > 0 && flush_client(idx) < 0) {
+        schedule_drop(idx);
+    }
+}
+
+/**
+ * @brief Runs the calling shard on io_uring until the server stops
+ *
+ * Submissions queued while handling completions (receives, sends, re-armed operations) go to the kernel with the next wait
+ */
+static void shard_run_ring(void) {
+    UringEvent evs[LOOP_BATCH];
+    LoopEvent console[LOOP_BATCH];  // loop_wait() may fill the loop's whole batch size
+
+    while (g_running) {
+        if (uring_wait(&g_ring, next_timeout()) < 0) {
+            continue;
+        }
+        uint64_t t0 = stats_now_ns();
+
+        int n;
+        while ((n = uring_reap(&g_ring, evs, LOOP_BATCH)) > 0) {
+            for (int e = 0; e < n; e++) {
+                unsigned op = (unsigned)(evs[e].tag >> 56);
+                int more = (evs[e].flags & URING_MORE) != 0;
+
+                switch (op) {
+                    case OP_RECV:
+                        on_recv_done(&evs[e]);
+                        break;
+                    case OP_SEND:
+                        on_send_done(&evs[e]);
+                        break;
+                    case OP_ACCEPT:
+                        if (evs[e].res >= 0) {
+                            add_client(evs[e].res);
+                        }
+                        if (!more) {
+                            uring_accept(&g_ring, g_lfd, (uint64_t)OP_ACCEPT << 56);
+                        }
+                        break;
+                    case OP_INBOX:
+                        on_inbox();
+                        if (!more) {
+                            uring_poll(&g_ring, shard_inbox_fd(shard_self()), (uint64_t)OP_INBOX << 56);
+                        }
+                        break;
+                    case OP_CONSOLE:
+                        for (int c = 0, k = loop_wait(&g_loop, console, 0); c < k; c++) {
+                            on_console_event(&console[c]);
+                        }
+                        if (!more) {
+                            uring_poll(&g_ring, g_loop.fd, (uint64_t)OP_CONSOLE << 56);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                drop_pending();
+            }
+        }
+
+        timers_run(&g_timers, timer_now_ms());
+        lobby_tick();
+        drop_pending();
+        flush_dirty();
+        hist_record(&g_stats->loop, stats_now_ns() - t0);
+    }
+}
+
+/**
+ * @brief Stops every shard
+ */
+static void stop_all(void) {
+    g_running = 0;
+    shard_wake_all();
+}
+
+/**
+ * @brief Worker thread entry point: serves one shard
+ *
+ * @param arg   Shard index
+ *
+ * @return NULL
+ */
+static void* worker_main(void* arg) {
+    shard_bind((int)(intptr_t)arg);
+    if (shard_open() == 0) {
+        if (g_use_ring) {
+            shard_run_ring();
+        }
+        else {
+            shard_run();
+        }
+    }
+    else {
+        stop_all();
+    }
+    shard_close();
+    return NULL;
+}
+
+/**
+ * @brief Resolves the configured worker count
+ *
+ * @param workers   Configured value, 0 selects one worker per online CPU
+ *
+ * @return Number of shards (1 to SHARD_MAX)
+ */
+static int resolve_workers(int workers) {
+    if (workers > 0) {
+        return workers;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        return 1;
+    }
+    return (cpus > SHARD_MAX) ? SHARD_MAX : (int)cpus;
+}
+
+/**
+ * @brief Server entry point
+ *
+ * @param argc  Argument count
+ * @param argv  Argument vector
+ *
+ * @return 0 on clean exit, non-zero on startup/validation failure
+ */
+int main(int argc, char** argv) {
+    signal(SIGPIPE, SIG_IGN);
+
+    signal(SIGINT, on_signal_stop);
+    signal(SIGTERM, on_signal_stop);
+
+    ServerConfig cfg;
+    config_defaults(&cfg);
+
+    const char* config_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        }
+        if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) {
+            if (i + 1 >= argc) { 
+                usage(argv[0]);
+                return 2;
+            }
+            config_path = argv[i + 1];
+            i++;
+        }
+    }
+
+    if (config_path) {
+        if (!config_load_file(&cfg, config_path)) {
+            fprintf(stderr, "Warning: cannot load config file '%s', using defaults\n", config_path);
+        }
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) {
+            i++;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--ip") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            snprintf(cfg.ip, sizeof(cfg.ip), "%s", argv[++i]);
+
+            continue;
+        }
+        if (strcmp(argv[i], "--port") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            cfg.port = atoi(argv[++i]);
+
+            continue;
+        }
+        if (strcmp(argv[i], "--max-clients") == 0 || strcmp(argv[i], "--max_clients") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            cfg.max_clients = atoi(argv[++i]);
+
+            continue;
+        }
+        if (strcmp(argv[i], "--max-rooms") == 0 || strcmp(argv[i], "--max_rooms") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            cfg.max_rooms = atoi(argv[++i]);
+
+            continue;
+        }
+        if (strcmp(argv[i], "--max-outbuf") == 0 || strcmp(argv[i], "--max_outbuf") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            cfg.max_outbuf = atoi(argv[++i]);
+
+            continue;
+        }
+        if (strcmp(argv[i], "--workers") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            cfg.workers = atoi(argv[++i]);
+
+            continue;
+        }
+        if (strcmp(argv[i], "--backlog") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            cfg.backlog = atoi(argv[++i]);
+
+            continue;
+        }
+        if (strcmp(argv[i], "--reuseport") == 0) {
+            cfg.reuseport = 1;
+
+            continue;
+        }
+        if (strcmp(argv[i], "--io-uring") == 0) {
+            cfg.io_uring = 1;
+
+            continue;
+        }
+        if (strcmp(argv[i], "--admin-ip") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            snprintf(cfg.admin_ip, sizeof(cfg.admin_ip), "%s", argv[++i]);
+
+            continue;
+        }
+        if (strcmp(argv[i], "--admin-port") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 2;
+            }
+            cfg.admin_port = atoi(argv[++i]);
+
+            continue;
+        }
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        }
+    }
+
+    if (cfg.port < 1 || cfg.port > 65535) {
+        fprintf(stderr, "Error: invalid port (%d)\n", cfg.port);
+        return 2;
+    }
+    if (cfg.admin_port < 0 || cfg.admin_port > 65535) {
+        fprintf(stderr, "Error: invalid admin_port (%d)\n", cfg.admin_port);
+        return 2;
+    }
+    if (cfg.max_clients < 1 || cfg.max_clients > MAX_CLIENTS_LIMIT) {
+        fprintf(stderr, "Error: invalid max_clients %d\n", cfg.max_clients);
+        return 2;
+    }
+    if (cfg.max_rooms < 1 || cfg.max_rooms > LOBBY_MAX_ROOMS) {
+        fprintf(stderr, "Error: invalid max_rooms %d\n", cfg.max_rooms);
+        return 2;
+    }
+    if (cfg.max_outbuf < LINE_MAX) {
+        fprintf(stderr, "Error: invalid max_outbuf %d (minimum %d)\n", cfg.max_outbuf, LINE_MAX);
+        return 2;
+    }
+
+    if (cfg.backlog < 1) {
+        fprintf(stderr, "Error: invalid backlog %d\n", cfg.backlog);
+        return 2;
+    }
+    if (cfg.workers < 0 || cfg.workers > SHARD_MAX) {
+        fprintf(stderr, "Error: invalid workers %d (0 to %d)\n", cfg.workers, SHARD_MAX);
+        return 2;
+    }
+
+    cfg.workers = resolve_workers(cfg.workers);
+    // Room members gather on the shard of their room, so a shard may hold more than its share of the clients
+    int client_share = (cfg.max_clients + cfg.workers - 1) / cfg.workers;
+    g_limit_clients = (client_share < cfg.max_clients / 2) ? 2 * client_share : cfg.max_clients;
+    g_max_outbuf = (size_t)cfg.max_outbuf;
+    g_limit_rooms = (cfg.max_rooms + cfg.workers - 1) / cfg.workers;
+    g_io_uring = cfg.io_uring;
+
+    raise_fd_limit(cfg.max_clients + 16 + cfg.workers * 3 + ADMIN_CONNS + 1);
+
+    config_print(&cfg);
+
+    if (shard_setup(cfg.workers, g_limit_rooms, cfg.max_rooms, g_limit_clients, cfg.max_clients) < 0) {
+        fprintf(stderr, "Shard setup failed\n");
+        return 1;
+    }
+    if (stats_init(cfg.workers) < 0) {
+        fprintf(stderr, "Statistics setup failed\n");
+        shard_teardown();
+        return 1;
+    }
+
+    // With reuseport every worker gets its own accept queue, so a reconnect storm is spread over all of them
+    // A shared listener only spreads connections through level-triggered epoll wakeups. The multishot accepts of io_uring all sit on
+    // the same socket and one ring ends up taking every connection, so io_uring with several workers always uses per-worker listeners
+    int reuseport = cfg.reuseport || (cfg.io_uring && cfg.workers > 1);
+    g_listeners = reuseport ? cfg.workers : 1;
+    for (int i = 0; i < g_listeners; i++) {
+        g_lfds[i] = net_listen(cfg.ip, cfg.port, cfg.backlog, reuseport);
+        if (g_lfds[i] < 0) {
+            fprintf(stderr, "Listen failed\n");
+            while (i > 0) {
+                close(g_lfds[--i]);
+            }
+            shard_teardown();
+            stats_free();
+            return 1;
+        }
+    }
+    if (cfg.admin_port > 0) {
+        g_admin_lfd = net_listen(cfg.admin_ip, cfg.admin_port, ADMIN_CONNS, 0);
+        if (g_admin_lfd < 0) {
+            fprintf(stderr, "Metrics endpoint listen failed\n");
+            for (int i = 0; i < g_listeners; i++) {
+                close(g_lfds[i]);
+            }
+            shard_teardown();
+            stats_free();
+            return 1;
+        }
+    }
+    printf("Listening on %s:%d with %d worker(s), %d listener(s)\n", cfg.ip, cfg.port, cfg.workers, g_listeners);
+    if (g_admin_lfd >= 0) {
+        printf("Metrics at http://%s:%d/metrics\n", cfg.admin_ip, cfg.admin_port);
+    }
+    printf("Type 'stats' for statistics, 'quit' or 'exit' to stop\n");
+
+    // Workers never see SIGINT/SIGTERM: the main thread gets interrupted and stops everyone else
+    sigset_t block;
+    sigset_t prev;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &prev);
+
+    pthread_t threads[SHARD_MAX];
+    int started = 1;
+    for (; started < cfg.workers; started++) {
+        if (pthread_create(&threads[started], NULL, worker_main, (void*)(intptr_t)started) != 0) {
+            fprintf(stderr, "Cannot start worker %d\n", started);
+            g_running = 0;
+            break;
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &prev, NULL);
+
+    shard_bind(0);
+    if (g_running && shard_open() == 0) {
+        if (g_use_ring) {
+            shard_run_ring();
+        }
+        else {
+            shard_run();
+        }
+    }
+
+    printf("Shutting down...\n");
+
+    stop_all();
+    for (int i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    shard_close();
+
+    for (int i = 0; i < g_listeners; i++) {
+        close(g_lfds[i]);
+    }
+    if (g_admin_lfd >= 0) {
+        close(g_admin_lfd);
+    }
+    shard_teardown();
+    stats_free();
+
+    return 0;
+}
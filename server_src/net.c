@@ -1,56 +1,170 @@
-#include "net.h"
-#include <string.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <errno.h>
-#include <arpa/inet.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-
-int net_set_nonblock(int fd) {
-    int flags = fcntl(fd, F_GETFL, 0);
-    if (flags < 0) return -1;
-    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
-}
-
-int net_listen(const char* ip, int port) {
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (fd < 0) return -1;
-
-    int yes = 1;
-    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
-
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons((uint16_t)port);
-    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
-        close(fd);
-        return -1;
-    }
-
-    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        close(fd);
-        return -1;
-    }
-    if (listen(fd, 64) < 0) {
-        close(fd);
-        return -1;
-    }
-    if (net_set_nonblock(fd) < 0) {
-        close(fd);
-        return -1;
-    }
-    return fd;
-}
-
-int net_send_all(int fd, const char* data, size_t len) {
-    size_t off = 0;
-    while (off < len) {
-        ssize_t n = send(fd, data + off, len - off, 0);
-        if (n > 0) { off += (size_t)n; continue; }
-        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
-        return -1;
-    }
-    return 0;
-}
+#define _GNU_SOURCE
+#include "net.h"
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+#define NET_OUTBUF_MIN 1024     // Initial outbound ring size in bytes
+
+int net_listen(const char* ip, int port, int backlog, int reuseport) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
+        close(fd);
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, backlog) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int net_accept(int lfd) {
+    return accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
+
+/**
+ * @brief Makes sure an outbound queue can hold a number of bytes
+ *
+ * Grows the ring to the next power of two and linearizes the queued bytes at index 0
+ *
+ * @param b     Outbound queue
+ * @param need  Required capacity in bytes
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+static int outbuf_reserve(NetOutBuf* b, size_t need) {
+    if (need <= b->cap) {
+        return 0;
+    }
+    size_t cap = b->cap ? b->cap : NET_OUTBUF_MIN;
+    while (cap < need) {
+        cap *= 2;
+    }
+
+    char* d = malloc(cap);
+    if (!d) {
+        return -1;
+    }
+    if (b->len > 0) {
+        size_t first = b->cap - b->head;
+        if (first > b->len) {
+            first = b->len;
+        }
+        memcpy(d, b->data + b->head, first);
+        memcpy(d + first, b->data, b->len - first);
+    }
+    free(b->data);
+    b->data = d;
+    b->cap = cap;
+    b->head = 0;
+
+    return 0;
+}
+
+int net_outbuf_append(NetOutBuf* b, const char* data, size_t len) {
+    if (outbuf_reserve(b, b->len + len) < 0) {
+        return -1;
+    }
+
+    size_t tail = (b->head + b->len) & (b->cap - 1);
+    size_t first = b->cap - tail;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(b->data + tail, data, first);
+    memcpy(b->data, data + first, len - first);
+    b->len += len;
+
+    return 0;
+}
+
+int net_outbuf_flush(int fd, NetOutBuf* b) {
+    while (b->len > 0) {
+        size_t first = b->cap - b->head;
+        if (first > b->len) {
+            first = b->len;
+        }
+
+        struct iovec iov[2];
+        iov[0].iov_base = b->data + b->head;
+        iov[0].iov_len = first;
+        iov[1].iov_base = b->data;
+        iov[1].iov_len = b->len - first;
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = (iov[1].iov_len > 0) ? 2 : 1;
+
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n > 0) {
+            b->head = (b->head + (size_t)n) & (b->cap - 1);
+            b->len -= (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
+        return -1;
+    }
+
+    b->head = 0;
+    return 1;
+}
+
+size_t net_outbuf_peek(const NetOutBuf* b, char* dst, size_t max) {
+    size_t n = (b->len < max) ? b->len : max;
+    if (n == 0) {
+        return 0;
+    }
+    size_t first = b->cap - b->head;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(dst, b->data + b->head, first);
+    memcpy(dst + first, b->data, n - first);
+    return n;
+}
+
+void net_outbuf_consume(NetOutBuf* b, size_t n) {
+    if (n > b->len) {
+        n = b->len;
+    }
+    b->len -= n;
+    b->head = (b->len > 0) ? ((b->head + n) & (b->cap - 1)) : 0;
+}
+
+void net_outbuf_free(NetOutBuf* b) {
+    free(b->data);
+    b->data = NULL;
+    b->cap = 0;
+    b->head = 0;
+    b->len = 0;
+}
@@ -1,44 +1,102 @@
-/**
- * @file net.h
- * @brief Low-level networking helpers
- * 
- * Seminar work of "Fundamentals of Computer Networks"
- */
-
-#ifndef NET_H
-#define NET_H
-
-#pragma once
-#include <stddef.h>
-
-/**
- * @brief Creates and binds a listening TCP socket
- *
- * @param ip    IP address to bind
- * @param port  TCP port
- *
- * @return Listening socket fd, or -1 on error
- */
-int net_listen(const char* ip, int port);
-
-/**
- * @brief Sets a socket to non-blocking mode
- *
- * @param fd    Socket file descriptor
- *
- * @return 0 on success, -1 on error
- */
-int net_set_nonblock(int fd);
-
-/**
- * @brief Sends all data through a socket
- *
- * @param fd    Socket file descriptor
- * @param data  Buffer to send
- * @param len   Length of data
- *
- * @return 0 on success, -1 on error
- */
-int net_send_all(int fd, const char* data, size_t len);
-
-#endif
+/**
+ * @file net.h
+ * @brief Low-level networking helpers
+ * 
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef NET_H
+#define NET_H
+
+#pragma once
+#include <stddef.h>
+
+/**
+ * @brief Creates and binds a non-blocking listening TCP socket
+ *
+ * With reuseport several sockets can bind the same address, the kernel then spreads incoming connections over their accept queues
+ *
+ * @param ip        IP address to bind
+ * @param port      TCP port
+ * @param backlog   Accept queue length (capped by the kernel at net.core.somaxconn)
+ * @param reuseport Non-zero to set SO_REUSEPORT
+ *
+ * @return Listening socket fd, or -1 on error
+ */
+int net_listen(const char* ip, int port, int backlog, int reuseport);
+
+/**
+ * @brief Accepts one pending connection
+ *
+ * The accepted socket is already non-blocking and close-on-exec, no extra fcntl() calls are needed
+ *
+ * @param lfd   Listening socket
+ *
+ * @return Connected socket fd, or -1 if no connection is pending or on error
+ */
+int net_accept(int lfd);
+
+/**
+ * @brief Outbound byte queue of one connection
+ *
+ * Ring buffer that grows on demand. Lines are appended without blocking and written out whenever the socket accepts more data
+ */
+typedef struct {
+    char* data;     // Ring storage, NULL until the first append
+    size_t cap;     // Allocated size of data (power of two)
+    size_t head;    // Index of the first unsent byte
+    size_t len;     // Number of unsent bytes
+} NetOutBuf;
+
+/**
+ * @brief Appends data to an outbound queue
+ *
+ * @param b     Outbound queue
+ * @param data  Bytes to append
+ * @param len   Number of bytes
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int net_outbuf_append(NetOutBuf* b, const char* data, size_t len);
+
+/**
+ * @brief Writes as much queued data as the socket accepts without blocking
+ *
+ * Both halves of a wrapped ring go out in one sendmsg() call, so a batch of queued lines costs a single syscall
+ *
+ * @param fd    Non-blocking socket file descriptor
+ * @param b     Outbound queue
+ *
+ * @return 1 if the queue is empty, 0 if data remains queued, -1 on socket error
+ */
+int net_outbuf_flush(int fd, NetOutBuf* b);
+
+/**
+ * @brief Copies queued data from the front of an outbound queue without removing it
+ *
+ * Used by completion-based sends, which need the bytes in storage that does not move while the send is in flight
+ *
+ * @param b     Outbound queue
+ * @param dst   Destination buffer
+ * @param max   Capacity of dst
+ *
+ * @return Number of bytes copied
+ */
+size_t net_outbuf_peek(const NetOutBuf* b, char* dst, size_t max);
+
+/**
+ * @brief Removes sent bytes from the front of an outbound queue
+ *
+ * @param b     Outbound queue
+ * @param n     Number of bytes (at most the queued length)
+ */
+void net_outbuf_consume(NetOutBuf* b, size_t n);
+
+/**
+ * @brief Releases the storage of an outbound queue and empties it
+ *
+ * @param b     Outbound queue
+ */
+void net_outbuf_free(NetOutBuf* b);
+
+#endif
@@ -1,108 +1,205 @@
-#include "protocol.h"
-#include <string.h>
-#include <ctype.h>
-#include <stdio.h>
-
-/**
- * @brief Extracts the next whitespace-delimited token from a string
- *
- * @param s         Pointer to a string pointer
- * @param out       Output buffer
- * @param out_sz    Size of the output buffer in bytes
- *
- * @return 1 if a token was extracted, 0 if the end of the string was reached
- */
-static int split_token(const char** s, char* out, size_t out_sz) {
-    while (**s && isspace((unsigned char)**s)) {
-        (*s)++;
-    }
-    if (!**s) {
-        return 0;
-    }
-    size_t n = 0;
-    while (**s && !isspace((unsigned char)**s)) {
-        if (n + 1 < out_sz) {
-            out[n++] = **s;
-        }
-        (*s)++;
-    }
-    out[n] = '\0';
-
-    return 1;
-}
-
-/**
- * @brief Parses a token and appends it to a ProtoMsg
- *
- * @param m     Pointer to the message being populated
- * @param tok   Token
- */
-static void parse_kv(ProtoMsg* m, const char* tok) {
-    if (m->kv_count >= MAX_KV) {
-        return;
-    }
-    const char* eq = strchr(tok, '=');
-    if (!eq) {
-        return;
-    }
-    size_t klen = (size_t)(eq - tok);
-    size_t vlen = strlen(eq + 1);
-
-    if (klen == 0 || klen >= MAX_KEY) {
-        return;
-    }
-    if (vlen >= MAX_VAL) {
-        vlen = MAX_VAL - 1;
-    }
-
-    memcpy(m->kv[m->kv_count].key, tok, klen);
-    m->kv[m->kv_count].key[klen] = '\0';
-    memcpy(m->kv[m->kv_count].val, eq + 1, vlen);
-    m->kv[m->kv_count].val[vlen] = '\0';
-    m->kv_count++;
-}
-
-ProtoResult proto_parse(const char* line, ProtoMsg* out) {
-    memset(out, 0, sizeof(*out));
-    const char* s = line;
-    char t1[16], t2[MAX_CMD], tok[256];
-
-    if (!split_token(&s, t1, sizeof(t1))) {
-        return PROTO_BAD;
-    }
-    if (!split_token(&s, t2, sizeof(t2))) {
-        return PROTO_BAD;
-    }
-
-    if (strcmp(t1, "REQ") == 0) {
-        out->type = PT_REQ;
-    }
-    else if (strcmp(t1, "RESP") == 0) {
-        out->type = PT_RESP;
-    }
-    else if (strcmp(t1, "EVT") == 0) {
-        out->type = PT_EVT;
-    }
-    else if (strcmp(t1, "ERR") == 0) {
-        out->type = PT_ERR;
-    }
-    else {
-        return PROTO_BAD;
-    }
-
-    snprintf(out->cmd, sizeof(out->cmd), "%s", t2);
-
-    while (split_token(&s, tok, sizeof(tok))) {
-        parse_kv(out, tok);
-    }
-    return PROTO_OK;
-}
-
-const char* proto_get(const ProtoMsg* m, const char* key) {
-    for (int i = 0; i < m->kv_count; i++) {
-        if (strcmp(m->kv[i].key, key) == 0) {
-            return m->kv[i].val;
-        }
-    }
-    return NULL;
-}
+#include "protocol.h"
+#include <string.h>
+#include <ctype.h>
+
+/**
+ * @brief Extracts the next whitespace-delimited token and terminates it in place
+ *
+ * @param s     Pointer to the current position, advanced past the token
+ * @param end   End of the line
+ * @param out   Output slice
+ *
+ * @return 1 if a token was extracted, 0 if the end of the line was reached
+ */
+static int split_token(char** s, char* end, ProtoSlice* out) {
+    char* p = *s;
+    while (p < end && isspace((unsigned char)*p)) {
+        p++;
+    }
+    if (p >= end) {
+        *s = p;
+        return 0;
+    }
+    char* t = p;
+    while (p < end && !isspace((unsigned char)*p)) {
+        p++;
+    }
+    out->ptr = t;
+    out->len = (size_t)(p - t);
+    if (p < end) {
+        p++;
+    }
+    t[out->len] = '\0';
+    *s = p;
+
+    return 1;
+}
+
+/**
+ * @brief Parses a token and appends it to a ProtoMsg
+ *
+ * @param m     Pointer to the message being populated
+ * @param tok   Token, terminated in place
+ */
+static void parse_kv(ProtoMsg* m, ProtoSlice tok) {
+    if (m->kv_count >= MAX_KV) {
+        return;
+    }
+    char* t = (char*)tok.ptr;
+    char* eq = memchr(t, '=', tok.len);
+    if (!eq) {
+        return;
+    }
+    size_t klen = (size_t)(eq - t);
+    size_t vlen = tok.len - klen - 1;
+
+    if (klen == 0 || klen >= MAX_KEY) {
+        return;
+    }
+    if (vlen >= MAX_VAL) {
+        vlen = MAX_VAL - 1;
+    }
+
+    *eq = '\0';
+    eq[1 + vlen] = '\0';
+
+    KV* kv = &m->kv[m->kv_count++];
+    kv->key.ptr = t;
+    kv->key.len = klen;
+    kv->val.ptr = eq + 1;
+    kv->val.len = vlen;
+}
+
+/**
+ * @brief Splits the key-value section of a message
+ *
+ * @param m     Parsed message
+ */
+static void index_kv(ProtoMsg* m) {
+    ProtoSlice tok;
+    m->kv_count = 0;
+    while (split_token(&m->rest, m->end, &tok)) {
+        parse_kv(m, tok);
+    }
+}
+
+/**
+ * @brief Confirms a command candidate selected by proto_cmd_id()
+ *
+ * @param s     Command token
+ * @param name  Candidate name of the same length
+ * @param len   Token length
+ * @param id    Candidate command ID
+ *
+ * @return id if the token matches, CMD_UNKNOWN otherwise
+ */
+static ProtoCmd cmd_match(const char* s, const char* name, size_t len, ProtoCmd id) {
+    return (memcmp(s, name, len) == 0) ? id : CMD_UNKNOWN;
+}
+
+ProtoCmd proto_cmd_id(const char* s, size_t len) {
+    switch (len) {
+        case 4:
+            if (s[0] == 'D') return cmd_match(s, "DRAW", len, CMD_DRAW);
+            if (s[1] == 'I') return cmd_match(s, "PING", len, CMD_PING);
+            return cmd_match(s, "PLAY", len, CMD_PLAY);
+        case 5:
+            if (s[0] == 'P') return cmd_match(s, "PROTO", len, CMD_PROTO);
+            return cmd_match(s, "LOGIN", len, CMD_LOGIN);
+        case 6:
+            if (s[0] == 'R') return cmd_match(s, "RESUME", len, CMD_RESUME);
+            return cmd_match(s, "LOGOUT", len, CMD_LOGOUT);
+        case 9:
+            return cmd_match(s, "JOIN_ROOM", len, CMD_JOIN_ROOM);
+        case 10:
+            if (s[0] == 'S') return cmd_match(s, "START_GAME", len, CMD_START_GAME);
+            if (s[1] == 'I') return cmd_match(s, "LIST_ROOMS", len, CMD_LIST_ROOMS);
+            return cmd_match(s, "LEAVE_ROOM", len, CMD_LEAVE_ROOM);
+        case 11:
+            return cmd_match(s, "CREATE_ROOM", len, CMD_CREATE_ROOM);
+        default:
+            return CMD_UNKNOWN;
+    }
+}
+
+const char* proto_cmd_name(ProtoCmd id) {
+    static const char* const names[CMD_COUNT] = {
+        [CMD_UNKNOWN]     = "?",
+        [CMD_LOGIN]       = "LOGIN",
+        [CMD_RESUME]      = "RESUME",
+        [CMD_LOGOUT]      = "LOGOUT",
+        [CMD_PING]        = "PING",
+        [CMD_LIST_ROOMS]  = "LIST_ROOMS",
+        [CMD_CREATE_ROOM] = "CREATE_ROOM",
+        [CMD_JOIN_ROOM]   = "JOIN_ROOM",
+        [CMD_LEAVE_ROOM]  = "LEAVE_ROOM",
+        [CMD_START_GAME]  = "START_GAME",
+        [CMD_PLAY]        = "PLAY",
+        [CMD_DRAW]        = "DRAW",
+        [CMD_PROTO]       = "PROTO",
+    };
+    if ((unsigned)id >= CMD_COUNT) {
+        return "?";
+    }
+    return names[id];
+}
+
+ProtoResult proto_parse(char* line, size_t len, ProtoMsg* out) {
+    char* s = line;
+    char* end = line + len;
+    ProtoSlice t1, t2;
+
+    out->kv_count = 0;
+    line[len] = '\0';
+
+    if (!split_token(&s, end, &t1)) {
+        return PROTO_BAD;
+    }
+    if (!split_token(&s, end, &t2)) {
+        return PROTO_BAD;
+    }
+
+    if (t1.len == 3 && memcmp(t1.ptr, "REQ", 3) == 0) {
+        out->type = PT_REQ;
+    }
+    else if (t1.len == 4 && memcmp(t1.ptr, "RESP", 4) == 0) {
+        out->type = PT_RESP;
+    }
+    else if (t1.len == 3 && memcmp(t1.ptr, "EVT", 3) == 0) {
+        out->type = PT_EVT;
+    }
+    else if (t1.len == 3 && memcmp(t1.ptr, "ERR", 3) == 0) {
+        out->type = PT_ERR;
+    }
+    else {
+        return PROTO_BAD;
+    }
+
+    // Overlong command names are cut like the fixed-size buffer of the original parser did, they match no command and answer UNKNOWN_CMD
+    if (t2.len >= MAX_CMD) {
+        t2.len = MAX_CMD - 1;
+        ((char*)t2.ptr)[t2.len] = '\0';
+    }
+
+    out->cmd = t2.ptr;
+    out->cmd_len = t2.len;
+    out->cmd_id = proto_cmd_id(t2.ptr, t2.len);
+    out->rest = s;
+    out->end = end;
+    out->kv_count = -1;
+
+    return PROTO_OK;
+}
+
+const char* proto_get(ProtoMsg* m, const char* key) {
+    if (m->kv_count < 0) {
+        index_kv(m);
+    }
+    size_t klen = strlen(key);
+    for (int i = 0; i < m->kv_count; i++) {
+        if (m->kv[i].key.len == klen && memcmp(m->kv[i].key.ptr, key, klen) == 0) {
+            return m->kv[i].val.ptr;
+        }
+    }
+    return NULL;
+}
@@ -1,75 +1,138 @@
-/**
- * @file protocol.h
- * @brief Text-based protocol parser
- * 
- * Seminar work of "Fundamentals of Computer Networks"
- */
-
-#ifndef PROTOCOL_H
-#define PROTOCOL_H
-
-#pragma once
-#include <stddef.h>
-
-#define MAX_KV 32
-#define MAX_KEY 32
-#define MAX_VAL 128
-#define MAX_CMD 32
-
-/**
- * @brief Protocol message type.
- */
-typedef enum {
-    PT_REQ  = 1,    // Client request
-    PT_RESP = 2,    // Server response
-    PT_EVT  = 3,    // Server event
-    PT_ERR  = 4     // Error response
-} ProtoType;
-
-/**
- * @brief Protocol parse result.
- */
-typedef enum {
-    PROTO_OK  = 0,  // Parsing successful
-    PROTO_BAD = 1   // Parsing failed
-} ProtoResult;
-
-/**
- * @brief Key-value pair in protocol message
- */
-typedef struct {
-    char key[MAX_KEY];
-    char val[MAX_VAL];
-} KV;
-
-/**
- * @brief Parsed protocol message.
- */
-typedef struct {
-    ProtoType type;     // Message type
-    char cmd[MAX_CMD];  // Command name
-    KV kv[MAX_KV];      // Key-value pairs
-    int kv_count;       // Number of key-value pairs
-} ProtoMsg;
-
-/**
- * @brief Parses a protocol line into a ProtoMsg.
- *
- * @param line  Input line
- * @param out   Output structure
- *
- * @return PROTO_OK on success, PROTO_BAD on failure
- */
-ProtoResult proto_parse(const char* line, ProtoMsg* out);
-
-/**
- * @brief Retrieves value for a key from a parsed message
- *
- * @param m     Parsed message
- * @param key   Key name
- *
- * @return Pointer to value string, or NULL if not found
- */
-const char* proto_get(const ProtoMsg* m, const char* key);
-
-#endif
+/**
+ * @file protocol.h
+ * @brief Text-based protocol parser
+ * 
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#pragma once
+#include <stddef.h>
+
+#define MAX_KV 32
+#define MAX_CMD 32     // Command names are cut to MAX_CMD - 1 bytes
+#define MAX_KEY 32
+#define MAX_VAL 128
+
+/**
+ * @brief Protocol message type.
+ */
+typedef enum {
+    PT_REQ  = 1,    // Client request
+    PT_RESP = 2,    // Server response
+    PT_EVT  = 3,    // Server event
+    PT_ERR  = 4     // Error response
+} ProtoType;
+
+/**
+ * @brief Protocol parse result.
+ */
+typedef enum {
+    PROTO_OK  = 0,  // Parsing successful
+    PROTO_BAD = 1   // Parsing failed
+} ProtoResult;
+
+/**
+ * @brief Request command ID
+ */
+typedef enum {
+    CMD_UNKNOWN = 0,    // Command not known to the server
+    CMD_LOGIN,
+    CMD_RESUME,
+    CMD_LOGOUT,
+    CMD_PING,
+    CMD_LIST_ROOMS,
+    CMD_CREATE_ROOM,
+    CMD_JOIN_ROOM,
+    CMD_LEAVE_ROOM,
+    CMD_START_GAME,
+    CMD_PLAY,
+    CMD_DRAW,
+    CMD_PROTO,          // Switches the connection between the text and the binary protocol (wire.h)
+    CMD_COUNT           // Number of command IDs
+} ProtoCmd;
+
+/**
+ * @brief View of a token inside the parsed line
+ *
+ * The parser terminates tokens in place, so ptr is also a valid C string
+ */
+typedef struct {
+    const char* ptr;    // First byte of the token
+    size_t len;         // Token length in bytes
+} ProtoSlice;
+
+/**
+ * @brief Key-value pair in protocol message
+ */
+typedef struct {
+    ProtoSlice key;
+    ProtoSlice val;
+} KV;
+
+/**
+ * @brief Parsed protocol message.
+ *
+ * All strings point into the line passed to proto_parse(), which must outlive the message
+ * Key-value pairs are split lazily by the first proto_get() call
+ */
+typedef struct {
+    ProtoType type;     // Message type
+    const char* cmd;    // Command name
+    size_t cmd_len;     // Length of the command name
+    ProtoCmd cmd_id;    // Command ID resolved by the parser
+    char* rest;         // Unparsed key-value section
+    char* end;          // End of the line
+    KV kv[MAX_KV];      // Key-value pairs
+    int kv_count;       // Number of key-value pairs, -1 until indexed
+} ProtoMsg;
+
+/**
+ * @brief Parses a protocol line into a ProtoMsg.
+ *
+ * Tokenizes in place: separators inside the line are overwritten with '\0' and no bytes are copied
+ *
+ * @param line  Input line, modified in place (line[len] must be writable)
+ * @param len   Line length without line terminator
+ * @param out   Output structure
+ *
+ * @return PROTO_OK on success, PROTO_BAD on failure
+ */
+ProtoResult proto_parse(char* line, size_t len, ProtoMsg* out);
+
+/**
+ * @brief Maps a command token to its command ID
+ *
+ * Switches on the token length and its first distinguishing byte, then confirms with a single memcmp()
+ *
+ * @param s     Command token (not necessarily terminated)
+ * @param len   Token length
+ *
+ * @return Command ID, CMD_UNKNOWN if the token is not a known command
+ */
+ProtoCmd proto_cmd_id(const char* s, size_t len);
+
+/**
+ * @brief Returns the command token of a command ID
+ *
+ * @param id    Command ID
+ *
+ * @return Command name, "?" for CMD_UNKNOWN or an invalid ID
+ */
+const char* proto_cmd_name(ProtoCmd id);
+
+/**
+ * @brief Retrieves value for a key from a parsed message
+ *
+ * Builds the key-value index on first use
+ *
+ * @param m     Parsed message
+ * @param key   Key name
+ *
+ * @return Pointer to value string, or NULL if not found
+ */
+const char* proto_get(ProtoMsg* m, const char* key);
+
+#endif
@@ -0,0 +1,359 @@
+#include "shard.h"
+#include "strmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+/**
+ * @brief Inbox of one shard
+ */
+typedef struct {
+    pthread_mutex_t lock;   // Protects head/tail
+    ShardMsg* head;         // Oldest message
+    ShardMsg* tail;         // Newest message
+    int efd;                // eventfd signalled on every post
+} ShardInbox;
+
+static int g_count;                     // Number of shards
+static _Thread_local int g_self;        // Shard of the calling thread
+static ShardInbox g_inbox[SHARD_MAX];   // Inbox of every shard
+
+static pthread_mutex_t g_nick_lock = PTHREAD_MUTEX_INITIALIZER;     // Protects g_nicks
+static StrMap g_nicks;                  // Nickname -> owning shard * 2 + online flag
+
+static pthread_mutex_t g_room_lock = PTHREAD_MUTEX_INITIALIZER;     // Protects g_rooms, g_room_count and the room budget
+static ShardRoom* g_rooms;              // Room directory (rooms_per_shard entries per shard)
+static int g_rooms_per_shard;           // Room slots of every shard
+static int g_room_count;                // Number of listed rooms
+
+static int g_room_limit;                // Global room limit
+static int g_room_used;                 // Reserved rooms of all shards
+static int g_room_shard_used[SHARD_MAX];    // Reserved rooms per shard
+
+static int g_client_limit;              // Global client limit
+static int g_client_used;               // Reserved clients (protected by g_nick_lock)
+static int g_clients_per_shard;         // Client slots of every shard
+static int g_client_shard_used[SHARD_MAX];  // Reserved or claimed client slots per shard (protected by g_nick_lock)
+
+int shard_setup(int count, int rooms_per_shard, int max_rooms, int clients_per_shard, int max_clients) {
+    if (count < 1 || count > SHARD_MAX || rooms_per_shard < 1 || max_rooms < 1 || clients_per_shard < 1 || max_clients < 1) {
+        return -1;
+    }
+
+    g_rooms = calloc((size_t)count * (size_t)rooms_per_shard, sizeof(ShardRoom));
+    if (!g_rooms) {
+        return -1;
+    }
+    if (strmap_init(&g_nicks, (size_t)max_clients) < 0) {
+        free(g_rooms);
+        g_rooms = NULL;
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        pthread_mutex_init(&g_inbox[i].lock, NULL);
+        g_inbox[i].head = NULL;
+        g_inbox[i].tail = NULL;
+        g_inbox[i].efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (g_inbox[i].efd < 0) {
+            g_count = i;
+            shard_teardown();
+            return -1;
+        }
+    }
+
+    g_count = count;
+    g_rooms_per_shard = rooms_per_shard;
+    g_room_count = 0;
+    g_room_limit = max_rooms;
+    g_room_used = 0;
+    memset(g_room_shard_used, 0, sizeof(g_room_shard_used));
+    g_client_limit = max_clients;
+    g_client_used = 0;
+    g_clients_per_shard = clients_per_shard;
+    memset(g_client_shard_used, 0, sizeof(g_client_shard_used));
+    return 0;
+}
+
+void shard_teardown(void) {
+    for (int i = 0; i < g_count; i++) {
+        ShardMsg* m = g_inbox[i].head;
+        while (m) {
+            ShardMsg* next = m->next;
+            if (m->client.fd >= 0) {
+                close(m->client.fd);
+            }
+            net_outbuf_free(&m->client.out);
+            free(m->client.wire);
+            free(m);
+            m = next;
+        }
+        g_inbox[i].head = NULL;
+        g_inbox[i].tail = NULL;
+        if (g_inbox[i].efd >= 0) {
+            close(g_inbox[i].efd);
+        }
+        g_inbox[i].efd = -1;
+        pthread_mutex_destroy(&g_inbox[i].lock);
+    }
+    g_count = 0;
+
+    strmap_free(&g_nicks);
+    free(g_rooms);
+    g_rooms = NULL;
+}
+
+int shard_count(void) {
+    return g_count;
+}
+
+void shard_bind(int id) {
+    g_self = id;
+}
+
+int shard_self(void) {
+    return g_self;
+}
+
+int shard_inbox_fd(int id) {
+    return g_inbox[id].efd;
+}
+
+/**
+ * @brief Signals the eventfd of a shard
+ *
+ * @param id    Shard index
+ */
+static void wake(int id) {
+    uint64_t one = 1;
+    ssize_t w = write(g_inbox[id].efd, &one, sizeof(one));
+    (void)w;
+}
+
+void shard_post(int id, ShardMsg* m) {
+    ShardInbox* in = &g_inbox[id];
+    m->next = NULL;
+
+    pthread_mutex_lock(&in->lock);
+    if (in->tail) {
+        in->tail->next = m;
+    }
+    else {
+        in->head = m;
+    }
+    in->tail = m;
+    pthread_mutex_unlock(&in->lock);
+
+    wake(id);
+}
+
+ShardMsg* shard_take(void) {
+    ShardInbox* in = &g_inbox[g_self];
+
+    uint64_t v;
+    ssize_t r = read(in->efd, &v, sizeof(v));
+    (void)r;
+
+    pthread_mutex_lock(&in->lock);
+    ShardMsg* m = in->head;
+    in->head = NULL;
+    in->tail = NULL;
+    pthread_mutex_unlock(&in->lock);
+    return m;
+}
+
+void shard_wake_all(void) {
+    for (int i = 0; i < g_count; i++) {
+        wake(i);
+    }
+}
+
+int shard_nick_claim(const char* nick, int* owner_online) {
+    int claimed = 0;
+    pthread_mutex_lock(&g_nick_lock);
+    int v = strmap_get(&g_nicks, nick);
+    if (v < 0 && strmap_put(&g_nicks, nick, g_self * 2 + 1) == 0) {
+        claimed = 1;
+    }
+    pthread_mutex_unlock(&g_nick_lock);
+
+    if (!claimed && owner_online) {
+        *owner_online = (v < 0) ? 1 : (v & 1);
+    }
+    return claimed;
+}
+
+void shard_nick_move(const char* nick, int id, int online) {
+    pthread_mutex_lock(&g_nick_lock);
+    strmap_put(&g_nicks, nick, id * 2 + (online ? 1 : 0));
+    pthread_mutex_unlock(&g_nick_lock);
+}
+
+void shard_nick_online(const char* nick, int online) {
+    pthread_mutex_lock(&g_nick_lock);
+    int v = strmap_get(&g_nicks, nick);
+    if (v >= 0 && v / 2 == g_self) {
+        strmap_put(&g_nicks, nick, g_self * 2 + (online ? 1 : 0));
+    }
+    pthread_mutex_unlock(&g_nick_lock);
+}
+
+void shard_nick_release(const char* nick) {
+    pthread_mutex_lock(&g_nick_lock);
+    int v = strmap_get(&g_nicks, nick);
+    if (v >= 0 && v / 2 == g_self) {
+        strmap_del(&g_nicks, nick);
+    }
+    pthread_mutex_unlock(&g_nick_lock);
+}
+
+int shard_nick_owner(const char* nick) {
+    pthread_mutex_lock(&g_nick_lock);
+    int v = strmap_get(&g_nicks, nick);
+    pthread_mutex_unlock(&g_nick_lock);
+    return (v < 0) ? -1 : v / 2;
+}
+
+int shard_client_reserve(void) {
+    int id = -1;
+    pthread_mutex_lock(&g_nick_lock);
+    if (g_client_used < g_client_limit) {
+        if (g_client_shard_used[g_self] < g_clients_per_shard) {
+            id = g_self;
+        }
+        else {
+            int best = 0;
+            for (int i = 0; i < g_count; i++) {
+                int free_slots = g_clients_per_shard - g_client_shard_used[i];
+                if (free_slots > best) {
+                    best = free_slots;
+                    id = i;
+                }
+            }
+        }
+        if (id >= 0) {
+            g_client_used++;
+            g_client_shard_used[id]++;
+        }
+    }
+    pthread_mutex_unlock(&g_nick_lock);
+    return id;
+}
+
+void shard_client_unreserve(int id) {
+    pthread_mutex_lock(&g_nick_lock);
+    if (g_client_used > 0) {
+        g_client_used--;
+    }
+    if (g_client_shard_used[id] > 0) {
+        g_client_shard_used[id]--;
+    }
+    pthread_mutex_unlock(&g_nick_lock);
+}
+
+int shard_client_claim(int id) {
+    int ok = 0;
+    pthread_mutex_lock(&g_nick_lock);
+    if (g_client_shard_used[id] < g_clients_per_shard) {
+        g_client_shard_used[id]++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&g_nick_lock);
+    return ok;
+}
+
+void shard_client_unclaim(int id) {
+    pthread_mutex_lock(&g_nick_lock);
+    if (g_client_shard_used[id] > 0) {
+        g_client_shard_used[id]--;
+    }
+    pthread_mutex_unlock(&g_nick_lock);
+}
+
+int shard_room_reserve(void) {
+    int ok = 0;
+    pthread_mutex_lock(&g_room_lock);
+    if (g_room_used < g_room_limit && g_room_shard_used[g_self] < g_rooms_per_shard) {
+        g_room_used++;
+        g_room_shard_used[g_self]++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&g_room_lock);
+    return ok;
+}
+
+void shard_room_unreserve(int id) {
+    pthread_mutex_lock(&g_room_lock);
+    if (g_room_shard_used[id] > 0) {
+        g_room_shard_used[id]--;
+        g_room_used--;
+    }
+    pthread_mutex_unlock(&g_room_lock);
+}
+
+int shard_room_target(void) {
+    int id = -1;
+    pthread_mutex_lock(&g_room_lock);
+    if (g_room_used < g_room_limit) {
+        if (g_room_shard_used[g_self] < g_rooms_per_shard) {
+            id = g_self;
+        }
+        else {
+            int best = 0;
+            for (int i = 0; i < g_count; i++) {
+                int free_slots = g_rooms_per_shard - g_room_shard_used[i];
+                if (free_slots > best) {
+                    best = free_slots;
+                    id = i;
+                }
+            }
+            if (id >= 0) {
+                g_room_used++;
+                g_room_shard_used[id]++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_room_lock);
+    return id;
+}
+
+void shard_room_publish(int slot, const ShardRoom* info) {
+    if (slot < 0 || slot >= g_rooms_per_shard) {
+        return;
+    }
+    ShardRoom* e = &g_rooms[g_self * g_rooms_per_shard + slot];
+
+    pthread_mutex_lock(&g_room_lock);
+    if (info) {
+        if (!e->id) {
+            g_room_count++;
+        }
+        *e = *info;
+    }
+    else if (e->id) {
+        memset(e, 0, sizeof(*e));
+        g_room_count--;
+    }
+    pthread_mutex_unlock(&g_room_lock);
+}
+
+int shard_rooms_lock(void) {
+    pthread_mutex_lock(&g_room_lock);
+    return g_room_count;
+}
+
+void shard_rooms_unlock(void) {
+    pthread_mutex_unlock(&g_room_lock);
+}
+
+int shard_rooms_cap(void) {
+    return g_count * g_rooms_per_shard;
+}
+
+const ShardRoom* shard_room_at(int i) {
+    return &g_rooms[i];
+}
@@ -0,0 +1,262 @@
+/**
+ * @file shard.h
+ * @brief Worker shards and the state they share
+ *
+ * Every worker thread is a shard with its own event loop, client table, rooms and timers, so the lobby and game logic never take a lock
+ * The few things that span shards live here behind mutexes: the nickname registry (nick uniqueness, RESUME routing), the room directory (LIST_ROOMS), the global client and room budgets with the slot usage of every shard, and one inbox per shard through which connections are handed over to another shard
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#pragma once
+#include "client.h"
+
+#define SHARD_BITS 4                // Room ids carry the owning shard in this many bits
+#define SHARD_MAX (1 << SHARD_BITS) // Upper bound for the number of workers
+
+/**
+ * @brief Request a handed-over connection continues with on its new shard
+ */
+typedef enum {
+    HANDOFF_JOIN_ROOM = 0,  // Join room_id (the room lives on the target shard)
+    HANDOFF_RESUME,         // Resume nick/session (the session lives on the target shard)
+    HANDOFF_CREATE_ROOM,    // Create room name/size (the calling shard had no free room slot, one is reserved on the target)
+    HANDOFF_ACCEPT          // Greet a freshly accepted connection (the accepting shard had no free client slot)
+} HandoffCmd;
+
+/**
+ * @brief Connection handed over to another shard
+ *
+ * Carries the complete client slot: socket, identity, unprocessed input and queued output. The sender stops watching the socket before posting it
+ */
+typedef struct ShardMsg {
+    struct ShardMsg* next;  // Next message in the inbox
+    HandoffCmd cmd;         // Request to run on the target shard
+    int target;             // Target shard
+    int room_id;            // Room to join (HANDOFF_JOIN_ROOM)
+    char nick[32];          // Nickname to resume (HANDOFF_RESUME)
+    char session[64];       // Session token to resume (HANDOFF_RESUME)
+    char name[32];          // Room name (HANDOFF_CREATE_ROOM)
+    int size;               // Room capacity (HANDOFF_CREATE_ROOM)
+    Client client;          // Client slot contents (timers disarmed)
+} ShardMsg;
+
+/**
+ * @brief Room directory entry, published by the shard that owns the room
+ */
+typedef struct {
+    int id;                 // Room id, 0 if the entry is unused
+    char name[32];          // Room name
+    int pcount;             // Players in the room
+    int size;               // Room capacity
+    int in_game;            // Non-zero while a game is running
+} ShardRoom;
+
+/**
+ * @brief Creates the shared state for a number of shards
+ *
+ * @param count             Number of shards (1 to SHARD_MAX)
+ * @param rooms_per_shard   Room slots of every shard
+ * @param max_rooms         Global room limit
+ * @param clients_per_shard Client slots of every shard
+ * @param max_clients       Global client limit (also sizes the nickname registry)
+ *
+ * @return 0 on success, -1 on error
+ */
+int shard_setup(int count, int rooms_per_shard, int max_rooms, int clients_per_shard, int max_clients);
+
+/**
+ * @brief Releases the shared state, closing connections still waiting in an inbox
+ */
+void shard_teardown(void);
+
+/**
+ * @brief Returns the number of shards
+ *
+ * @return Shard count
+ */
+int shard_count(void);
+
+/**
+ * @brief Binds the calling thread to a shard
+ *
+ * @param id    Shard index
+ */
+void shard_bind(int id);
+
+/**
+ * @brief Returns the shard of the calling thread
+ *
+ * @return Shard index
+ */
+int shard_self(void);
+
+/**
+ * @brief Returns the descriptor that becomes readable when the inbox of a shard has messages
+ *
+ * @param id    Shard index
+ *
+ * @return eventfd descriptor
+ */
+int shard_inbox_fd(int id);
+
+/**
+ * @brief Appends a message to the inbox of a shard and wakes it up
+ *
+ * @param id    Target shard
+ * @param m     Heap-allocated message, owned by the target from now on
+ */
+void shard_post(int id, ShardMsg* m);
+
+/**
+ * @brief Takes all messages from the inbox of the calling shard
+ *
+ * @return Messages in posting order (linked by next), NULL if the inbox is empty
+ */
+ShardMsg* shard_take(void);
+
+/**
+ * @brief Wakes up every shard (used on shutdown)
+ */
+void shard_wake_all(void);
+
+/**
+ * @brief Registers a nickname for the calling shard unless another client already holds it
+ *
+ * @param nick          Nickname
+ * @param owner_online  Set to the online flag of the current holder when the claim fails
+ *
+ * @return 1 if the nickname was registered, 0 if it is taken
+ */
+int shard_nick_claim(const char* nick, int* owner_online);
+
+/**
+ * @brief Moves a registered nickname to a shard
+ *
+ * @param nick      Nickname
+ * @param id        New owning shard
+ * @param online    Online flag
+ */
+void shard_nick_move(const char* nick, int id, int online);
+
+/**
+ * @brief Updates the online flag of a nickname owned by the calling shard
+ *
+ * @param nick      Nickname
+ * @param online    Online flag
+ */
+void shard_nick_online(const char* nick, int online);
+
+/**
+ * @brief Unregisters a nickname owned by the calling shard
+ *
+ * @param nick  Nickname
+ */
+void shard_nick_release(const char* nick);
+
+/**
+ * @brief Returns the shard that owns a nickname
+ *
+ * @param nick  Nickname
+ *
+ * @return Shard index, -1 if the nickname is not registered
+ */
+int shard_nick_owner(const char* nick);
+
+/**
+ * @brief Reserves one client of the global client limit and a slot for it
+ *
+ * The slot is taken on the calling shard while it has a free one, otherwise on the shard with the most free slots
+ *
+ * @return Shard the slot was reserved on, -1 if the global limit is reached
+ */
+int shard_client_reserve(void);
+
+/**
+ * @brief Returns a client reserved by shard_client_reserve() (or claimed on its current shard) to the global limit
+ *
+ * @param id    Shard that holds the slot
+ */
+void shard_client_unreserve(int id);
+
+/**
+ * @brief Claims a slot on a shard for a client that is handed over to it
+ *
+ * The client keeps its share of the global limit, its old slot is given up with shard_client_unclaim() once it has left
+ *
+ * @param id    Target shard
+ *
+ * @return 1 if claimed, 0 if the shard has no free slot
+ */
+int shard_client_claim(int id);
+
+/**
+ * @brief Gives up a client slot without touching the global limit
+ *
+ * @param id    Shard that held the slot
+ */
+void shard_client_unclaim(int id);
+
+/**
+ * @brief Reserves one room of the global room limit in a slot of the calling shard
+ *
+ * @return 1 if reserved, 0 if the global limit is reached or the shard has no free slot
+ */
+int shard_room_reserve(void);
+
+/**
+ * @brief Returns a reserved room
+ *
+ * @param id    Shard the room was reserved on
+ */
+void shard_room_unreserve(int id);
+
+/**
+ * @brief Chooses the shard a new room is created on
+ *
+ * The calling shard while it has a free slot (nothing is reserved, the lobby reserves it when creating the room). Otherwise the shard with the most free slots, where one room is reserved right away so that concurrent handovers do not pick the same last slot
+ *
+ * @return Shard index, -1 if the global room limit is reached
+ */
+int shard_room_target(void);
+
+/**
+ * @brief Publishes the listing of a room owned by the calling shard
+ *
+ * @param slot  Room slot on the calling shard
+ * @param info  Listing, NULL removes the room
+ */
+void shard_room_publish(int slot, const ShardRoom* info);
+
+/**
+ * @brief Locks the room directory for reading
+ *
+ * @return Number of listed rooms
+ */
+int shard_rooms_lock(void);
+
+/**
+ * @brief Unlocks the room directory
+ */
+void shard_rooms_unlock(void);
+
+/**
+ * @brief Returns the number of entries in the room directory (listed or not)
+ *
+ * @return Directory size
+ */
+int shard_rooms_cap(void);
+
+/**
+ * @brief Returns one entry of the locked room directory
+ *
+ * @param i     Entry index (below shard_rooms_cap())
+ *
+ * @return Directory entry, id is 0 if unused
+ */
+const ShardRoom* shard_room_at(int i);
+
+#endif
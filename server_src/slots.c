@@ -0,0 +1,57 @@
+#include "slots.h"
+#include <stdlib.h>
+
+int slots_init(SlotPool* p, int size) {
+    if (size < 0) {
+        return -1;
+    }
+    p->next = malloc((size_t)(size > 0 ? size : 1) * sizeof(int));
+    p->used = calloc((size_t)(size > 0 ? size : 1), 1);
+    if (!p->next || !p->used) {
+        free(p->next);
+        free(p->used);
+        p->next = NULL;
+        p->used = NULL;
+        return -1;
+    }
+    for (int i = 0; i < size; i++) {
+        p->next[i] = (i + 1 < size) ? i + 1 : -1;
+    }
+    p->head = (size > 0) ? 0 : -1;
+    p->size = size;
+    p->in_use = 0;
+
+    return 0;
+}
+
+void slots_destroy(SlotPool* p) {
+    free(p->next);
+    free(p->used);
+    p->next = NULL;
+    p->used = NULL;
+    p->head = -1;
+    p->size = 0;
+    p->in_use = 0;
+}
+
+int slots_alloc(SlotPool* p) {
+    int idx = p->head;
+    if (idx < 0) {
+        return -1;
+    }
+    p->head = p->next[idx];
+    p->used[idx] = 1;
+    p->in_use++;
+
+    return idx;
+}
+
+void slots_release(SlotPool* p, int idx) {
+    if (idx < 0 || idx >= p->size || !p->used[idx]) {
+        return;
+    }
+    p->used[idx] = 0;
+    p->next[idx] = p->head;
+    p->head = idx;
+    p->in_use--;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file slots.h
+ * @brief O(1) slot allocator for fixed-size pools (clients, rooms)
+ *
+ * Free slots form a singly linked list threaded through a side array, so allocation and release never scan the pool
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef SLOTS_H
+#define SLOTS_H
+
+#pragma once
+
+/**
+ * @brief Free-list allocator over slot indices 0..size-1
+ */
+typedef struct {
+    int* next;              // Next free slot for every free slot, -1 terminates the list
+    unsigned char* used;    // Non-zero for allocated slots (guards against double release)
+    int head;               // First free slot, -1 if the pool is exhausted
+    int size;               // Number of slots
+    int in_use;             // Number of allocated slots
+} SlotPool;
+
+/**
+ * @brief Creates a pool with all slots free
+ *
+ * Slots are handed out in ascending order until the first release
+ *
+ * @param p     Pool to initialize
+ * @param size  Number of slots
+ *
+ * @return 0 on success, -1 on error
+ */
+int slots_init(SlotPool* p, int size);
+
+/**
+ * @brief Releases the memory of a pool
+ *
+ * @param p     Pool to destroy
+ */
+void slots_destroy(SlotPool* p);
+
+/**
+ * @brief Takes a free slot
+ *
+ * @param p     Pool
+ *
+ * @return Slot index, or -1 if no slot is free
+ */
+int slots_alloc(SlotPool* p);
+
+/**
+ * @brief Returns a slot to the pool
+ *
+ * Releasing a slot that is not allocated is ignored
+ *
+ * @param p     Pool
+ * @param idx   Slot index
+ */
+void slots_release(SlotPool* p, int idx);
+
+#endif
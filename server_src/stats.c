@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static ShardStats* g_shards;    // Statistics of every shard
+static int g_count;             // Number of shards
+static ShardStats* g_base;      // Totals at the last stats_reset()
+static ShardStats* g_view;      // Scratch buffer of stats_print()
+static uint64_t g_base_ns;      // Time of the last stats_reset() (or startup)
+
+int stats_init(int shards) {
+    g_shards = calloc((size_t)shards, sizeof(*g_shards));
+    g_base = calloc(1, sizeof(*g_base));
+    g_view = calloc(1, sizeof(*g_view));
+    if (!g_shards || !g_base || !g_view) {
+        stats_free();
+        return -1;
+    }
+    g_count = shards;
+    g_base_ns = stats_now_ns();
+    return 0;
+}
+
+void stats_free(void) {
+    free(g_shards);
+    free(g_base);
+    free(g_view);
+    g_shards = NULL;
+    g_base = NULL;
+    g_view = NULL;
+    g_count = 0;
+}
+
+ShardStats* stats_shard(int shard) {
+    return &g_shards[shard];
+}
+
+int stats_shards(void) {
+    return g_count;
+}
+
+uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void stats_collect(ShardStats* out) {
+    memset(out, 0, sizeof(*out));
+    for (int s = 0; s < g_count; s++) {
+        const ShardStats* src = &g_shards[s];
+        for (int c = 0; c < CMD_COUNT; c++) {
+            hist_merge(&out->req[c], &src->req[c]);
+        }
+        out->bytes_in += __atomic_load_n(&src->bytes_in, __ATOMIC_RELAXED);
+        out->bytes_out += __atomic_load_n(&src->bytes_out, __ATOMIC_RELAXED);
+        out->lines += __atomic_load_n(&src->lines, __ATOMIC_RELAXED);
+        out->strikes += __atomic_load_n(&src->strikes, __ATOMIC_RELAXED);
+        out->drops += __atomic_load_n(&src->drops, __ATOMIC_RELAXED);
+        hist_merge(&out->loop, &src->loop);
+        out->online += __atomic_load_n(&src->online, __ATOMIC_RELAXED);
+        out->offline += __atomic_load_n(&src->offline, __ATOMIC_RELAXED);
+        out->rooms_lobby += __atomic_load_n(&src->rooms_lobby, __ATOMIC_RELAXED);
+        out->rooms_game += __atomic_load_n(&src->rooms_game, __ATOMIC_RELAXED);
+        out->paused += __atomic_load_n(&src->paused, __ATOMIC_RELAXED);
+        out->outq += __atomic_load_n(&src->outq, __ATOMIC_RELAXED);
+    }
+}
+
+void stats_print(FILE* out) {
+    ShardStats* v = g_view;
+    stats_collect(v);
+    for (int c = 0; c < CMD_COUNT; c++) {
+        hist_sub(&v->req[c], &g_base->req[c]);
+    }
+    v->bytes_in -= g_base->bytes_in;
+    v->bytes_out -= g_base->bytes_out;
+    v->lines -= g_base->lines;
+    v->strikes -= g_base->strikes;
+    v->drops -= g_base->drops;
+    hist_sub(&v->loop, &g_base->loop);
+
+    double dt = (double)(stats_now_ns() - g_base_ns) / 1e9;
+    if (dt <= 0.0) {
+        dt = 1e-9;
+    }
+
+    fprintf(out, "stats over %.1f s (%d shard(s))\n", dt, g_count);
+    fprintf(out, "  bytes in:    %llu (%.0f/s)\n", (unsigned long long)v->bytes_in, (double)v->bytes_in / dt);
+    fprintf(out, "  bytes out:   %llu (%.0f/s)\n", (unsigned long long)v->bytes_out, (double)v->bytes_out / dt);
+    fprintf(out, "  lines:       %llu (%.0f/s)\n", (unsigned long long)v->lines, (double)v->lines / dt);
+    fprintf(out, "  strikes:     %llu\n", (unsigned long long)v->strikes);
+    fprintf(out, "  drops:       %llu\n", (unsigned long long)v->drops);
+    fprintf(out, "  clients:     %llu online, %llu offline, %llu bytes queued\n", (unsigned long long)v->online, (unsigned long long)v->offline, (unsigned long long)v->outq);
+    fprintf(out, "  rooms:       %llu in lobby, %llu in game (%llu paused)\n", (unsigned long long)v->rooms_lobby, (unsigned long long)v->rooms_game, (unsigned long long)v->paused);
+    fprintf(out, "  %-12s %10s %9s %9s %9s %9s %9s\n", "command (us)", "count", "rate/s", "p50", "p99", "p999", "max");
+    for (int c = 0; c < CMD_COUNT; c++) {
+        const Hist* h = &v->req[c];
+        if (h->total == 0) {
+            continue;
+        }
+        fprintf(out, "  %-12s %10llu %9.0f %9.1f %9.1f %9.1f %9.1f\n", proto_cmd_name((ProtoCmd)c), (unsigned long long)h->total, (double)h->total / dt,
+            (double)hist_quantile(h, 0.50) / 1e3, (double)hist_quantile(h, 0.99) / 1e3, (double)hist_quantile(h, 0.999) / 1e3, (double)h->max / 1e3
+        );
+    }
+    if (v->loop.total > 0) {
+        const Hist* h = &v->loop;
+        fprintf(out, "  %-12s %10llu %9.0f %9.1f %9.1f %9.1f %9.1f\n", "(loop)", (unsigned long long)h->total, (double)h->total / dt,
+            (double)hist_quantile(h, 0.50) / 1e3, (double)hist_quantile(h, 0.99) / 1e3, (double)hist_quantile(h, 0.999) / 1e3, (double)h->max / 1e3
+        );
+    }
+    fflush(out);
+}
+
+void stats_reset(void) {
+    stats_collect(g_base);
+    g_base_ns = stats_now_ns();
+}
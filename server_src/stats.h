@@ -0,0 +1,124 @@
+/**
+ * @file stats.h
+ * @brief Server statistics: request dispatch latency per command, traffic counters and load gauges
+ *
+ * Every shard records into its own ShardStats, which only the shard's thread writes. The console and the metrics endpoint read all shards at any time without a lock, and "stats reset" keeps the current totals as a baseline instead of clearing the shards' data
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include "hist.h"
+#include "protocol.h"
+
+/**
+ * @brief Statistics of one shard
+ */
+typedef struct {
+    Hist req[CMD_COUNT];    // handle_req() time per command in nanoseconds
+    uint64_t bytes_in;      // Bytes received from clients
+    uint64_t bytes_out;     // Bytes queued for clients
+    uint64_t lines;         // Request lines parsed
+    uint64_t strikes;       // Lines rejected by the parser
+    uint64_t drops;         // Connections closed (peer close, error, timeout or protocol violation)
+    Hist loop;              // Event loop iteration time (after the wait) in nanoseconds
+
+    // Gauges, sampled by the shard once per second
+    uint64_t online;        // Connected clients
+    uint64_t offline;       // Logged-in clients waiting for RESUME
+    uint64_t rooms_lobby;   // Rooms waiting for a game
+    uint64_t rooms_game;    // Rooms with a running game
+    uint64_t paused;        // Running games paused for an offline player
+    uint64_t outq;          // Bytes queued for clients and not yet sent
+} ShardStats;
+
+/**
+ * @brief Adds to a counter of the calling shard's statistics
+ *
+ * Only the owning shard writes its counters, so a relaxed load and store is enough and readers never see a torn value
+ *
+ * @param counter   Counter inside the shard's ShardStats
+ * @param n         Amount to add
+ */
+static inline void stats_add(uint64_t* counter, uint64_t n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Sets a gauge of the calling shard's statistics
+ *
+ * @param gauge     Gauge inside the shard's ShardStats
+ * @param v         New value
+ */
+static inline void stats_set(uint64_t* gauge, uint64_t v) {
+    __atomic_store_n(gauge, v, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Allocates the statistics of all shards
+ *
+ * @param shards    Number of shards
+ *
+ * @return 0 on success, -1 on error
+ */
+int stats_init(int shards);
+
+/**
+ * @brief Releases the statistics of all shards
+ */
+void stats_free(void);
+
+/**
+ * @brief Returns the statistics a shard records into
+ *
+ * @param shard     Shard number
+ *
+ * @return Statistics of the shard
+ */
+ShardStats* stats_shard(int shard);
+
+/**
+ * @brief Returns the number of shards
+ *
+ * @return Shard count given to stats_init()
+ */
+int stats_shards(void);
+
+/**
+ * @brief Returns the monotonic clock in nanoseconds
+ *
+ * @return Nanoseconds since an arbitrary fixed point
+ */
+uint64_t stats_now_ns(void);
+
+/**
+ * @brief Sums the statistics of all shards
+ *
+ * Totals since startup, "stats reset" does not affect them
+ *
+ * @param out   Output (overwritten)
+ */
+void stats_collect(ShardStats* out);
+
+/**
+ * @brief Prints everything recorded since startup or the last stats_reset()
+ *
+ * Called from the console only
+ *
+ * @param out   Output stream
+ */
+void stats_print(FILE* out);
+
+/**
+ * @brief Starts a new measurement interval for stats_print()
+ *
+ * Called from the console only
+ */
+void stats_reset(void);
+
+#endif
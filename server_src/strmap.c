@@ -0,0 +1,125 @@
+#include "strmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Computes the FNV-1a hash of a string
+ *
+ * @param s     String to hash
+ *
+ * @return 32-bit hash
+ */
+static uint32_t hash_str(const char* s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Finds the entry holding a key
+ *
+ * @param m     Map
+ * @param key   Key to search for
+ * @param h     Hash of key
+ *
+ * @return Entry index, or -1 if the key is not present
+ */
+static long find_slot(const StrMap* m, const char* key, uint32_t h) {
+    size_t i = h & m->mask;
+    for (;;) {
+        const StrMapEntry* e = &m->slots[i];
+        if (e->val < 0) {
+            return -1;
+        }
+        if (e->hash == h && strcmp(e->key, key) == 0) {
+            return (long)i;
+        }
+        i = (i + 1) & m->mask;
+    }
+}
+
+int strmap_init(StrMap* m, size_t max_keys) {
+    size_t cap = 16;
+    while (cap < max_keys * 2) {
+        cap *= 2;
+    }
+    m->slots = malloc(cap * sizeof(StrMapEntry));
+    if (!m->slots) {
+        return -1;
+    }
+    for (size_t i = 0; i < cap; i++) {
+        m->slots[i].val = -1;
+    }
+    m->mask = cap - 1;
+    m->count = 0;
+
+    return 0;
+}
+
+void strmap_free(StrMap* m) {
+    free(m->slots);
+    m->slots = NULL;
+    m->mask = 0;
+    m->count = 0;
+}
+
+int strmap_get(const StrMap* m, const char* key) {
+    long i = find_slot(m, key, hash_str(key));
+    return (i < 0) ? -1 : m->slots[i].val;
+}
+
+int strmap_put(StrMap* m, const char* key, int val) {
+    size_t klen = strlen(key);
+    if (klen >= STRMAP_KEY_MAX || val < 0) {
+        return -1;
+    }
+
+    uint32_t h = hash_str(key);
+    long found = find_slot(m, key, h);
+    if (found >= 0) {
+        m->slots[found].val = val;
+        return 0;
+    }
+    if (m->count + 1 > m->mask) {
+        return -1;
+    }
+
+    size_t i = h & m->mask;
+    while (m->slots[i].val >= 0) {
+        i = (i + 1) & m->mask;
+    }
+    m->slots[i].hash = h;
+    m->slots[i].val = val;
+    memcpy(m->slots[i].key, key, klen + 1);
+    m->count++;
+
+    return 0;
+}
+
+void strmap_del(StrMap* m, const char* key) {
+    long found = find_slot(m, key, hash_str(key));
+    if (found < 0) {
+        return;
+    }
+
+    // Backward-shift deletion: pull later entries of the probe run into the hole so lookups never need tombstones
+    size_t hole = (size_t)found;
+    size_t i = hole;
+    for (;;) {
+        i = (i + 1) & m->mask;
+        StrMapEntry* e = &m->slots[i];
+        if (e->val < 0) {
+            break;
+        }
+        size_t home = e->hash & m->mask;
+        if (((i - home) & m->mask) >= ((i - hole) & m->mask)) {
+            m->slots[hole] = *e;
+            hole = i;
+        }
+    }
+    m->slots[hole].val = -1;
+    m->count--;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file strmap.h
+ * @brief Open-addressing hash index from short strings to slot indices
+ *
+ * Used by the lobby to find clients by nickname or session token without scanning all client slots
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef STRMAP_H
+#define STRMAP_H
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define STRMAP_KEY_MAX 64   // Maximum key length including the terminator
+
+/**
+ * @brief One table entry
+ */
+typedef struct {
+    uint32_t hash;              // Hash of key
+    int val;                    // Stored value, -1 if the entry is empty
+    char key[STRMAP_KEY_MAX];   // Copy of the key
+} StrMapEntry;
+
+/**
+ * @brief Hash index with linear probing and backward-shift deletion
+ */
+typedef struct {
+    StrMapEntry* slots;     // Entry table (power-of-two size)
+    size_t mask;            // Table size - 1
+    size_t count;           // Number of stored keys
+} StrMap;
+
+/**
+ * @brief Creates an empty map
+ *
+ * The table is sized for at least twice the given number of keys so probe sequences stay short
+ *
+ * @param m         Map to initialize
+ * @param max_keys  Maximum number of keys that will be stored at once
+ *
+ * @return 0 on success, -1 on error
+ */
+int strmap_init(StrMap* m, size_t max_keys);
+
+/**
+ * @brief Releases the table of a map
+ *
+ * @param m     Map to destroy
+ */
+void strmap_free(StrMap* m);
+
+/**
+ * @brief Looks up a key
+ *
+ * @param m     Map
+ * @param key   Key to search for
+ *
+ * @return Stored value, or -1 if the key is not present
+ */
+int strmap_get(const StrMap* m, const char* key);
+
+/**
+ * @brief Inserts a key or replaces its value
+ *
+ * @param m     Map
+ * @param key   Key (shorter than STRMAP_KEY_MAX)
+ * @param val   Value (non-negative)
+ *
+ * @return 0 on success, -1 if the key is too long or the table is full
+ */
+int strmap_put(StrMap* m, const char* key, int val);
+
+/**
+ * @brief Removes a key if present
+ *
+ * @param m     Map
+ * @param key   Key to remove
+ */
+void strmap_del(StrMap* m, const char* key);
+
+#endif
@@ -0,0 +1,168 @@
+#define _POSIX_C_SOURCE 200809L
+#include "timer.h"
+#include <stdlib.h>
+#include <time.h>
+
+uint64_t timer_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/**
+ * @brief Stores a timer at a heap position and updates its back-reference
+ *
+ * @param h     Heap
+ * @param pos   0-based position
+ * @param t     Timer
+ */
+static void place(TimerHeap* h, int pos, Timer* t) {
+    h->heap[pos] = t;
+    t->heap_pos = pos + 1;
+}
+
+/**
+ * @brief Moves the timer at a position towards the root until the heap order holds
+ *
+ * @param h     Heap
+ * @param pos   0-based position
+ */
+static void sift_up(TimerHeap* h, int pos) {
+    Timer* t = h->heap[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (h->heap[parent]->due_ms <= t->due_ms) {
+            break;
+        }
+        place(h, pos, h->heap[parent]);
+        pos = parent;
+    }
+    place(h, pos, t);
+}
+
+/**
+ * @brief Moves the timer at a position towards the leaves until the heap order holds
+ *
+ * @param h     Heap
+ * @param pos   0-based position
+ */
+static void sift_down(TimerHeap* h, int pos) {
+    Timer* t = h->heap[pos];
+    for (;;) {
+        int child = pos * 2 + 1;
+        if (child >= h->count) {
+            break;
+        }
+        if (child + 1 < h->count && h->heap[child + 1]->due_ms < h->heap[child]->due_ms) {
+            child++;
+        }
+        if (t->due_ms <= h->heap[child]->due_ms) {
+            break;
+        }
+        place(h, pos, h->heap[child]);
+        pos = child;
+    }
+    place(h, pos, t);
+}
+
+int timers_init(TimerHeap* h, int cap) {
+    if (cap < 16) {
+        cap = 16;
+    }
+    h->heap = malloc((size_t)cap * sizeof(Timer*));
+    if (!h->heap) {
+        return -1;
+    }
+    h->count = 0;
+    h->cap = cap;
+
+    return 0;
+}
+
+void timers_destroy(TimerHeap* h) {
+    for (int i = 0; i < h->count; i++) {
+        h->heap[i]->heap_pos = 0;
+    }
+    free(h->heap);
+    h->heap = NULL;
+    h->count = 0;
+    h->cap = 0;
+}
+
+int timers_arm(TimerHeap* h, Timer* t, uint64_t due_ms, TimerFn fn, int arg) {
+    t->fn = fn;
+    t->arg = arg;
+
+    if (t->heap_pos > 0) {
+        uint64_t old = t->due_ms;
+        t->due_ms = due_ms;
+        if (due_ms < old) {
+            sift_up(h, t->heap_pos - 1);
+        }
+        else {
+            sift_down(h, t->heap_pos - 1);
+        }
+        return 0;
+    }
+
+    if (h->count == h->cap) {
+        int cap = h->cap ? h->cap * 2 : 16;
+        Timer** heap = realloc(h->heap, (size_t)cap * sizeof(Timer*));
+        if (!heap) {
+            return -1;
+        }
+        h->heap = heap;
+        h->cap = cap;
+    }
+
+    t->due_ms = due_ms;
+    h->heap[h->count] = t;
+    h->count++;
+    sift_up(h, h->count - 1);
+
+    return 0;
+}
+
+void timers_cancel(TimerHeap* h, Timer* t) {
+    if (t->heap_pos <= 0) {
+        return;
+    }
+    int pos = t->heap_pos - 1;
+    t->heap_pos = 0;
+
+    h->count--;
+    if (pos == h->count) {
+        return;
+    }
+
+    Timer* last = h->heap[h->count];
+    place(h, pos, last);
+    if (pos > 0 && h->heap[(pos - 1) / 2]->due_ms > last->due_ms) {
+        sift_up(h, pos);
+    }
+    else {
+        sift_down(h, pos);
+    }
+}
+
+void timers_run(TimerHeap* h, uint64_t now_ms) {
+    while (h->count > 0 && h->heap[0]->due_ms <= now_ms) {
+        Timer* t = h->heap[0];
+        timers_cancel(h, t);
+        if (t->fn) {
+            t->fn(t->arg);
+        }
+    }
+}
+
+int timers_timeout(const TimerHeap* h, uint64_t now_ms) {
+    if (h->count == 0) {
+        return -1;
+    }
+    uint64_t due = h->heap[0]->due_ms;
+    if (due <= now_ms) {
+        return 0;
+    }
+    uint64_t d = due - now_ms;
+    return (d > 0x7FFFFFFF) ? 0x7FFFFFFF : (int)d;
+}
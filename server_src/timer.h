@@ -0,0 +1,107 @@
+/**
+ * @file timer.h
+ * @brief Deadline timers kept in a binary min-heap
+ *
+ * Timers are embedded in the objects they belong to (clients, rooms). Only timers that are due are touched, and the time until the next deadline bounds the event loop wait
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief Timer expiry callback
+ */
+typedef void (*TimerFn)(int arg);
+
+/**
+ * @brief Timer node
+ *
+ * A zeroed timer is valid and disarmed, so it can live inside structures that are cleared with memset (they must not be armed at that moment)
+ */
+typedef struct {
+    uint64_t due_ms;    // Monotonic deadline in milliseconds
+    int heap_pos;       // 1-based heap position, 0 if not armed
+    TimerFn fn;         // Expiry callback
+    int arg;            // Callback argument (slot index)
+} Timer;
+
+/**
+ * @brief Heap of armed timers
+ */
+typedef struct {
+    Timer** heap;   // Armed timers ordered by due_ms
+    int count;      // Number of armed timers
+    int cap;        // Capacity of heap
+} TimerHeap;
+
+/**
+ * @brief Returns the monotonic clock in milliseconds
+ *
+ * @return Milliseconds since an arbitrary fixed point
+ */
+uint64_t timer_now_ms(void);
+
+/**
+ * @brief Initializes an empty heap
+ *
+ * @param h     Heap
+ * @param cap   Initial capacity (grows on demand)
+ *
+ * @return 0 on success, -1 on error
+ */
+int timers_init(TimerHeap* h, int cap);
+
+/**
+ * @brief Releases the storage of a heap
+ *
+ * @param h     Heap
+ */
+void timers_destroy(TimerHeap* h);
+
+/**
+ * @brief Arms a timer, or moves it if already armed
+ *
+ * @param h         Heap
+ * @param t         Timer
+ * @param due_ms    Monotonic deadline in milliseconds
+ * @param fn        Expiry callback
+ * @param arg       Callback argument
+ *
+ * @return 0 on success, -1 if memory could not be allocated
+ */
+int timers_arm(TimerHeap* h, Timer* t, uint64_t due_ms, TimerFn fn, int arg);
+
+/**
+ * @brief Disarms a timer (no-op if not armed)
+ *
+ * @param h     Heap
+ * @param t     Timer
+ */
+void timers_cancel(TimerHeap* h, Timer* t);
+
+/**
+ * @brief Fires all timers that are due
+ *
+ * Each timer is disarmed before its callback runs, so callbacks may re-arm it
+ *
+ * @param h         Heap
+ * @param now_ms    Current monotonic time in milliseconds
+ */
+void timers_run(TimerHeap* h, uint64_t now_ms);
+
+/**
+ * @brief Computes how long the event loop may sleep
+ *
+ * @param h         Heap
+ * @param now_ms    Current monotonic time in milliseconds
+ *
+ * @return Milliseconds until the next deadline, -1 if no timer is armed
+ */
+int timers_timeout(const TimerHeap* h, uint64_t now_ms);
+
+#endif
@@ -0,0 +1,351 @@
+#define _GNU_SOURCE
+#include "uring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define URING_BGID 0    // Group id of the provided receive buffers
+
+/**
+ * @brief io_uring_setup() system call
+ *
+ * @param entries   Submission ring size
+ * @param p         Setup parameters (in/out)
+ *
+ * @return io_uring descriptor, -1 on error
+ */
+static int sys_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+/**
+ * @brief io_uring_enter() system call
+ *
+ * @param fd            io_uring descriptor
+ * @param to_submit     Number of queued submissions
+ * @param min_complete  Number of completions to wait for
+ * @param flags         IORING_ENTER_* flags
+ * @param arg           Extended argument (IORING_ENTER_EXT_ARG) or NULL
+ * @param argsz         Size of arg
+ *
+ * @return Number of consumed submissions, -1 on error
+ */
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+/**
+ * @brief io_uring_register() system call
+ *
+ * @param fd        io_uring descriptor
+ * @param op        IORING_REGISTER_* opcode
+ * @param arg       Opcode argument
+ * @param nr_args   Opcode argument count
+ *
+ * @return 0 on success, -1 on error
+ */
+static int sys_register(int fd, unsigned op, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, nr_args);
+}
+
+/**
+ * @brief Hands all queued submissions to the kernel without waiting
+ *
+ * @param u     Instance
+ *
+ * @return 0 on success, -1 on error
+ */
+static int submit(Uring* u) {
+    while (u->sq_pending > 0) {
+        int n = sys_enter(u->fd, u->sq_pending, 0, 0, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        u->sq_pending -= (unsigned)n;
+        if (n == 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Takes a free submission entry, flushing queued submissions if the ring is full
+ *
+ * @param u     Instance
+ *
+ * @return Cleared entry, NULL if the ring stays full
+ */
+static struct io_uring_sqe* get_sqe(Uring* u) {
+    unsigned tail = *u->sq_tail;
+    if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+        if (submit(u) < 0) {
+            return NULL;
+        }
+        if (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+            return NULL;
+        }
+    }
+
+    unsigned i = tail & u->sq_mask;
+    struct io_uring_sqe* sqe = &((struct io_uring_sqe*)u->sqes)[i];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[i] = i;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->sq_pending++;
+
+    return sqe;
+}
+
+/**
+ * @brief Adds a buffer to the provided buffer ring (published by the next tail update)
+ *
+ * @param u     Instance
+ * @param id    Buffer id
+ */
+static void buf_add(Uring* u, unsigned id) {
+    struct io_uring_buf_ring* br = (struct io_uring_buf_ring*)u->br;
+    struct io_uring_buf* b = &br->bufs[u->br_tail & (u->buf_count - 1)];
+    b->addr = (uint64_t)(uintptr_t)(u->bufs + (size_t)id * u->buf_size);
+    b->len = u->buf_size;
+    b->bid = (uint16_t)id;
+    u->br_tail++;
+}
+
+int uring_init(Uring* u, unsigned entries, unsigned buf_count, unsigned buf_size) {
+    memset(u, 0, sizeof(*u));
+    u->fd = -1;
+    if (entries < 1 || buf_count < 1 || buf_count > 32768 || (buf_count & (buf_count - 1)) != 0) {
+        return -1;
+    }
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * 4;
+    u->fd = sys_setup(entries, &p);
+    if (u->fd < 0) {
+        return -1;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+        uring_free(u);
+        return -1;
+    }
+
+    u->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (cq_len > u->sq_map_len) {
+        u->sq_map_len = cq_len;
+    }
+    u->sq_map = mmap(NULL, u->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_map == MAP_FAILED) {
+        u->sq_map = NULL;
+        uring_free(u);
+        return -1;
+    }
+    u->cq_map = u->sq_map;
+
+    u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        uring_free(u);
+        return -1;
+    }
+
+    char* sq = (char*)u->sq_map;
+    u->sq_head = (unsigned*)(sq + p.sq_off.head);
+    u->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    u->sq_array = (unsigned*)(sq + p.sq_off.array);
+    u->sq_mask = *(unsigned*)(sq + p.sq_off.ring_mask);
+    u->sq_entries = p.sq_entries;
+
+    char* cq = (char*)u->cq_map;
+    u->cq_head = (unsigned*)(cq + p.cq_off.head);
+    u->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    u->cq_mask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    u->cqes = cq + p.cq_off.cqes;
+
+    u->buf_count = buf_count;
+    u->buf_size = buf_size;
+    u->br_len = buf_count * sizeof(struct io_uring_buf);
+    u->br = mmap(NULL, u->br_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->br == MAP_FAILED) {
+        u->br = NULL;
+        uring_free(u);
+        return -1;
+    }
+    u->bufs = malloc((size_t)buf_count * buf_size);
+    if (!u->bufs) {
+        uring_free(u);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)u->br;
+    reg.ring_entries = buf_count;
+    reg.bgid = URING_BGID;
+    if (sys_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        uring_free(u);
+        return -1;
+    }
+
+    for (unsigned i = 0; i < buf_count; i++) {
+        buf_add(u, i);
+    }
+    __atomic_store_n(&((struct io_uring_buf_ring*)u->br)->tail, u->br_tail, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+void uring_free(Uring* u) {
+    if (u->fd >= 0) {
+        close(u->fd);
+    }
+    if (u->sqes) {
+        munmap(u->sqes, u->sqes_len);
+    }
+    if (u->sq_map) {
+        munmap(u->sq_map, u->sq_map_len);
+    }
+    if (u->br) {
+        munmap(u->br, u->br_len);
+    }
+    free(u->bufs);
+    memset(u, 0, sizeof(*u));
+    u->fd = -1;
+}
+
+int uring_accept(Uring* u, int lfd, uint64_t tag) {
+    struct io_uring_sqe* sqe = get_sqe(u);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = lfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = tag;
+    return 0;
+}
+
+int uring_recv(Uring* u, int fd, uint64_t tag) {
+    struct io_uring_sqe* sqe = get_sqe(u);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    sqe->user_data = tag;
+    return 0;
+}
+
+int uring_poll(Uring* u, int fd, uint64_t tag) {
+    struct io_uring_sqe* sqe = get_sqe(u);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = tag;
+    return 0;
+}
+
+int uring_send(Uring* u, int fd, const void* data, size_t len, uint64_t tag) {
+    struct io_uring_sqe* sqe = get_sqe(u);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = (uint32_t)len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = tag;
+    return 0;
+}
+
+int uring_cancel(Uring* u, uint64_t target, uint64_t tag) {
+    struct io_uring_sqe* sqe = get_sqe(u);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = tag;
+    return 0;
+}
+
+int uring_wait(Uring* u, int timeout_ms) {
+    if (*u->cq_head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+        return submit(u);
+    }
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    int n = sys_enter(u->fd, u->sq_pending, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (n < 0) {
+        return (errno == EINTR || errno == ETIME || errno == EBUSY) ? 0 : -1;
+    }
+    u->sq_pending -= (unsigned)n;
+    return 0;
+}
+
+int uring_reap(Uring* u, UringEvent* out, int max) {
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+    int n = 0;
+    while (head != tail && n < max) {
+        const struct io_uring_cqe* cqe = &((const struct io_uring_cqe*)u->cqes)[head & u->cq_mask];
+        out[n].tag = cqe->user_data;
+        out[n].res = cqe->res;
+        out[n].flags = 0;
+        out[n].buf = 0;
+        if (cqe->flags & IORING_CQE_F_MORE) {
+            out[n].flags |= URING_MORE;
+        }
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            out[n].flags |= URING_BUFFER;
+            out[n].buf = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        }
+        head++;
+        n++;
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+const char* uring_buf(const Uring* u, unsigned id) {
+    return u->bufs + (size_t)id * u->buf_size;
+}
+
+void uring_buf_return(Uring* u, unsigned id) {
+    buf_add(u, id);
+    __atomic_store_n(&((struct io_uring_buf_ring*)u->br)->tail, u->br_tail, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,186 @@
+/**
+ * @file uring.h
+ * @brief Completion-based I/O backend on io_uring (raw system calls, no liburing)
+ *
+ * Accepts and receives are multishot: one submission keeps producing completions. Received data lands in a ring of provided buffers that the kernel picks from, and queued submissions go to the kernel together with the wait for completions, so a whole loop iteration costs a single system call
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define URING_MORE      0x01u   // More completions follow for the same submission
+#define URING_BUFFER    0x02u   // Completion carries a provided buffer (see UringEvent.buf)
+
+/**
+ * @brief One completion returned by uring_reap()
+ */
+typedef struct {
+    uint64_t tag;       // Tag given when the operation was submitted
+    int res;            // Result: byte count, accepted descriptor or negative errno
+    uint32_t flags;     // URING_MORE / URING_BUFFER bits
+    unsigned buf;       // Provided buffer id (URING_BUFFER only)
+} UringEvent;
+
+/**
+ * @brief io_uring instance with one group of provided receive buffers
+ */
+typedef struct {
+    int fd;                 // io_uring descriptor, -1 if not set up
+
+    void* sq_map;           // Submission ring mapping
+    size_t sq_map_len;      // Length of sq_map
+    void* cq_map;           // Completion ring mapping (may alias sq_map)
+    size_t cq_map_len;      // Length of cq_map
+    void* sqes;             // Submission queue entries
+    size_t sqes_len;        // Length of sqes
+
+    unsigned* sq_head;      // Kernel-owned submission head
+    unsigned* sq_tail;      // Submission tail
+    unsigned* sq_array;     // Submission index array
+    unsigned sq_mask;       // Submission ring mask
+    unsigned sq_entries;    // Submission ring size
+    unsigned sq_pending;    // Entries queued since the last io_uring_enter()
+
+    unsigned* cq_head;      // Completion head
+    unsigned* cq_tail;      // Kernel-owned completion tail
+    unsigned cq_mask;       // Completion ring mask
+    void* cqes;             // Completion queue entries
+
+    void* br;               // Provided buffer ring
+    size_t br_len;          // Length of the br mapping
+    char* bufs;             // Buffer storage (buf_count * buf_size bytes)
+    unsigned buf_count;     // Number of provided buffers (power of two)
+    unsigned buf_size;      // Size of one provided buffer
+    unsigned short br_tail; // Local copy of the buffer ring tail
+} Uring;
+
+/**
+ * @brief Sets up an io_uring instance and registers its receive buffers
+ *
+ * Fails on kernels without io_uring, multishot support or provided buffer rings, the caller then stays on epoll
+ *
+ * @param u             Instance to initialize
+ * @param entries       Submission ring size (the completion ring gets four times as many entries)
+ * @param buf_count     Number of receive buffers (power of two)
+ * @param buf_size      Size of one receive buffer in bytes
+ *
+ * @return 0 on success, -1 on error
+ */
+int uring_init(Uring* u, unsigned entries, unsigned buf_count, unsigned buf_size);
+
+/**
+ * @brief Releases all resources of an instance
+ *
+ * @param u     Instance to destroy
+ */
+void uring_free(Uring* u);
+
+/**
+ * @brief Queues a multishot accept on a listening socket
+ *
+ * Accepted sockets are non-blocking and close-on-exec, their descriptor is the completion result
+ *
+ * @param u     Instance
+ * @param lfd   Listening socket
+ * @param tag   Tag reported with every completion
+ *
+ * @return 0 on success, -1 if the submission ring is full
+ */
+int uring_accept(Uring* u, int lfd, uint64_t tag);
+
+/**
+ * @brief Queues a multishot receive that takes its buffers from the provided buffer ring
+ *
+ * @param u     Instance
+ * @param fd    Connected socket
+ * @param tag   Tag reported with every completion
+ *
+ * @return 0 on success, -1 if the submission ring is full
+ */
+int uring_recv(Uring* u, int fd, uint64_t tag);
+
+/**
+ * @brief Queues a multishot readability poll
+ *
+ * @param u     Instance
+ * @param fd    Descriptor to watch
+ * @param tag   Tag reported with every completion
+ *
+ * @return 0 on success, -1 if the submission ring is full
+ */
+int uring_poll(Uring* u, int fd, uint64_t tag);
+
+/**
+ * @brief Queues a send
+ *
+ * The data must stay untouched until the completion arrives
+ *
+ * @param u     Instance
+ * @param fd    Connected socket
+ * @param data  Bytes to send
+ * @param len   Number of bytes
+ * @param tag   Tag reported with the completion
+ *
+ * @return 0 on success, -1 if the submission ring is full
+ */
+int uring_send(Uring* u, int fd, const void* data, size_t len, uint64_t tag);
+
+/**
+ * @brief Queues the cancellation of an operation
+ *
+ * The cancelled operation still reports a final completion (without URING_MORE)
+ *
+ * @param u         Instance
+ * @param target    Tag of the operation to cancel
+ * @param tag       Tag reported with the completion of the cancel request itself
+ *
+ * @return 0 on success, -1 if the submission ring is full
+ */
+int uring_cancel(Uring* u, uint64_t target, uint64_t tag);
+
+/**
+ * @brief Submits all queued operations and waits for at least one completion
+ *
+ * @param u             Instance
+ * @param timeout_ms    Timeout in milliseconds, -1 waits forever
+ *
+ * @return 0 on completion, timeout or interruption, -1 on error
+ */
+int uring_wait(Uring* u, int timeout_ms);
+
+/**
+ * @brief Takes completions from the completion ring
+ *
+ * @param u     Instance
+ * @param out   Output array
+ * @param max   Capacity of out
+ *
+ * @return Number of completions stored in out
+ */
+int uring_reap(Uring* u, UringEvent* out, int max);
+
+/**
+ * @brief Returns the storage of a provided buffer
+ *
+ * @param u     Instance
+ * @param id    Buffer id from UringEvent.buf
+ *
+ * @return Buffer start
+ */
+const char* uring_buf(const Uring* u, unsigned id);
+
+/**
+ * @brief Gives a provided buffer back to the kernel once its data has been consumed
+ *
+ * @param u     Instance
+ * @param id    Buffer id from UringEvent.buf
+ */
+void uring_buf_return(Uring* u, unsigned id);
+
+#endif
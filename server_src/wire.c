@@ -0,0 +1,794 @@
+#include "wire.h"
+#include "game.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FIELDS_MAX 8    // Fields per message, a presence mask has one bit per field
+
+/**
+ * @brief Encoding of a field value
+ */
+typedef enum {
+    K_INT = 1,  // Decimal number without sign or leading zeros: varint
+    K_STR,      // Token: varint length, bytes (no whitespace, control bytes, "=" or DEL)
+    K_CARD,     // Card like "H7" or "-": card code, 0xFF for "-"
+    K_CHAR,     // Single character: the byte itself
+    K_NICK,     // Nickname or "-": table index + 1, 0 for "-"
+    K_CARDS,    // Comma-separated cards: count byte, card codes
+    K_RATIO,    // "<a>/<b>": two varints
+    K_PHASE     // "LOBBY" or "GAME": 0 or 1
+} Kind;
+
+/**
+ * @brief One field of a message layout
+ */
+typedef struct {
+    const char* key;        // Key in the text line
+    unsigned char kind;     // Kind of the value
+    unsigned char opt;      // Non-zero if the field may be absent
+} Field;
+
+/**
+ * @brief Layout of the message behind one opcode
+ */
+typedef struct {
+    unsigned char type;         // ProtoType, 0 for unused opcodes
+    const char* cmd;            // Command token, NULL if it travels as the first string (ERR)
+    Field f[FIELDS_MAX];        // Fields in wire order, terminated by a NULL key
+} Layout;
+
+#define REQ(c)  PT_REQ,  #c
+#define RESP(c) PT_RESP, #c
+#define EVT(c)  PT_EVT,  #c
+
+static const Layout g_layouts[128] = {
+    [CMD_LOGIN]       = { REQ(LOGIN),       { { "nick", K_STR, 0 } } },
+    [CMD_RESUME]      = { REQ(RESUME),      { { "nick", K_STR, 0 }, { "session", K_STR, 0 } } },
+    [CMD_LOGOUT]      = { REQ(LOGOUT),      { { NULL, 0, 0 } } },
+    [CMD_PING]        = { REQ(PING),        { { NULL, 0, 0 } } },
+    [CMD_LIST_ROOMS]  = { REQ(LIST_ROOMS),  { { NULL, 0, 0 } } },
+    [CMD_CREATE_ROOM] = { REQ(CREATE_ROOM), { { "name", K_STR, 0 }, { "size", K_INT, 0 } } },
+    [CMD_JOIN_ROOM]   = { REQ(JOIN_ROOM),   { { "room", K_INT, 0 } } },
+    [CMD_LEAVE_ROOM]  = { REQ(LEAVE_ROOM),  { { NULL, 0, 0 } } },
+    [CMD_START_GAME]  = { REQ(START_GAME),  { { NULL, 0, 0 } } },
+    [CMD_PLAY]        = { REQ(PLAY),        { { "card", K_CARD, 0 }, { "wish", K_CHAR, 1 } } },
+    [CMD_DRAW]        = { REQ(DRAW),        { { NULL, 0, 0 } } },
+    [CMD_PROTO]       = { REQ(PROTO),       { { "mode", K_STR, 0 } } },
+
+    [WIRE_OP_RESP + CMD_LOGIN]       = { RESP(LOGIN),       { { "ok", K_INT, 0 }, { "session", K_STR, 0 } } },
+    [WIRE_OP_RESP + CMD_RESUME]      = { RESP(RESUME),      { { "ok", K_INT, 0 } } },
+    [WIRE_OP_RESP + CMD_LOGOUT]      = { RESP(LOGOUT),      { { "ok", K_INT, 0 } } },
+    [WIRE_OP_RESP + CMD_LIST_ROOMS]  = { RESP(LIST_ROOMS),  { { "ok", K_INT, 0 }, { "rooms", K_INT, 0 } } },
+    [WIRE_OP_RESP + CMD_CREATE_ROOM] = { RESP(CREATE_ROOM), { { "ok", K_INT, 0 }, { "room", K_INT, 0 } } },
+    [WIRE_OP_RESP + CMD_JOIN_ROOM]   = { RESP(JOIN_ROOM),   { { "ok", K_INT, 0 }, { "room", K_INT, 0 } } },
+    [WIRE_OP_RESP + CMD_LEAVE_ROOM]  = { RESP(LEAVE_ROOM),  { { "ok", K_INT, 0 } } },
+    [WIRE_OP_RESP + CMD_START_GAME]  = { RESP(START_GAME),  { { "ok", K_INT, 0 } } },
+    [WIRE_OP_RESP + CMD_PLAY]        = { RESP(PLAY),        { { "ok", K_INT, 0 } } },
+    [WIRE_OP_RESP + CMD_DRAW]        = { RESP(DRAW),        { { "ok", K_INT, 0 }, { "count", K_INT, 0 } } },
+    [WIRE_OP_RESP + CMD_PROTO]       = { RESP(PROTO),       { { "ok", K_INT, 0 }, { "mode", K_STR, 0 } } },
+    [WIRE_OP_PONG]                   = { RESP(PONG),        { { NULL, 0, 0 } } },
+
+    [WIRE_OP_ERR]      = { PT_ERR, NULL,      { { "code", K_STR, 0 }, { "msg", K_STR, 0 } } },
+
+    [WIRE_OP_EVT + 0]  = { EVT(STATE),          { { "room", K_INT, 0 }, { "phase", K_PHASE, 0 }, { "paused", K_INT, 0 }, { "top", K_CARD, 0 },
+                                                  { "active_suit", K_CHAR, 0 }, { "penalty", K_INT, 0 }, { "turn", K_NICK, 0 }, { "ver", K_INT, 0 } } },
+    [WIRE_OP_EVT + 1]  = { EVT(HOST),           { { "nick", K_NICK, 0 } } },
+    [WIRE_OP_EVT + 2]  = { EVT(PLAYER_JOIN),    { { "nick", K_NICK, 0 } } },
+    [WIRE_OP_EVT + 3]  = { EVT(PLAYER_ONLINE),  { { "nick", K_NICK, 0 } } },
+    [WIRE_OP_EVT + 4]  = { EVT(PLAYER_OFFLINE), { { "nick", K_NICK, 0 } } },
+    [WIRE_OP_EVT + 5]  = { EVT(PLAYER_LEAVE),   { { "nick", K_NICK, 0 } } },
+    [WIRE_OP_EVT + 6]  = { EVT(TURN),           { { "nick", K_NICK, 0 } } },
+    [WIRE_OP_EVT + 7]  = { EVT(TOP),            { { "card", K_CARD, 0 }, { "active_suit", K_CHAR, 0 }, { "penalty", K_INT, 0 } } },
+    [WIRE_OP_EVT + 8]  = { EVT(PLAYED),         { { "nick", K_NICK, 0 }, { "card", K_CARD, 0 }, { "wish", K_CHAR, 1 } } },
+    [WIRE_OP_EVT + 9]  = { EVT(HAND),           { { "cards", K_CARDS, 0 } } },
+    [WIRE_OP_EVT + 10] = { EVT(GAME_START),     { { "players", K_INT, 0 } } },
+    [WIRE_OP_EVT + 11] = { EVT(GAME_END),       { { "winner", K_NICK, 0 } } },
+    [WIRE_OP_EVT + 12] = { EVT(GAME_PAUSED),    { { "nick", K_NICK, 1 }, { "timeout", K_INT, 0 } } },
+    [WIRE_OP_EVT + 13] = { EVT(GAME_RESUMED),   { { NULL, 0, 0 } } },
+    [WIRE_OP_EVT + 14] = { EVT(GAME_ABORT),     { { "reason", K_STR, 0 } } },
+    [WIRE_OP_EVT + 15] = { EVT(ROOM),           { { "id", K_INT, 0 }, { "name", K_STR, 0 }, { "players", K_RATIO, 0 }, { "state", K_PHASE, 0 } } },
+    [WIRE_OP_EVT + 16] = { EVT(STATE_DELTA),    { { "ver", K_INT, 0 }, { "phase", K_PHASE, 1 }, { "paused", K_INT, 1 }, { "top", K_CARD, 1 },
+                                                  { "active_suit", K_CHAR, 1 }, { "penalty", K_INT, 1 }, { "turn", K_NICK, 1 } } },
+};
+
+static const char* const g_type_names[] = { "", "REQ", "RESP", "EVT", "ERR" };
+
+/**
+ * @brief Bounded output cursor
+ */
+typedef struct {
+    unsigned char* p;   // Next byte to write
+    unsigned char* end; // End of the buffer
+} Out;
+
+/**
+ * @brief Writes one byte
+ *
+ * @param o     Output cursor
+ * @param b     Byte
+ *
+ * @return 0 on success, -1 if the buffer is full
+ */
+static int put_byte(Out* o, unsigned b) {
+    if (o->p >= o->end) {
+        return -1;
+    }
+    *o->p++ = (unsigned char)b;
+    return 0;
+}
+
+/**
+ * @brief Writes an unsigned LEB128 varint
+ *
+ * @param o     Output cursor
+ * @param v     Value
+ *
+ * @return 0 on success, -1 if the buffer is full
+ */
+static int put_varint(Out* o, uint64_t v) {
+    while (v >= 0x80) {
+        if (put_byte(o, (unsigned)(v & 0x7F) | 0x80) < 0) {
+            return -1;
+        }
+        v >>= 7;
+    }
+    return put_byte(o, (unsigned)v);
+}
+
+/**
+ * @brief Tells whether bytes can stand as a string value of a text line
+ *
+ * Whitespace, control bytes, '=' and DEL would split or forge tokens (or whole lines) once the value is printed as text, so they never travel inside a K_STR value
+ *
+ * @param s     Bytes
+ * @param len   Number of bytes
+ *
+ * @return 1 if every byte is allowed, 0 otherwise
+ */
+static int token_bytes(const void* s, size_t len) {
+    const unsigned char* b = s;
+    for (size_t i = 0; i < len; i++) {
+        if (b[i] <= ' ' || b[i] == '=' || b[i] == 0x7F) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Writes a length-prefixed string
+ *
+ * @param o     Output cursor
+ * @param s     Bytes
+ * @param len   Number of bytes
+ *
+ * @return 0 on success, -1 if the buffer is full
+ */
+static int put_str(Out* o, const char* s, size_t len) {
+    if (put_varint(o, len) < 0 || (size_t)(o->end - o->p) < len) {
+        return -1;
+    }
+    memcpy(o->p, s, len);
+    o->p += len;
+    return 0;
+}
+
+/**
+ * @brief Writes a complete frame: length prefix and body
+ *
+ * @param o     Output cursor
+ * @param body  Body bytes
+ * @param len   Body length
+ *
+ * @return 0 on success, -1 if the buffer is full or the body too long
+ */
+static int put_frame(Out* o, const unsigned char* body, size_t len) {
+    if (len >= (1u << (7 * WIRE_HEAD_MAX)) || put_varint(o, len) < 0 || (size_t)(o->end - o->p) < len) {
+        return -1;
+    }
+    memcpy(o->p, body, len);
+    o->p += len;
+    return 0;
+}
+
+/**
+ * @brief Reads an unsigned LEB128 varint
+ *
+ * @param p     Cursor, advanced past the varint
+ * @param end   End of the input
+ * @param v     Output value
+ *
+ * @return 0 on success, -1 if the input ends early or the value overflows
+ */
+static int get_varint(const unsigned char** p, const unsigned char* end, uint64_t* v) {
+    uint64_t r = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*p >= end) {
+            return -1;
+        }
+        unsigned b = *(*p)++;
+        r |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Parses a canonical decimal number (digits only, no leading zero)
+ *
+ * @param s     Value
+ * @param len   Value length
+ * @param v     Output number
+ *
+ * @return 1 if the value is canonical, 0 otherwise
+ */
+static int parse_uint(const char* s, size_t len, uint64_t* v) {
+    if (len == 0 || len > 19 || (len > 1 && s[0] == '0')) {
+        return 0;
+    }
+    uint64_t r = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return 0;
+        }
+        r = r * 10 + (uint64_t)(s[i] - '0');
+    }
+    *v = r;
+    return 1;
+}
+
+/**
+ * @brief Parses a card in the form card_to_str() prints it
+ *
+ * @param s     Value (two characters)
+ * @param code  Output card code
+ *
+ * @return 1 if the value is a canonical card, 0 otherwise
+ */
+static int parse_card(const char* s, unsigned char* code) {
+    char t[3] = { s[0], s[1], '\0' };
+    char back[4];
+    if (!str_to_card(t, code)) {
+        return 0;
+    }
+    card_to_str(*code, back);
+    return back[0] == s[0] && back[1] == s[1];
+}
+
+/**
+ * @brief Returns the table index of a nickname, assigning and announcing an entry if needed
+ *
+ * @param nicks     Nickname table
+ * @param s         Nickname
+ * @param len       Nickname length
+ * @param o         Output cursor for the WIRE_OP_NICK frame
+ *
+ * @return Table index, -1 if the nickname is too long or the buffer is full
+ */
+static int intern_nick(WireNicks* nicks, const char* s, size_t len, Out* o) {
+    if (len == 0 || len >= sizeof(nicks->nick[0])) {
+        return -1;
+    }
+    for (int i = 0; i < WIRE_NICKS; i++) {
+        if (strncmp(nicks->nick[i], s, len) == 0 && nicks->nick[i][len] == '\0') {
+            return i;
+        }
+    }
+
+    int i = (int)(nicks->next++ % WIRE_NICKS);
+    unsigned char body[2 + sizeof(nicks->nick[0])];
+    Out b = { body, body + sizeof(body) };
+    put_byte(&b, WIRE_OP_NICK);
+    put_byte(&b, (unsigned)i);
+    put_str(&b, s, len);
+    if (put_frame(o, body, (size_t)(b.p - body)) < 0) {
+        return -1;
+    }
+    memcpy(nicks->nick[i], s, len);
+    nicks->nick[i][len] = '\0';
+    return i;
+}
+
+/**
+ * @brief Encodes one field value
+ *
+ * @param o         Output cursor (frame body)
+ * @param kind      Kind of the value
+ * @param v         Value
+ * @param len       Value length
+ * @param nicks     Nickname table, NULL if nicknames cannot be encoded
+ * @param defs      Output cursor for WIRE_OP_NICK frames
+ *
+ * @return 0 on success, -1 if the value has no canonical encoding or a buffer is full
+ */
+static int encode_value(Out* o, unsigned kind, const char* v, size_t len, WireNicks* nicks, Out* defs) {
+    uint64_t n;
+    uint64_t m;
+    unsigned char code;
+
+    switch (kind) {
+        case K_INT:
+            return parse_uint(v, len, &n) ? put_varint(o, n) : -1;
+        case K_STR:
+            return token_bytes(v, len) ? put_str(o, v, len) : -1;
+        case K_CARD:
+            if (len == 1 && v[0] == '-') {
+                return put_byte(o, 0xFF);
+            }
+            return (len == 2 && parse_card(v, &code)) ? put_byte(o, code) : -1;
+        case K_CHAR:
+            return (len == 1 && v[0] > ' ' && v[0] < 0x7F) ? put_byte(o, (unsigned char)v[0]) : -1;
+        case K_NICK: {
+            if (len == 1 && v[0] == '-') {
+                return put_byte(o, 0);
+            }
+            int i = nicks ? intern_nick(nicks, v, len, defs) : -1;
+            return (i >= 0) ? put_byte(o, (unsigned)i + 1) : -1;
+        }
+        case K_CARDS: {
+            // Two characters per card and a comma between cards
+            if (len > 0 && (len % 3 != 2 || len > 3 * 32)) {
+                return -1;
+            }
+            size_t count = (len + 1) / 3;
+            if (put_byte(o, (unsigned)count) < 0) {
+                return -1;
+            }
+            for (size_t i = 0; i < count; i++) {
+                const char* c = v + 3 * i;
+                if ((i + 1 < count && c[2] != ',') || !parse_card(c, &code) || put_byte(o, code) < 0) {
+                    return -1;
+                }
+            }
+            return 0;
+        }
+        case K_RATIO: {
+            const char* slash = memchr(v, '/', len);
+            if (!slash || !parse_uint(v, (size_t)(slash - v), &n) || !parse_uint(slash + 1, len - (size_t)(slash - v) - 1, &m)) {
+                return -1;
+            }
+            return (put_varint(o, n) < 0) ? -1 : put_varint(o, m);
+        }
+        case K_PHASE:
+            if (len == 5 && memcmp(v, "LOBBY", 5) == 0) {
+                return put_byte(o, 0);
+            }
+            if (len == 4 && memcmp(v, "GAME", 4) == 0) {
+                return put_byte(o, 1);
+            }
+            return -1;
+        default:
+            return -1;
+    }
+}
+
+/**
+ * @brief Finds the opcode of a message
+ *
+ * @param type  Message type
+ * @param cmd   Command token
+ * @param len   Token length
+ *
+ * @return Opcode, -1 if the message has no binary form
+ */
+static int find_op(ProtoType type, const char* cmd, size_t len) {
+    if (type == PT_REQ || (type == PT_RESP && !(len == 4 && memcmp(cmd, "PONG", 4) == 0))) {
+        ProtoCmd id = proto_cmd_id(cmd, len);
+        if (id == CMD_UNKNOWN) {
+            return -1;
+        }
+        return (type == PT_REQ) ? (int)id : WIRE_OP_RESP + (int)id;
+    }
+    if (type == PT_ERR) {
+        return WIRE_OP_ERR;
+    }
+    for (int op = (type == PT_RESP) ? WIRE_OP_PONG : WIRE_OP_EVT; op < WIRE_OP_NICK; op++) {
+        const Layout* l = &g_layouts[op];
+        if (l->type == type && strlen(l->cmd) == len && memcmp(l->cmd, cmd, len) == 0) {
+            return op;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Takes the next space-separated token
+ *
+ * @param s     Cursor, advanced past the token
+ * @param end   End of the line
+ * @param len   Output: token length
+ *
+ * @return Token start, NULL at the end of the line
+ */
+static const char* next_token(const char** s, const char* end, size_t* len) {
+    const char* p = *s;
+    while (p < end && *p == ' ') {
+        p++;
+    }
+    if (p >= end) {
+        *s = p;
+        return NULL;
+    }
+    const char* t = p;
+    while (p < end && *p != ' ') {
+        p++;
+    }
+    *len = (size_t)(p - t);
+    *s = p;
+    return t;
+}
+
+/**
+ * @brief Encodes a text line as one message frame, preceded by the nickname entries it needs
+ *
+ * @param line      Text line without terminator
+ * @param end       End of the line
+ * @param nicks     Nickname table, NULL if nicknames cannot be encoded
+ * @param o         Output cursor
+ *
+ * @return 0 on success, -1 if the line has no binary form or the buffer is full
+ */
+static int encode_line(const char* line, const char* end, WireNicks* nicks, Out* o) {
+    const char* s = line;
+    size_t tlen;
+    size_t clen;
+    const char* t = next_token(&s, end, &tlen);
+    const char* cmd = t ? next_token(&s, end, &clen) : NULL;
+    if (!cmd) {
+        return -1;
+    }
+
+    int type = 0;
+    for (int i = PT_REQ; i <= PT_ERR; i++) {
+        if (strlen(g_type_names[i]) == tlen && memcmp(g_type_names[i], t, tlen) == 0) {
+            type = i;
+        }
+    }
+    int op = type ? find_op((ProtoType)type, cmd, clen) : -1;
+    if (op < 0) {
+        return -1;
+    }
+
+    const Layout* l = &g_layouts[op];
+    unsigned char body[1024];
+    Out b = { body, body + sizeof(body) };
+    put_byte(&b, (unsigned)op);
+    if (!l->cmd && put_str(&b, cmd, clen) < 0) {
+        return -1;
+    }
+
+    int masked = 0;
+    for (int f = 0; f < FIELDS_MAX && l->f[f].key; f++) {
+        masked |= l->f[f].opt;
+    }
+    unsigned char* mask = b.p;
+    if (masked) {
+        put_byte(&b, 0);
+    }
+
+    // Fields must appear in layout order, which is the order the server prints them in
+    const char* v = next_token(&s, end, &tlen);
+    for (int f = 0; f < FIELDS_MAX && l->f[f].key; f++) {
+        const Field* fd = &l->f[f];
+        size_t klen = strlen(fd->key);
+        int present = v && tlen > klen && v[klen] == '=' && memcmp(v, fd->key, klen) == 0;
+        if (!present) {
+            if (!fd->opt) {
+                return -1;
+            }
+            continue;
+        }
+        if (encode_value(&b, fd->kind, v + klen + 1, tlen - klen - 1, nicks, o) < 0) {
+            return -1;
+        }
+        if (masked) {
+            *mask |= (unsigned char)(1u << f);
+        }
+        v = next_token(&s, end, &tlen);
+    }
+    if (v) {
+        return -1;
+    }
+    return put_frame(o, body, (size_t)(b.p - body));
+}
+
+int wire_encode(const char* line, size_t len, WireNicks* nicks, unsigned char* out, size_t cap) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+        len--;
+    }
+
+    Out o = { out, out + cap };
+    if (encode_line(line, line + len, nicks, &o) == 0) {
+        return (int)(o.p - out);
+    }
+
+    // Keep the nickname entries already announced, they are valid frames on their own
+    unsigned char body[1 + 1024];
+    if (len >= sizeof(body)) {
+        return -1;
+    }
+    body[0] = WIRE_OP_TEXT;
+    memcpy(body + 1, line, len);
+    if (put_frame(&o, body, len + 1) < 0) {
+        return -1;
+    }
+    return (int)(o.p - out);
+}
+
+int wire_frame_head(const unsigned char* p, size_t avail, size_t* body_len) {
+    size_t v = 0;
+    for (int i = 0; i < WIRE_HEAD_MAX; i++) {
+        if ((size_t)i >= avail) {
+            return 0;
+        }
+        v |= (size_t)(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            *body_len = v;
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Bounded text cursor
+ */
+typedef struct {
+    char* p;    // Next byte to write
+    char* end;  // End of the buffer
+} Text;
+
+/**
+ * @brief Appends a formatted value and terminates it
+ *
+ * @param t     Text cursor, advanced past the terminator
+ * @param fmt   printf-style format
+ * @param a     First argument
+ * @param b     Second argument
+ *
+ * @return Start of the value, NULL if the buffer is full
+ */
+static const char* put_text(Text* t, const char* fmt, unsigned long long a, unsigned long long b) {
+    int n = snprintf(t->p, (size_t)(t->end - t->p), fmt, a, b);
+    if (n < 0 || n >= t->end - t->p) {
+        return NULL;
+    }
+    const char* s = t->p;
+    t->p += n + 1;
+    return s;
+}
+
+/**
+ * @brief Appends a string and terminates it
+ *
+ * @param t     Text cursor, advanced past the terminator
+ * @param v     String
+ *
+ * @return Start of the copy, NULL if the buffer is full
+ */
+static const char* put_str_text(Text* t, const char* v) {
+    size_t len = strlen(v);
+    if (len >= (size_t)(t->end - t->p)) {
+        return NULL;
+    }
+    memcpy(t->p, v, len + 1);
+    const char* s = t->p;
+    t->p += len + 1;
+    return s;
+}
+
+/**
+ * @brief Decodes one field value and renders it as text
+ *
+ * @param p         Input cursor
+ * @param end       End of the body
+ * @param kind      Kind of the value
+ * @param nicks     Nickname table, NULL if indices are not expected
+ * @param t         Text cursor
+ * @param out       Output slice
+ *
+ * @return 0 on success, -1 if the value is malformed or the text buffer is full
+ */
+static int decode_value(const unsigned char** p, const unsigned char* end, unsigned kind, const WireNicks* nicks, Text* t, ProtoSlice* out) {
+    uint64_t n;
+    uint64_t m;
+    const char* s = NULL;
+    char card[4];
+
+    switch (kind) {
+        case K_INT:
+            if (get_varint(p, end, &n) == 0) {
+                s = put_text(t, "%llu", (unsigned long long)n, 0);
+            }
+            break;
+        case K_STR:
+            if (get_varint(p, end, &n) == 0 && n < MAX_VAL && n <= (uint64_t)(end - *p) && n < (uint64_t)(t->end - t->p) && token_bytes(*p, (size_t)n)) {
+                memcpy(t->p, *p, (size_t)n);
+                t->p[n] = '\0';
+                s = t->p;
+                t->p += n + 1;
+                *p += n;
+            }
+            break;
+        case K_CARD:
+            if (*p < end && (**p < 32 || **p == 0xFF)) {
+                unsigned c = *(*p)++;
+                if (c == 0xFF) {
+                    s = put_str_text(t, "-");
+                }
+                else {
+                    card_to_str((unsigned char)c, card);
+                    s = put_str_text(t, card);
+                }
+            }
+            break;
+        case K_CHAR:
+            if (*p < end && **p > ' ' && **p < 0x7F) {
+                card[0] = (char)*(*p)++;
+                card[1] = '\0';
+                s = put_str_text(t, card);
+            }
+            break;
+        case K_NICK:
+            if (*p < end) {
+                unsigned i = *(*p)++;
+                if (i == 0) {
+                    s = put_str_text(t, "-");
+                }
+                else if (nicks && i <= WIRE_NICKS && nicks->nick[i - 1][0]) {
+                    s = put_str_text(t, nicks->nick[i - 1]);
+                }
+            }
+            break;
+        case K_CARDS:
+            if (*p < end && **p <= 32 && (size_t)(end - *p) > **p && (size_t)(t->end - t->p) > 3u * **p) {
+                unsigned count = *(*p)++;
+                s = t->p;
+                for (unsigned i = 0; i < count; i++) {
+                    unsigned c = *(*p)++;
+                    if (c >= 32) {
+                        return -1;
+                    }
+                    card_to_str((unsigned char)c, card);
+                    *t->p++ = card[0];
+                    *t->p++ = card[1];
+                    if (i + 1 < count) {
+                        *t->p++ = ',';
+                    }
+                }
+                *t->p++ = '\0';
+            }
+            break;
+        case K_RATIO:
+            if (get_varint(p, end, &n) == 0 && get_varint(p, end, &m) == 0) {
+                s = put_text(t, "%llu/%llu", (unsigned long long)n, (unsigned long long)m);
+            }
+            break;
+        case K_PHASE:
+            if (*p < end && **p <= 1) {
+                s = put_str_text(t, *(*p)++ ? "GAME" : "LOBBY");
+            }
+            break;
+        default:
+            break;
+    }
+    if (!s) {
+        return -1;
+    }
+    out->ptr = s;
+    out->len = strlen(s);
+    return 0;
+}
+
+ProtoResult wire_decode(const unsigned char* body, size_t len, const WireNicks* nicks, char* scratch, size_t cap, ProtoMsg* out) {
+    if (len == 0 || body[0] >= 128 || !g_layouts[body[0]].type) {
+        return PROTO_BAD;
+    }
+    const Layout* l = &g_layouts[body[0]];
+    const unsigned char* p = body + 1;
+    const unsigned char* end = body + len;
+    Text t = { scratch, scratch + cap };
+
+    out->type = (ProtoType)l->type;
+    out->rest = NULL;
+    out->end = NULL;
+    out->kv_count = 0;
+    if (l->cmd) {
+        out->cmd = l->cmd;
+        out->cmd_len = strlen(l->cmd);
+    }
+    else {
+        ProtoSlice cmd;
+        if (decode_value(&p, end, K_STR, NULL, &t, &cmd) < 0) {
+            return PROTO_BAD;
+        }
+        if (cmd.len >= MAX_CMD) {
+            cmd.len = MAX_CMD - 1;
+            ((char*)cmd.ptr)[cmd.len] = '\0';
+        }
+        out->cmd = cmd.ptr;
+        out->cmd_len = cmd.len;
+    }
+    out->cmd_id = (l->type == PT_REQ) ? (ProtoCmd)body[0] : proto_cmd_id(out->cmd, out->cmd_len);
+
+    unsigned mask = ~0u;
+    for (int f = 0; f < FIELDS_MAX && l->f[f].key; f++) {
+        if (l->f[f].opt) {
+            if (p >= end) {
+                return PROTO_BAD;
+            }
+            mask = *p++;
+            break;
+        }
+    }
+
+    for (int f = 0; f < FIELDS_MAX && l->f[f].key; f++) {
+        if (l->f[f].opt && !(mask & (1u << f))) {
+            continue;
+        }
+        KV* kv = &out->kv[out->kv_count++];
+        kv->key.ptr = l->f[f].key;
+        kv->key.len = strlen(l->f[f].key);
+        if (decode_value(&p, end, l->f[f].kind, nicks, &t, &kv->val) < 0) {
+            return PROTO_BAD;
+        }
+    }
+    return (p == end) ? PROTO_OK : PROTO_BAD;
+}
+
+int wire_to_text(const unsigned char* body, size_t len, WireNicks* nicks, char* out, size_t cap) {
+    if (len == 0 || cap < 2) {
+        return -1;
+    }
+
+    if (body[0] == WIRE_OP_NICK) {
+        const unsigned char* p = body + 2;
+        uint64_t n;
+        if (len < 2 || body[1] >= WIRE_NICKS || get_varint(&p, body + len, &n) < 0 || n == 0 || n >= sizeof(nicks->nick[0]) || n != (uint64_t)(body + len - p) || !token_bytes(p, (size_t)n)) {
+            return -1;
+        }
+        memcpy(nicks->nick[body[1]], p, (size_t)n);
+        nicks->nick[body[1]][n] = '\0';
+        return 0;
+    }
+    if (body[0] == WIRE_OP_TEXT) {
+        if (len + 1 > cap) {
+            return -1;
+        }
+        memcpy(out, body + 1, len - 1);
+        out[len - 1] = '\n';
+        out[len] = '\0';
+        return (int)len;
+    }
+
+    char scratch[1024];
+    ProtoMsg m;
+    if (wire_decode(body, len, nicks, scratch, sizeof(scratch), &m) != PROTO_OK) {
+        return -1;
+    }
+
+    size_t n = 0;
+    int w = snprintf(out, cap, "%s %.*s", g_type_names[m.type], (int)m.cmd_len, m.cmd);
+    if (w < 0 || (size_t)w >= cap) {
+        return -1;
+    }
+    n = (size_t)w;
+    for (int i = 0; i < m.kv_count; i++) {
+        w = snprintf(out + n, cap - n, " %s=%s", m.kv[i].key.ptr, m.kv[i].val.ptr);
+        if (w < 0 || (size_t)w >= cap - n) {
+            return -1;
+        }
+        n += (size_t)w;
+    }
+    if (n + 2 > cap) {
+        return -1;
+    }
+    out[n++] = '\n';
+    out[n] = '\0';
+    return (int)n;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file wire.h
+ * @brief Compact binary framing of the protocol, chosen per connection with REQ PROTO
+ *
+ * A frame is the body length as a varint followed by the body: a 1-byte opcode, then the fields of the message in a fixed order. Numbers are unsigned LEB128 varints, cards their 0-31 code from game.c (0xFF for "-"), suits and wishes one character, strings a varint length and the bytes, and nicknames an index into a per-connection table (0 for "-"). Messages with optional fields carry a bitmask of the present fields right after the opcode
+ * Requests use the command ID as opcode and responses WIRE_OP_RESP + command ID, the layouts of all opcodes are listed in wire.c. The server defines a table entry with a WIRE_OP_NICK frame (index byte, nickname string) before its first use. A line without a binary form travels as a WIRE_OP_TEXT frame holding the text line without terminator, in both directions
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#ifndef WIRE_H
+#define WIRE_H
+
+#pragma once
+#include <stddef.h>
+#include "protocol.h"
+
+#define WIRE_OP_RESP 0x20   // Response opcodes: WIRE_OP_RESP + command ID
+#define WIRE_OP_PONG 0x2F   // RESP PONG
+#define WIRE_OP_ERR  0x30   // ERR <cmd> code=.. msg=..
+#define WIRE_OP_EVT  0x40   // First event opcode
+#define WIRE_OP_NICK 0x7E   // Nickname table entry: index byte, nickname string
+#define WIRE_OP_TEXT 0x7F   // Text line without terminator
+
+#define WIRE_HEAD_MAX 2     // Longest length prefix, bodies stay below 16 KiB
+#define WIRE_NICKS 16       // Nickname table entries per connection
+
+/**
+ * @brief Nickname table of one connection
+ *
+ * The server fills it in round-robin order and announces every entry it (re)assigns, the client mirrors it from the WIRE_OP_NICK frames. A zeroed table is valid and empty
+ */
+typedef struct {
+    char nick[WIRE_NICKS][32];  // Nickname per index, empty if unused
+    unsigned next;              // Entry to reassign next
+} WireNicks;
+
+/**
+ * @brief Converts a text line to frames
+ *
+ * Emits WIRE_OP_NICK frames for nicknames not yet in the table, then the message. Lines that do not match their opcode's layout exactly (unknown commands, non-canonical values) become a WIRE_OP_TEXT frame, so decoding always restores the original line
+ *
+ * @param line      Text line, a trailing "\n" or "\r\n" is ignored
+ * @param len       Line length
+ * @param nicks     Nickname table of the receiving connection, NULL if nicknames are sent as text (requests)
+ * @param out       Output buffer
+ * @param cap       Capacity of out
+ *
+ * @return Number of bytes written, -1 if out is too small
+ */
+int wire_encode(const char* line, size_t len, WireNicks* nicks, unsigned char* out, size_t cap);
+
+/**
+ * @brief Reads the length prefix of a frame
+ *
+ * @param p         Buffered bytes
+ * @param avail     Number of buffered bytes
+ * @param body_len  Output: body length
+ *
+ * @return Length of the prefix, 0 if more bytes are needed, -1 if the prefix is malformed or too long
+ */
+int wire_frame_head(const unsigned char* p, size_t avail, size_t* body_len);
+
+/**
+ * @brief Decodes a frame body into a message, as proto_parse() would have produced it from the text line
+ *
+ * The key-value pairs are indexed already, their values are rendered as text into scratch. WIRE_OP_NICK and WIRE_OP_TEXT bodies are not messages and fail here
+ *
+ * @param body      Frame body (opcode first)
+ * @param len       Body length
+ * @param nicks     Nickname table of the connection, NULL if nickname indices are not expected
+ * @param scratch   Storage for the rendered values, must outlive the message
+ * @param cap       Capacity of scratch
+ * @param out       Output message
+ *
+ * @return PROTO_OK on success, PROTO_BAD on failure
+ */
+ProtoResult wire_decode(const unsigned char* body, size_t len, const WireNicks* nicks, char* scratch, size_t cap, ProtoMsg* out);
+
+/**
+ * @brief Converts a frame body back to its text line (client side)
+ *
+ * WIRE_OP_NICK bodies update the table and produce no text
+ *
+ * @param body      Frame body (opcode first)
+ * @param len       Body length
+ * @param nicks     Nickname table of the connection
+ * @param out       Output line, terminated by "\n" and '\0'
+ * @param cap       Capacity of out
+ *
+ * @return Length of the line, 0 for a table update, -1 for a malformed body
+ */
+int wire_to_text(const unsigned char* body, size_t len, WireNicks* nicks, char* out, size_t cap);
+
+#endif
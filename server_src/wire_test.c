@@ -0,0 +1,161 @@
+/**
+ * @file wire_test.c
+ * @brief Checks of the binary framing (make test)
+ *
+ * Every sample line must survive encode -> decode unchanged and its frames must re-encode to the same bytes. Frames whose string values carry bytes a text token cannot hold (newline, space, NUL, '=') must be rejected, so a binary client cannot forge lines for text clients
+ *
+ * Seminar work of "Fundamentals of Computer Networks"
+ */
+
+#include "wire.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int g_failed;    // Number of failed checks
+
+/**
+ * @brief Records the outcome of one check
+ *
+ * @param ok    Non-zero if the check passed
+ * @param what  Description printed on failure
+ */
+static void check(int ok, const char* what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        g_failed++;
+    }
+}
+
+/**
+ * @brief Encodes a line, decodes every frame back to text and re-encodes it
+ *
+ * @param line  Text line with terminator
+ * @param nicks Nickname table of the sender side, NULL for requests
+ */
+static void round_trip(const char* line, WireNicks* nicks) {
+    static WireNicks peer;      // Mirror of the receiving side
+    unsigned char frames[2048];
+    int n = wire_encode(line, strlen(line), nicks, frames, sizeof(frames));
+    check(n > 0, line);
+    if (n <= 0) {
+        return;
+    }
+
+    char text[2048] = "";
+    size_t off = 0;
+    while (off < (size_t)n) {
+        size_t body_len;
+        int h = wire_frame_head(frames + off, (size_t)n - off, &body_len);
+        check(h > 0 && off + (size_t)h + body_len <= (size_t)n, line);
+        if (h <= 0) {
+            return;
+        }
+        const unsigned char* body = frames + off + h;
+
+        char out[1024];
+        int len = wire_to_text(body, body_len, &peer, out, sizeof(out));
+        check(len >= 0, line);
+        if (len > 0) {
+            strncat(text, out, sizeof(text) - strlen(text) - 1);
+
+            // A message frame must be the only encoding of its text
+            unsigned char again[1024];
+            WireNicks copy = nicks ? *nicks : peer;
+            int m = wire_encode(out, (size_t)len, nicks ? &copy : NULL, again, sizeof(again));
+            int h2 = (m > 0) ? wire_frame_head(again, (size_t)m, &body_len) : -1;
+            check(h2 > 0 && (size_t)(m - h2) == body_len && memcmp(again + h2, body, body_len) == 0, line);
+        }
+        off += (size_t)h + body_len;
+    }
+    check(strcmp(text, line) == 0, line);
+}
+
+/**
+ * @brief Builds a LOGIN request frame body whose nickname holds arbitrary bytes
+ *
+ * @param nick  Nickname bytes
+ * @param len   Number of bytes
+ * @param body  Output body
+ *
+ * @return Body length
+ */
+static size_t login_body(const char* nick, size_t len, unsigned char* body) {
+    body[0] = CMD_LOGIN;
+    body[1] = (unsigned char)len;
+    memcpy(body + 2, nick, len);
+    return len + 2;
+}
+
+/**
+ * @brief Checks that a LOGIN frame with the given nickname bytes is rejected
+ *
+ * @param nick  Nickname bytes
+ * @param len   Number of bytes
+ * @param what  Description printed on failure
+ */
+static void reject_login(const char* nick, size_t len, const char* what) {
+    unsigned char body[128];
+    size_t n = login_body(nick, len, body);
+
+    char scratch[256];
+    ProtoMsg m;
+    check(wire_decode(body, n, NULL, scratch, sizeof(scratch), &m) == PROTO_BAD, what);
+
+    WireNicks nicks = { 0 };
+    char out[256];
+    check(wire_to_text(body, n, &nicks, out, sizeof(out)) < 0, what);
+}
+
+int main(void) {
+    static const char* const events[] = {
+        "EVT STATE room=1048576 phase=GAME paused=0 top=H7 active_suit=H penalty=2 turn=bot12 ver=4\n",
+        "EVT STATE_DELTA ver=5 top=SA turn=-\n",
+        "EVT HAND cards=C7,C9,HQ,SA\n",
+        "EVT PLAYED nick=bot2 card=HQ wish=S\n",
+        "EVT ROOM id=5 name=abc players=2/4 state=LOBBY\n",
+        "EVT ROOM id=6 name=a=b players=1/4 state=LOBBY\n",
+        "RESP LOGIN ok=1 session=abcdef0123\n",
+        "ERR PLAY code=ILLEGAL msg=rejected\n",
+        "EVT SERVER msg=welcome\n",
+    };
+    static const char* const requests[] = {
+        "REQ LOGIN nick=alice\n",
+        "REQ PLAY card=HQ wish=C\n",
+        "REQ CREATE_ROOM name=r size=4\n",
+        "REQ JOIN_ROOM room=0012\n",
+    };
+
+    WireNicks nicks = { 0 };
+    for (size_t i = 0; i < sizeof(events) / sizeof(events[0]); i++) {
+        round_trip(events[i], &nicks);
+    }
+    for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); i++) {
+        round_trip(requests[i], NULL);
+    }
+
+    // Values a text token cannot hold never get a binary form
+    unsigned char frames[256];
+    const char* eq = "EVT ROOM id=6 name=a=b players=1/4 state=LOBBY\n";
+    check(wire_encode(eq, strlen(eq), &nicks, frames, sizeof(frames)) > 1 && frames[1] == WIRE_OP_TEXT, "'=' in a string value falls back to text");
+
+    reject_login("x\nEVT GAME_END winner=alice", 27, "newline in a string value");
+    reject_login("x y", 3, "space in a string value");
+    reject_login("x\0y", 3, "NUL in a string value");
+    reject_login("x=y", 3, "'=' in a string value");
+    reject_login("x\r", 2, "CR in a string value");
+    reject_login("x\x7F", 2, "DEL in a string value");
+
+    unsigned char body[128];
+    char scratch[256];
+    ProtoMsg m;
+    size_t n = login_body("alice", 5, body);
+    check(wire_decode(body, n, NULL, scratch, sizeof(scratch), &m) == PROTO_OK && strcmp(proto_get(&m, "nick"), "alice") == 0, "plain nickname decodes");
+
+    if (g_failed) {
+        printf("%d check(s) failed\n", g_failed);
+        return 1;
+    }
+    printf("wire: all checks passed\n");
+    return 0;
+}